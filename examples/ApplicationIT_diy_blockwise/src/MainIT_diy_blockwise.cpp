@@ -29,6 +29,7 @@
 #include "ITL_histogrammapper.h"
 #include "ITL_field_regular.h"
 #include "ITL_globalentropy.h"
+#include "ITL_pool.h"
 
 #define NO_DIY 0
 #define WITH_DIY 1 
@@ -54,7 +55,7 @@ ITL_histogrammapper<VECTOR3>* histMapper_vector = NULL;
 ITL_field_regular<SCALAR> *scalarField = NULL;
 ITL_field_regular<VECTOR3> *vectorField = NULL;
 
-ITL_field_regular<int> *binField = NULL;
+ITL_pool blockPool;			// Recycles the frequency lists across blocks
 
 ITL_globalentropy<SCALAR> *globalEntropyComputer_scalar = NULL;
 ITL_globalentropy<VECTOR3> *globalEntropyComputer_vector = NULL;
@@ -226,19 +227,17 @@ int main( int argc, char** argv )
 		{	
 			if( fieldType == 0 )
 			{
-				// Create bin field (Specify range if required)
+				// Specify range if required
 				//cout << "3" << endl;
 				if( histogramLowEnd != histogramHighEnd )
 					histMapper_scalar->setHistogramRange( histogramLowEnd, histogramHighEnd );
-				//cout << "4" << endl;
-				histMapper_scalar->computeHistogramBinField_Scalar( (subScalarFieldArray+i), &binField, nBin );
 
 				// Initialize class that can compute entropy
 				//cout << "5" << endl;
-				globalEntropyComputer_scalar = new ITL_globalentropy<SCALAR>( binField, histogram, nBin );
+				globalEntropyComputer_scalar = new ITL_globalentropy<SCALAR>( NULL, histogram, nBin, &blockPool );
 
-				// Compute entropy
-				globalEntropyComputer_scalar->computeGlobalEntropyOfField( false );
+				// Compute entropy (bin and count in one pass, no bin field)
+				globalEntropyComputer_scalar->computeGlobalEntropyDirect( (subScalarFieldArray+i), histMapper_scalar, false );
 
 				// Print global entropy
 				globalEntropyList[i] = globalEntropyComputer_scalar->getGlobalEntropy();
@@ -262,22 +261,17 @@ int main( int argc, char** argv )
 
 				// clear up memory
 				delete globalEntropyComputer_scalar;
-				delete binField;
-				binField = NULL;
 				//delete [] scalarFieldArray;
 
 				//cout << "10" << endl;
 			}
 			else if( fieldType == 1 )
 			{
-				// Create bin field (Specify range if required)
-				histMapper_vector->computeHistogramBinField_Vector( (subVectorFieldArray+i), &binField, nBin );
-
 				// Initialize class that can compute entropy
-				globalEntropyComputer_vector = new ITL_globalentropy<VECTOR3>( binField, histogram, nBin );
+				globalEntropyComputer_vector = new ITL_globalentropy<VECTOR3>( NULL, histogram, nBin, &blockPool );
 
-				// Compute entropy
-				globalEntropyComputer_vector->computeGlobalEntropyOfField( false );
+				// Compute entropy (bin and count in one pass, no bin field)
+				globalEntropyComputer_vector->computeGlobalEntropyDirect( (subVectorFieldArray+i), histMapper_vector, false );
 
 				// Print global entropy
 				int lowInt[3], highInt[3];
@@ -298,8 +292,6 @@ int main( int argc, char** argv )
  
 				// clear up memory
 				delete globalEntropyComputer_vector;
-				delete binField;
-				binField = NULL;
 
 			}
 
@@ -432,17 +424,11 @@ int main( int argc, char** argv )
 				printf( "Block value range: %g %g\n", m, M );
 				#endif
 		
-				// Create bin field
-				histMapper_scalar->computeHistogramBinField_Scalar( scalarField, &binField, nBin );
-
 				// Initialize class that can compute entropy
-				globalEntropyComputer_scalar = new ITL_globalentropy<SCALAR>( binField, histogram, nBin );
-
-				// Compute histogram
-				globalEntropyComputer_scalar->computeHistogramFrequencies();
+				globalEntropyComputer_scalar = new ITL_globalentropy<SCALAR>( NULL, histogram, nBin, &blockPool );
 
-				// Compute entropy 
-				globalEntropyComputer_scalar->computeGlobalEntropyOfField( false );
+				// Compute histogram and entropy (bin and count in one pass, no bin field)
+				globalEntropyComputer_scalar->computeGlobalEntropyDirect( scalarField, histMapper_scalar, false );
 
 				// Print global entropy
 				globalEntropyList[k] = globalEntropyComputer_scalar->getGlobalEntropy();
@@ -465,8 +451,6 @@ int main( int argc, char** argv )
 
 				// Clear up
 				delete globalEntropyComputer_scalar;
-				delete binField;
-				binField = NULL;
 				delete scalarField;
 
 			}
@@ -476,16 +460,12 @@ int main( int argc, char** argv )
 				//cout << "1" << endl;
 				vectorField = new ITL_field_regular<VECTOR3>( vectordata[k], nDim, lowF, highF );
 
-				// Create bin field
-				//cout << "2" << endl;
-				histMapper_vector->computeHistogramBinField_Vector( vectorField, &binField, nBin );
-
 				// Initialize class that can compute entropy
 				//cout << "3" << endl;
-				globalEntropyComputer_vector = new ITL_globalentropy<VECTOR3>( binField, histogram, nBin );
+				globalEntropyComputer_vector = new ITL_globalentropy<VECTOR3>( NULL, histogram, nBin, &blockPool );
 
-				// Compute histogram
-				globalEntropyComputer_vector->computeHistogramFrequencies();
+				// Compute histogram (bin and count in one pass, no bin field)
+				globalEntropyComputer_vector->computeGlobalEntropyDirect( vectorField, histMapper_vector, false );
 
 
 	
@@ -507,8 +487,6 @@ int main( int argc, char** argv )
 
 				// Clear up
 				delete globalEntropyComputer_vector;
-				delete binField;
-				binField = NULL;
 				delete vectorField;
 			}
 
@@ -27,6 +27,7 @@
 #include "ITL_field_regular.h"
 #include "ITL_globalentropy.h"
 #include "ITL_localentropy.h"
+#include "ITL_pool.h"
 
 using namespace std;
 
@@ -50,6 +51,7 @@ ITL_histogram *histogram = NULL;
 ITL_histogrammapper<SCALAR> *histMapper_scalar = NULL;
 
 ITL_field_regular<int> *binField = NULL;
+ITL_pool blockPool;			// Recycles the bin and entropy fields across blocks
 ITL_field_regular<SCALAR> *enhancedScalarField = NULL;
 ITL_field_regular<SCALAR>** scalarFieldBlockArray = NULL;
 ITL_field_regular<VECTOR3>** vectorFieldBlockArray = NULL;
@@ -173,6 +175,7 @@ int main( int argc, char** argv )
 
 	// Initialize data-to-histogram converter class
 	histMapper_scalar = new ITL_histogrammapper<SCALAR>( histogram );
+	histMapper_scalar->setPool( &blockPool );
 
 	// Allocate memory for pointers that will hold block data
 	//MPI_Datatype complex;
@@ -412,6 +415,7 @@ int main( int argc, char** argv )
 			// Initialize class that can compute entropy
 			if( verboseMode == 1 ) fprintf( stderr, "creating entropy class for block %d ...\n", k );
 			localEntropyComputer_scalar = new ITL_localentropy<SCALAR>( binField, histogram, nBin );
+			localEntropyComputer_scalar->setPool( &blockPool );
 
 			// Compute entropy
 			if( verboseMode == 1 ) fprintf( stderr, "computing entropy for block %d ...\n", k );
@@ -458,9 +462,9 @@ int main( int argc, char** argv )
 			#endif
 
 			// Clear up
+			blockPool.releaseField( localEntropyComputer_scalar->getEntropyField() );
 			delete localEntropyComputer_scalar;
-			delete binField;
-			binField = NULL;
+			histMapper_scalar->releaseBinField( &binField );
 			delete scalarField;
 		}
 		/*
@@ -48,7 +48,8 @@ void compute_localentropy_serial(ITL_grid_tetrahedral<SCALAR>* tetGrid)
 
 	ITL_field_unstructured<SCALAR>* scalarField = new ITL_field_unstructured<SCALAR>(tetGrid);
 	localEntropyComputer = new ITL_localentropy<SCALAR>( scalarField, histogram );
-	localEntropyComputer->computeLocalEntropyOfField_Unstructured( nBin, false );
+	float* vertexEntropy = localEntropyComputer->computeLocalEntropyOfField_Unstructured( nBin, false );
+	delete [] vertexEntropy;
 }
 
 void compute_globalentropy_serial(ITL_grid_tetrahedral<SCALAR>* tetGrid)
@@ -85,12 +85,7 @@ main( int argc, char** argv )
 	if( fieldType == 0 )
 		histMapper_scalar = new ITL_histogrammapper<SCALAR>( histogram );
 	else if( fieldType == 1 )
-	{
 		histMapper_vector = new ITL_histogrammapper<VECTOR3>( histogram );
-		//cout << "1" << endl;
-		histMapper_vector->computeTable( nBin );
-		//cout << "2" << endl;
-	}
 
 	if( fieldType == 0 )
 	{
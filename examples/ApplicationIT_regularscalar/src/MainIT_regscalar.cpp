@@ -87,12 +87,14 @@ void compute_globalentropy_parallel();
 void compute_blockwiseglobalentropy_parallel();
 /**
  * Serial local entropy computation function for regular scalar field.
+ * @tparam B Type of the bin Ids, selected from nBin.
  */
-void compute_localentropy_serial();
+template <class B> void compute_localentropy_serial();
 /**
  * Parallel local entropy computation function for regular scalar field.
+ * @tparam B Type of the bin Ids, selected from nBin.
  */
-void compute_localentropy_parallel();
+template <class B> void compute_localentropy_parallel();
 /**
  * Serial global joint entropy computation function for regular scalar field.
  */
@@ -157,11 +159,21 @@ int main( int argc, char** argv )
 		break;
 	case 3:
 		printf( "Entering serial computation of local entropy field from the regular scalar field ...\n" );	
-		compute_localentropy_serial();
+		switch( ITL_histogrammapper<SCALAR>::getBinIdSize( nBin ) )
+		{
+		case 1:		compute_localentropy_serial<uint8_t>();		break;
+		case 2:		compute_localentropy_serial<uint16_t>();	break;
+		default:	compute_localentropy_serial<int>();			break;
+		}
 		break;
 	case 4:
 		printf( "Entering parallel computation of local entropy field from the regular scalar field ...\n" );	
-		compute_localentropy_parallel();
+		switch( ITL_histogrammapper<SCALAR>::getBinIdSize( nBin ) )
+		{
+		case 1:		compute_localentropy_parallel<uint8_t>();	break;
+		case 2:		compute_localentropy_parallel<uint16_t>();	break;
+		default:	compute_localentropy_parallel<int>();		break;
+		}
 		break;	
 	case 5:
 		printf( "Entering serial computation of global joint entropy of the regular scalar field ...\n" );	
@@ -385,8 +397,13 @@ void compute_blockwiseglobalentropy_parallel()
 }// end function
 
 
+template <class B>
 void compute_localentropy_serial()
 {
+	// Bin field with compact bin Ids
+	ITL_field_regular<B> *binField = NULL;
+	ITL_localentropy<SCALAR, B> *localEntropyComputer = NULL;
+
 	// Initialize ITL
 	ITL_base::ITL_init();
 
@@ -415,7 +432,7 @@ void compute_localentropy_serial()
 	execTime[1] = ITL_util<float>::endTimer( starttime );
 
 	// Initialize class that can compute local entropy field
-	localEntropyComputer = new ITL_localentropy<SCALAR>( binField, histogram, nBin );
+	localEntropyComputer = new ITL_localentropy<SCALAR, B>( binField, histogram, nBin );
 
 	// Entropy Computation
 	if( verboseMode == 1 ) printf( "Computing entropy at each point of the scalar field ...\n" );
@@ -440,11 +457,18 @@ void compute_localentropy_serial()
 
 	delete scalarField;
 	delete entropyField;	
+	delete localEntropyComputer;
+	delete binField;
 
 }// end function
 
+template <class B>
 void compute_localentropy_parallel()
 {
+	// Bin field with compact bin Ids
+	ITL_field_regular<B> *binField = NULL;
+	ITL_localentropy<SCALAR, B> *localEntropyComputer = NULL;
+
 	// Read relevant portion of data from file
 	if(verboseMode == 1 ) printf( "%d:Reading portion of scalar field ...\n", myId );
 	starttime = ITL_util<float>::startTimer();
@@ -476,7 +500,7 @@ void compute_localentropy_parallel()
 	execTime[1] = ITL_util<float>::endTimer( starttime );
 
 	// Initialize class that can compute entropy
-	localEntropyComputer = new ITL_localentropy<SCALAR>( binField, histogram, nBin );
+	localEntropyComputer = new ITL_localentropy<SCALAR, B>( binField, histogram, nBin );
 
 	if(verboseMode == 1 ) printf( "%d: Computing entropy at each point of the scalar field ...\n", myId );
 	starttime = ITL_util<float>::startTimer();
@@ -496,6 +520,8 @@ void compute_localentropy_parallel()
 
 	delete entropyField;
 	delete scalarField;
+	delete localEntropyComputer;
+	delete binField;
 
 }//end function
 
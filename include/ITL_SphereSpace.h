@@ -13,6 +13,7 @@ using namespace std;
 #include <math.h>
 
 #include "ITL_Range.h"
+#include "ITL_cubemap.h"
 
 #include "liblog.h"
 #include "libbuf.h"
@@ -30,11 +31,16 @@ class CSphereSpace
 	TBuffer<CRange> pcPhiBins;
 
 	TBuffer2D<int> p2DiMapping;
+
+	//! cube-map cell to patch; used by IMapVectorToPatch once built
+	int iCubeMapResolution;
+	TBuffer<int> piCubeMapping;
 public:
 	enum {
 		DEFAULT_NR_OF_THETA_SAMPLES	= 512,
 		DEFAULT_NR_OF_PHI_SAMPLES	= 256,
-		DEFAULT_NR_OF_PATCHES		= 360
+		DEFAULT_NR_OF_PATCHES		= 360,
+		DEFAULT_CUBE_MAP_RESOLUTION	= 128
 	};
 
         #if 0 // MOD-BY-LEETEN 07/23/2011-FROM:
@@ -53,6 +59,14 @@ public:
 		int iNrOfPhis
 	);
 
+	//! build the cube map from the spherical mapping. Afterwards IMapVectorToPatch
+	//! projects vectors onto the cube instead of computing the spherical coordinates.
+	void
+	_ComputeCubeMapping
+	(
+		int iResolution = DEFAULT_CUBE_MAP_RESOLUTION
+	);
+
 	int
 	IMapVectorToPatch
         #if 0 // MOD-BY-LEETEN 07/23/2011-FROM:
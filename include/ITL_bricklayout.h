@@ -0,0 +1,209 @@
+/**
+ * Bricked memory layout class.
+ * Index mapping of a 3D array stored as cubic bricks of 2^k points per axis,
+ * each brick x-fastest inside, with the bricks in Morton (Z-curve) order.
+ * A (2r+1)^3 neighborhood with r smaller than the brick size then spans at
+ * most 8 bricks, i.e. a few pages, where the linear x-fastest layout touches
+ * (2r+1)^2 rows that are whole xy-planes apart. The array is rounded up to
+ * whole bricks; the points of the last bricks beyond the array are storage
+ * only and are never read.
+ * Created on: Oct 18, 2026.
+ */
+
+#ifndef ITL_BRICKLAYOUT_H_
+#define ITL_BRICKLAYOUT_H_
+
+#include "ITL_header.h"
+
+class ITL_bricklayout
+{
+	int brickShift;				/**< log2 of the brick size (0 for the linear layout). */
+	int brickMask;				/**< Brick size - 1. */
+	int dim[3];					/**< Size of the array along each axis. */
+	int nBrick[3];				/**< Number of bricks along each axis. */
+	vector<int> brickBase;		/**< Per brick, x-fastest in the brick grid, index of its first point. */
+
+public:
+
+	/**
+	 * Default constructor: the linear layout.
+	 */
+	ITL_bricklayout()
+	{
+		brickShift = 0;
+		brickMask = 0;
+		dim[0] = dim[1] = dim[2] = 0;
+		nBrick[0] = nBrick[1] = nBrick[2] = 0;
+	}// end constructor
+
+	/**
+	 * Initialization function.
+	 * @param d Size of the array along each axis.
+	 * @param brickSize Number of points along each axis of a brick (a power of two, at least 2).
+	 */
+	void
+	init( const int* d, int brickSize )
+	{
+		assert( brickSize >= 2 && ( brickSize & ( brickSize-1 ) ) == 0 );
+		brickShift = 0;
+		while( ( 1 << brickShift ) < brickSize )
+			brickShift ++;
+		brickMask = brickSize - 1;
+
+		for( int i=0; i<3; i++ )
+		{
+			dim[i] = d[i];
+			nBrick[i] = ( dim[i] + brickMask ) >> brickShift;
+		}
+
+		// Rank of each brick along the Z-curve of the brick grid
+		int nBricks = nBrick[0] * nBrick[1] * nBrick[2];
+		vector< pair<uint64_t, int> > code( nBricks );
+		int b = 0;
+		for( int bz=0; bz<nBrick[2]; bz++ )
+			for( int by=0; by<nBrick[1]; by++ )
+				for( int bx=0; bx<nBrick[0]; bx++, b++ )
+					code[b] = make_pair( getMortonCode( bx, by, bz ), b );
+		sort( code.begin(), code.end() );
+
+		int brickVolume = 1 << ( 3*brickShift );
+		brickBase.resize( nBricks );
+		for( int rank=0; rank<nBricks; rank++ )
+			brickBase[ code[rank].second ] = rank * brickVolume;
+
+	}// end function
+
+	/**
+	 * @return TRUE for a bricked layout, FALSE for the linear one.
+	 */
+	bool isBricked() const { return brickShift > 0; }
+
+	int getBrickSize() const { return brickMask + 1; }
+	int getBrickShift() const { return brickShift; }
+	int getBrickMask() const { return brickMask; }
+	int getNumBricks( int d ) const { return nBrick[d]; }
+
+	/**
+	 * @return Number of points in the storage of the array (whole bricks).
+	 */
+	int
+	getStorageSize() const
+	{
+		return (int)brickBase.size() << ( 3*brickShift );
+	}// end function
+
+	/**
+	 * Function for 3D index to storage index conversion.
+	 * @param x x-coordinate of the point.
+	 * @param y y-coordinate of the point.
+	 * @param z z-coordinate of the point.
+	 * @return Index of the point in the storage.
+	 */
+	int
+	convert3DIndex( int x, int y, int z ) const
+	{
+		int brick = ( ( z >> brickShift ) * nBrick[1] + ( y >> brickShift ) ) * nBrick[0] + ( x >> brickShift );
+		return brickBase[brick] + getRowOffset( y, z ) + ( x & brickMask );
+	}// end function
+
+	/**
+	 * Row table function.
+	 * Storage index of the points of row (y, z): table[x >> getBrickShift()] + ( x & getBrickMask() ).
+	 * @param y y-coordinate of the row.
+	 * @param z z-coordinate of the row.
+	 * @param table Array of getNumBricks( 0 ) indices (allocated by the caller).
+	 */
+	void
+	getRowTable( int y, int z, int* table ) const
+	{
+		const int* base = &brickBase[ ( ( z >> brickShift ) * nBrick[1] + ( y >> brickShift ) ) * nBrick[0] ];
+		int rowOffset = getRowOffset( y, z );
+		for( int bx=0; bx<nBrick[0]; bx++ )
+			table[bx] = base[bx] + rowOffset;
+	}// end function
+
+	/**
+	 * Conversion function from the linear layout.
+	 * @param linear Array in x-fastest order.
+	 * @param bricked Array of getStorageSize() points (allocated by the caller).
+	 */
+	template <class T>
+	void
+	toBricked( const T* linear, T* bricked ) const
+	{
+		convert( const_cast<T*>( linear ), bricked, true );
+	}// end function
+
+	/**
+	 * Conversion function to the linear layout.
+	 * @param bricked Array in this layout.
+	 * @param linear Array of dim[0]*dim[1]*dim[2] points in x-fastest order (allocated by the caller).
+	 */
+	template <class T>
+	void
+	toLinear( const T* bricked, T* linear ) const
+	{
+		convert( linear, const_cast<T*>( bricked ), false );
+	}// end function
+
+	/**
+	 * @return Morton code of a point: the bits of x, y and z interleaved (21 bits each).
+	 */
+	static uint64_t
+	getMortonCode( int x, int y, int z )
+	{
+		return spreadBits( x ) | ( spreadBits( y ) << 1 ) | ( spreadBits( z ) << 2 );
+	}// end function
+
+private:
+
+	int
+	getRowOffset( int y, int z ) const
+	{
+		return ( ( z & brickMask ) << ( 2*brickShift ) ) | ( ( y & brickMask ) << brickShift );
+	}
+
+	/**
+	 * Copies brick rows between the two layouts (to the bricked one if toBrick).
+	 * Points of the last bricks beyond the array are zeroed.
+	 */
+	template <class T>
+	void
+	convert( T* linear, T* bricked, bool toBrick ) const
+	{
+		if( toBrick )
+			memset( bricked, 0, sizeof(T)*getStorageSize() );
+
+		int brickSize = brickMask + 1;
+		vector<int> table( nBrick[0] );
+		for( int z=0; z<dim[2]; z++ )
+			for( int y=0; y<dim[1]; y++ )
+			{
+				getRowTable( y, z, &table[0] );
+				T* row = linear + ( (size_t)z*dim[1] + y )*dim[0];
+				for( int bx=0; bx<nBrick[0]; bx++ )
+				{
+					int n = min( brickSize, dim[0] - ( bx << brickShift ) );
+					if( toBrick )
+						memcpy( bricked + table[bx], row + ( bx << brickShift ), sizeof(T)*n );
+					else
+						memcpy( row + ( bx << brickShift ), bricked + table[bx], sizeof(T)*n );
+				}
+			}
+	}
+
+	static uint64_t
+	spreadBits( int v )
+	{
+		uint64_t x = (uint64_t)v & 0x1fffff;
+		x = ( x | ( x << 32 ) ) & 0x1f00000000ffffULL;
+		x = ( x | ( x << 16 ) ) & 0x1f0000ff0000ffULL;
+		x = ( x | ( x << 8 ) ) & 0x100f00f00f00f00fULL;
+		x = ( x | ( x << 4 ) ) & 0x10c30c30c30c30c3ULL;
+		x = ( x | ( x << 2 ) ) & 0x1249249249249249ULL;
+		return x;
+	}
+};
+
+#endif
+/* ITL_BRICKLAYOUT_H_ */
@@ -0,0 +1,107 @@
+/**
+ *  Cube-map utility class for the ITL library.
+ *  Maps a direction to a cell of the cube map without spherical coordinates:
+ *  the direction is projected onto the face of its dominant axis, and each
+ *  face is split into nRes x nRes cells. One extra cell holds the zero vector
+ *  and directions with NaN or infinite components.
+ *  Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_CUBEMAP_H_
+#define ITL_CUBEMAP_H_
+
+#include "ITL_header.h"
+
+class ITL_cubemap
+{
+public:
+
+	/**
+	 * Number of cells of a cube map, including the cell of the zero vector.
+	 * @param nRes Number of cells along each side of a face.
+	 */
+	static int
+	getNumCells( int nRes )
+	{
+		return 6*nRes*nRes + 1;
+	}// end function
+
+	/**
+	 * Direction-to-cell conversion.
+	 * Faces are ordered +x, -x, +y, -y, +z, -z.
+	 * @param x x-component of the direction.
+	 * @param y y-component of the direction.
+	 * @param z z-component of the direction.
+	 * @param nRes Number of cells along each side of a face.
+	 * @return Cell index (the last cell for zero, NaN or infinite directions).
+	 */
+	static int
+	getCell( float x, float y, float z, int nRes )
+	{
+		float ax = fabsf( x );
+		float ay = fabsf( y );
+		float az = fabsf( z );
+
+		// The face coordinates below are only defined for finite, nonzero directions
+		float sum = ax + ay + az;
+		if( !( sum > 0.0f && sum <= FLT_MAX ) )		// also catches NaN
+			return 6*nRes*nRes;
+
+		// Dominant axis and the two in-face coordinates
+		int face;
+		float m, u, v;
+		if( ax >= ay && ax >= az )
+		{
+			face = ( x < 0.0f ) ? 1 : 0;	m = ax;	u = y;	v = z;
+		}
+		else if( ay >= az )
+		{
+			face = ( y < 0.0f ) ? 3 : 2;	m = ay;	u = x;	v = z;
+		}
+		else
+		{
+			face = ( z < 0.0f ) ? 5 : 4;	m = az;	u = x;	v = y;
+		}
+
+		// Project to [0, nRes] on the face
+		float s = 0.5f * nRes / m;
+		int iu = (int)( ( u + m ) * s );
+		int iv = (int)( ( v + m ) * s );
+		iu = ( iu < nRes - 1 ) ? iu : nRes - 1;
+		iv = ( iv < nRes - 1 ) ? iv : nRes - 1;
+
+		return ( face * nRes + iv ) * nRes + iu;
+	}// end function
+
+	/**
+	 * Cell-to-direction conversion.
+	 * @param cell Cell index.
+	 * @param nRes Number of cells along each side of a face.
+	 * @param dir Unnormalized direction through the center of the cell (zero for the last cell).
+	 */
+	static void
+	getCellDirection( int cell, int nRes, float* dir )
+	{
+		dir[0] = dir[1] = dir[2] = 0.0f;
+		if( cell >= 6*nRes*nRes )
+			return;
+
+		int face = cell / ( nRes*nRes );
+		int iv = ( cell / nRes ) % nRes;
+		int iu = cell % nRes;
+		float u = 2.0f * ( iu + 0.5f ) / nRes - 1.0f;
+		float v = 2.0f * ( iv + 0.5f ) / nRes - 1.0f;
+		float m = ( face % 2 == 0 ) ? 1.0f : -1.0f;
+
+		switch( face / 2 )
+		{
+		case 0:	dir[0] = m;	dir[1] = u;	dir[2] = v;	break;
+		case 1:	dir[0] = u;	dir[1] = m;	dir[2] = v;	break;
+		default:	dir[0] = u;	dir[1] = v;	dir[2] = m;	break;
+		}
+	}// end function
+
+};
+
+#endif
+/* ITL_CUBEMAP_H_ */
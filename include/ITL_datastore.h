@@ -2,6 +2,12 @@
  * The container class for data.
  * This template class is the container for the raw data for a field. This class does not have any
  * information regarding indexing and spatial arrangement of the data.
+ * Copies of a datastore share its array (reference counted) instead of copying
+ * it; the array is freed with the last datastore that owns it. A datastore can
+ * also be a view of memory it does not own (e.g. a simulation buffer), or of a
+ * contiguous part of another datastore's array, which then stays alive as long
+ * as the view does. On POSIX systems the array can also be a private memory
+ * mapping of a file (see initMapped), read lazily from the page cache.
  * Created on: Nov 18, 2010.
  * @authors Abon
  * @author Teng-Yok
@@ -11,82 +17,131 @@
 #ifndef ITL_DATASTORE_H_
 #define ITL_DATASTORE_H_
 
+#include <climits>
+
 #include "ITL_header.h"
 
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 template <class T>
 class ITL_datastore
 {
 	//FILE* datafile; /**< Pointer to data file. Required if data has to be read directly from file. */
 	int nel;		/**< Total number of elements in the 1D array. */
 	T* array;		/**< Pointer to the 1D array containing data elements. */
+	T* block;		/**< Start of the allocated block the array lies in, NULL for a view of memory not owned by any datastore. */
+	int* refCount;	/**< Number of datastores sharing the block (not thread-safe: share datastores outside parallel regions). */
+	void* mapBase;	/**< Start of the file mapping the array lies in, NULL if the block is not mapped. */
+	size_t mapLength;	/**< Length of the file mapping in bytes. */
 
 public:
 
+	/**
+	 * Access pattern hints for mapped arrays (see initMapped).
+	 */
+	enum {
+		ACCESS_NORMAL = 0,		/**< No hint. */
+		ACCESS_SEQUENTIAL = 1,	/**< Read ahead aggressively (full scans). */
+		ACCESS_RANDOM = 2		/**< No read-ahead (scattered reads). */
+	};
+
 	/**
 	 * Default Constructor.
 	 */
 	ITL_datastore()
 	{
+		nel = 0;
 		this->array = NULL;
+		block = NULL;
+		refCount = NULL;
+		mapBase = NULL;
+		mapLength = 0;
 
 	}// end constructor 1
 
 	/**
 	 * Constructor.
-	 * @param data pointer to template array conaining data.
+	 * @param data pointer to template array conaining data (deep copy).
 	 */
 	ITL_datastore( T* data, int ndata )
 	{
-		//this->array = data;
-		nel = ndata;
+		nel = 0;
 		this->array = NULL;
-		this->array = new T[nel];
-		memcpy( this->array, data, sizeof(T)*nel );
+		block = NULL;
+		refCount = NULL;
+		mapBase = NULL;
+		mapLength = 0;
+		init( data, ndata );
 
 	}// end constructor 1
 
+	/**
+	 * Copy constructor. Shares the array of that datastore.
+	 */
 	ITL_datastore( const ITL_datastore<T>& that )
 	{
-		this->nel = that.nel;
+		nel = 0;
 		this->array = NULL;
-		this->array = new T[nel];
-		memcpy( this->array, that.array, sizeof(T)*nel );
-	}
-
-	ITL_datastore( ITL_datastore<T>& that )
-	{
-		this->nel = that.nel;
-		this->array = NULL;
-		this->array = new T[nel];
-		memcpy( this->array, that.getData(), sizeof(T)*nel );
+		block = NULL;
+		refCount = NULL;
+		mapBase = NULL;
+		mapLength = 0;
+		share( that );
 	}
 
+	/**
+	 * Assignment. Releases the current array and shares the array of that datastore.
+	 */
 	ITL_datastore& operator= ( const ITL_datastore<T>& that )
 	{
 		if ( this != &that ) // protect against invalid self-assignment
 		{
-			this->nel = that.nel;
-			this->array = NULL;
-			this->array = new T[nel];
-			memcpy( this->array, that.array, sizeof(T)*nel );
+			release();
+			share( that );
 		}
 		// by convention, always return *this
 		return *this;
 	}
 
-	ITL_datastore& operator= ( ITL_datastore<T>& that )
+	#if __cplusplus >= 201103L
+	/**
+	 * Move constructor. Takes over the array of that datastore.
+	 */
+	ITL_datastore( ITL_datastore<T>&& that )
 	{
-		if ( this != &that ) // protect against invalid self-assignment
+		nel = that.nel;
+		this->array = that.array;
+		block = that.block;
+		refCount = that.refCount;
+		mapBase = that.mapBase;
+		mapLength = that.mapLength;
+		that.detach();
+	}
+
+	/**
+	 * Move assignment. Releases the current array and takes over the array of that datastore.
+	 */
+	ITL_datastore& operator= ( ITL_datastore<T>&& that )
+	{
+		if ( this != &that )
 		{
-			this->nel = that.nel;
-			this->array = NULL;
-			this->array = new T[nel];
-			memcpy( this->array, that.array, sizeof(T)*nel );
+			release();
+			nel = that.nel;
+			this->array = that.array;
+			block = that.block;
+			refCount = that.refCount;
+			mapBase = that.mapBase;
+			mapLength = that.mapLength;
+			that.detach();
 		}
-		// by convention, always return *this
 		return *this;
 	}
-
+	#endif
 
 	/**
 	 * Destructor
@@ -94,26 +149,153 @@ public:
 	virtual
 	~ITL_datastore()
 	{
-		if( this->array != NULL ) delete [] this->array;
+		release();
 	}// end destructor
 
 	void
 	init( int ndata )
 	{
+		release();
 		nel = ndata;
-		this->array = new T[nel];
+		allocate();
 
 	}// end constructor 1
 
 	void
 	init( T* data, int ndata )
 	{
+		release();
 		nel = ndata;
-		this->array = new T[nel];
+		allocate();
 		memcpy( this->array, data, sizeof(T)*nel );
 
 	}// end constructor 1
 
+	/**
+	 * Non-owning view initialization function.
+	 * Wraps memory owned by the caller without copying it; the memory must
+	 * outlive this datastore and every datastore sharing it.
+	 * @param data pointer to template array conaining data.
+	 * @param ndata Number of elements.
+	 */
+	void
+	initView( T* data, int ndata )
+	{
+		release();
+		nel = ndata;
+		this->array = data;
+
+	}// end function
+
+	/**
+	 * Sub-array view initialization function.
+	 * Shares a contiguous part of the array of another datastore without
+	 * copying it; the array stays alive as long as this datastore does.
+	 * @param that Datastore the part belongs to.
+	 * @param offset Index of the first element of the part.
+	 * @param ndata Number of elements of the part.
+	 */
+	void
+	initView( const ITL_datastore<T>& that, int offset, int ndata )
+	{
+		assert( offset >= 0 && offset + ndata <= that.nel );
+		if ( this != &that )
+		{
+			release();
+			share( that );
+		}
+		this->array += offset;
+		nel = ndata;
+
+	}// end function
+
+	/**
+	 * File mapping initialization function.
+	 * Maps ndata elements of a file, starting at a byte offset, instead of
+	 * reading them: the array is usable at once, pages are read on first touch,
+	 * and processes mapping the same file share its page cache. The mapping is
+	 * private: writes to the array stay in this process and never reach the
+	 * file. Falls back to reading the file on systems without mmap.
+	 * @param fileName File name.
+	 * @param offset Byte offset of the first element in the file (e.g. past a header).
+	 * @param ndata Number of elements.
+	 * @param accessHint ACCESS_NORMAL, ACCESS_SEQUENTIAL or ACCESS_RANDOM (madvise hint).
+	 * @return FALSE if the file could not be opened, is too short or holds
+	 * more elements than a datastore indexes (the datastore is then empty).
+	 */
+	bool
+	initMapped( const char* fileName, size_t offset, size_t ndata, int accessHint = ACCESS_SEQUENTIAL )
+	{
+		release();
+
+		// Elements are indexed with int
+		if( ndata > (size_t)INT_MAX )
+		{
+			fprintf( stderr, "ITL_datastore: %lu elements exceed the datastore size limit\n", (unsigned long)ndata );
+			return false;
+		}
+
+		#if defined( _WIN32 ) || defined( _WIN64 )
+		FILE* dataFile = fopen( fileName, "rb" );
+		if( dataFile == NULL )
+			return false;
+		nel = (int)ndata;
+		allocate();
+		fseek( dataFile, (long)offset, SEEK_SET );
+		size_t nRead = fread( this->array, sizeof(T), nel, dataFile );
+		fclose( dataFile );
+		if( nRead != (size_t)nel )
+		{
+			release();
+			return false;
+		}
+		#else
+		int fd = open( fileName, O_RDONLY );
+		if( fd < 0 )
+			return false;
+
+		struct stat fileStat;
+		size_t length = offset + sizeof(T)*ndata;
+		if( fstat( fd, &fileStat ) != 0 || (size_t)fileStat.st_size < length )
+		{
+			fprintf( stderr, "ITL_datastore: %s is shorter than %lu bytes\n", fileName, (unsigned long)length );
+			close( fd );
+			return false;
+		}
+
+		// Map from the start of the file, as offsets must be page aligned
+		void* base = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		close( fd );
+		if( base == MAP_FAILED )
+		{
+			perror( "ITL_datastore: mmap" );
+			return false;
+		}
+		if( accessHint == ACCESS_SEQUENTIAL )
+			madvise( base, length, MADV_SEQUENTIAL );
+		else if( accessHint == ACCESS_RANDOM )
+			madvise( base, length, MADV_RANDOM );
+
+		nel = (int)ndata;
+		mapBase = base;
+		mapLength = length;
+		this->array = (T*)( (char*)base + offset );
+		block = this->array;
+		refCount = new int( 1 );
+		#endif
+
+		return true;
+
+	}// end function
+
+	/**
+	 * @return TRUE if the array is a memory mapping of a file.
+	 */
+	bool isMapped() const
+	{
+		return mapBase != NULL;
+	}// end function
+
 	/**
 	 * Boolean function that returns TRUE if datastore contains data.
 	 * @return Boolean flag.
@@ -123,26 +305,36 @@ public:
 		return array != NULL;
 	}// end function
 
+	/**
+	 * @return TRUE if the array is shared with other datastores, or is a view of memory not owned by a datastore.
+	 */
+	bool isShared() const
+	{
+		return refCount == NULL ? array != NULL : *refCount > 1;
+	}// end function
+
 	virtual void
 	setDataAt( T v, int i )
 	{
 		array[i] = v;
 	}
 
+	/**
+	 * Sets the data as a view of the given memory (shallow copy, not freed by the datastore).
+	 */
 	virtual void
 	setDataFull( T* ptr )
 	{
-		array = ptr;
+		initView( ptr, nel );
 	}
 
+	/**
+	 * Sets the data as a copy of the given memory (deep copy).
+	 */
 	virtual void
 	setDataFull( T* ptr, int ndata )
 	{
-		nel = ndata;
-		if( this->array != NULL )
-			delete [] this->array;
-		this->array = new T[nel];
-		memcpy( this->array, ptr, sizeof(T)*nel );
+		init( ptr, ndata );
 	}
 
 
@@ -170,6 +362,56 @@ public:
 		return array[i];
 	}
 
+private:
+
+	void
+	allocate()
+	{
+		this->array = new T[nel];
+		block = this->array;
+		refCount = new int( 1 );
+	}
+
+	void
+	share( const ITL_datastore<T>& that )
+	{
+		nel = that.nel;
+		this->array = that.array;
+		block = that.block;
+		refCount = that.refCount;
+		mapBase = that.mapBase;
+		mapLength = that.mapLength;
+		if( refCount != NULL )
+			( *refCount ) ++;
+	}
+
+	void
+	release()
+	{
+		if( refCount != NULL && --( *refCount ) == 0 )
+		{
+			#if !defined( _WIN32 ) && !defined( _WIN64 )
+			if( mapBase != NULL )
+				munmap( mapBase, mapLength );
+			else
+			#endif
+				delete [] block;
+			delete refCount;
+		}
+		detach();
+	}
+
+	void
+	detach()
+	{
+		nel = 0;
+		this->array = NULL;
+		block = NULL;
+		refCount = NULL;
+		mapBase = NULL;
+		mapLength = 0;
+	}
+
 };
 
 #endif
@@ -10,6 +10,7 @@
 
 #include "ITL_header.h"
 #include "ITL_field_regular.h"
+#include "ITL_neighborhood.h"
 
 template <class T>
 class ITL_entropy
@@ -22,6 +23,7 @@ public:
 
 	float entropy;		/**< Value of computed entropy at a specified point in the field. */
 	float* probarray;   /**< Probability array used in emtropy computation. */
+	int boundaryMode;	/**< How neighbors outside the field are read (ITL_neighborhood::BOUNDARY_*). */
 public:
 
 	/**
@@ -32,6 +34,17 @@ public:
 		this->dataField = f;
 		this->binData = NULL;
 		this->entropyField = NULL;
+		this->boundaryMode = ITL_neighborhood::BOUNDARY_MIRROR;
+	}
+
+	/**
+	 * Boundary mode set function.
+	 * Selects how the neighbors outside the padded field are read by the next computation.
+	 * @param mode ITL_neighborhood::BOUNDARY_MIRROR (default), BOUNDARY_CLAMP or BOUNDARY_ZERO.
+	 */
+	void setBoundaryMode( int mode )
+	{
+		this->boundaryMode = mode;
 	}
 
 	/**
@@ -103,16 +116,14 @@ public:
 	    	this->entropyField = new ITL_field_regular<float>( this->dataField->grid->nDim,
 	    													   this->dataField->grid->low, this->dataField->grid->high );
 
-		// Compute total number of vertices in the neighborhood, including the vertext itself
-		//int nNeighbors = (int)std::pow( 2.0f*this->dataField->grid->neighborhoodSize + 1.0f, this->dataField->grid->nDim );
-	    int nNeighbors = (int)( ( 2.0f*this->dataField->grid->neighborhoodSizeArray[0] + 1.0f) *
-	    						( 2.0f*this->dataField->grid->neighborhoodSizeArray[1] + 1.0f) *
-	    						( 2.0f*this->dataField->grid->neighborhoodSizeArray[2] + 1.0f) );
-
 	    // Compute histogram if it is not already done
 		if( this->binData == NULL )
 				this->computeHistogramBinField( nBins );
 
+		// Neighborhood gather with the boundary mode of this computation
+		ITL_neighborhood neighborhood( this->binData, this->boundaryMode );
+		int* binArray = new int[neighborhood.getNumNeighbors()];
+
 		int index1d = 0;
 		for( int z=0; z<this->entropyField->grid->dim[2]; z++ )
 		{
@@ -121,7 +132,7 @@ public:
 				for( int x=0; x<this->entropyField->grid->dim[0]; x++ )
 				{
 					// Compute and store the value of entropy at this point
-					this->computeEntropySinglePoint( x, y, z, nNeighbors, nBins, index1d );
+					this->computeEntropySinglePoint( neighborhood, x, y, z, binArray, nBins, index1d );
 
 					// increment to the next element
 					index1d ++;
@@ -129,67 +140,33 @@ public:
 			}
 		}
 
+		delete [] binArray;
+
 	}// end function
 
 	/**
 	 * Entropy computation function.
 	 * Computes entropy at a spatial point in the field.
+	 * @param neighborhood Neighborhood gather of the bin field (sets the boundary mode).
 	 * @param x x-coordinate of the spatial point.
 	 * @param y y-coordinate of the spatial point.
 	 * @param z z-coordinate of the spatial point.
-	 * @param nNeighbors total number of neighbors in the neighborhood (including self).
+	 * @param binArray Scratch array of neighborhood.getNumNeighbors() bin ids.
 	 * @param nBins Number of bins to use in histogram computation.
 	 * @param entropyFieldIndex 1D index to the entopy field.
 	 */
-	void computeEntropySinglePoint( int x, int y, int z, int nNeighbors, int nBins, int entropyFieldIndex )
+	void computeEntropySinglePoint( const ITL_neighborhood& neighborhood, int x, int y, int z,
+									int* binArray, int nBins, int entropyFieldIndex )
 	{
-		int* binArray = new int[nNeighbors];
-		int index1d = 0;
-		int binArrayIndex = 0;
-
-//		for( int k = -this->binData->grid->neighborhoodSize; k <= this->binData->grid->neighborhoodSize; k++ )
-//		{
-//			for( int j = -this->binData->grid->neighborhoodSize; j <= this->binData->grid->neighborhoodSize; j++ )
-//			{
-//				for( int i = -this->binData->grid->neighborhoodSize; i <= this->binData->grid->neighborhoodSize; i++ )
-//				{
-		for( int k = -this->binData->grid->neighborhoodSizeArray[2]; k <= this->binData->grid->neighborhoodSizeArray[2]; k++ )
-		{
-			for( int j = -this->binData->grid->neighborhoodSizeArray[1]; j <= this->binData->grid->neighborhoodSizeArray[1]; j++ )
-			{
-				for( int i = -this->binData->grid->neighborhoodSizeArray[0]; i <= this->binData->grid->neighborhoodSizeArray[0]; i++ )
-				{
-
-					// Convert the 1D index corresponding to the point
-					#ifdef DUPLICATE
-					index1d = this->binData->grid->convert3DIndex( ITL_util<int>::clamp( x+i+this->binData->grid->lowPad[0], 0, this->binData->grid->dimWithPad[0]-1 ),
-													ITL_util<int>::clamp( y+j+this->binData->grid->lowPad[1], 0, this->binData->grid->dimWithPad[1]-1 ),
-													ITL_util<int>::clamp( z+k+this->binData->grid->lowPad[2], 0, this->binData->grid->dimWithPad[2]-1 ) );
-					#endif
-
-					#ifdef MIRROR
-					index1d = this->binData->grid->convert3DIndex( ITL_util<int>::mirror( x+i+this->binData->grid->lowPad[0], 0, this->binData->grid->dimWithPad[0]-1 ),
-													ITL_util<int>::mirror( y+j+this->binData->grid->lowPad[1], 0, this->binData->grid->dimWithPad[1]-1 ),
-													ITL_util<int>::mirror( z+k+this->binData->grid->lowPad[2], 0, this->binData->grid->dimWithPad[2]-1 ) );
-					#endif
-
-					// Obtain the binID corresponding to the value at this location
-					binArray[binArrayIndex] = this->binData->getDataAt( index1d );
-
-					// Move to next point in the neighborhood
-					binArrayIndex ++;
-				}
-			}
-		}
+		// Straight-line gather in the interior, boundary mode in the shell
+		neighborhood.gather( this->binData->getDataFull(), x, y, z, binArray );
 
 		// Compute entropy
-		float entropy = this->computeEntropy( binArray, nNeighbors, nBins );
+		float entropy = this->computeEntropy( binArray, neighborhood.getNumNeighbors(), nBins );
 
 		// Store entropy
 		this->entropyField->setDataAt( entropyFieldIndex, entropy );
 
-		delete binArray;
-
 	}// end function
 
 	/**
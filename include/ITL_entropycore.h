@@ -10,13 +10,91 @@
 
 #include "ITL_header.h"
 #include "ITL_statutil.h"
+#include "ITL_kde.h"
+#include "ITL_sphericalkde.h"
 
 class ITL_entropycore
 {
 public:
 
+	enum {
+		COUNT_TABLE_SIZE = 13*13*13 + 1		/**< Counts covered by the c*log2(c) table (a 13^3 neighborhood). */
+	};
+
 public:
 
+	/**
+	 * Count-based entropy kernel.
+	 * Table of c*log2(c) for c in [0, COUNT_TABLE_SIZE). Built once, on first use.
+	 * Inner loops whose counts stay below COUNT_TABLE_SIZE can index it directly.
+	 */
+	static const double* getCountLogCountTable();
+
+	/**
+	 * Count-based entropy kernel.
+	 * For integer counts c_i summing to N, H = log2(N) - (1/N) * sum( c_i*log2(c_i) ),
+	 * so entropy needs one table lookup per bin and a single log.
+	 * @return c*log2(c), with 0*log2(0) = 0.
+	 */
+	static double
+	countLogCount( int c )
+	{
+		return ( c < COUNT_TABLE_SIZE ) ? getCountLogCountTable()[c] : c * ( log( (double)c ) / log( 2.0 ) );
+	}// end function
+
+	/**
+	 * Count-based entropy kernel.
+	 * @param freqArray Array of bin counts.
+	 * @param nBin Number of bins.
+	 * @return sum of c*log2(c) over the bins.
+	 */
+	static double sumCountLogCount( const int* freqArray, int nBin );
+
+	/**
+	 * Count-based entropy kernel.
+	 * Incremental form: updates the sum when one count changes by delta (typically +1 or -1).
+	 * @param sumCLogC Sum of c*log2(c) before the change.
+	 * @param oldCount Count of the bin before the change.
+	 * @param delta Change of the count.
+	 * @return sum of c*log2(c) after the change.
+	 */
+	static double
+	updateCountLogCount( double sumCLogC, int oldCount, int delta )
+	{
+		return sumCLogC - countLogCount( oldCount ) + countLogCount( oldCount + delta );
+	}// end function
+
+	/**
+	 * Count-based entropy kernel.
+	 * @param sumCLogC Sum of c*log2(c) over the bins.
+	 * @param nPoint Sum of the counts.
+	 * @param nBin Number of bins (used for normalization).
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 */
+	static float
+	computeEntropy_CountBased( double sumCLogC, int nPoint, int nBin, bool toNormalize )
+	{
+		if( nPoint <= 0 )
+			return 0.0f;
+
+		double entropy = ( log( (double)nPoint ) / log( 2.0 ) ) - sumCLogC / nPoint;
+
+		// Normalize, if required
+		if( toNormalize )
+			entropy /= ( log( (double)nBin ) / log( 2.0 ) );
+
+		return (float)entropy;
+	}// end function
+
+	/**
+	 * Count-based entropy kernel.
+	 * @param freqArray Array of bin counts.
+	 * @param nPoint Number of points the probabilities are relative to (normally the sum of the counts).
+	 * @param nBin Number of bins.
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 */
+	static float computeEntropy_CountBased( const int* freqArray, int nPoint, int nBin, bool toNormalize );
+
 	/**
 	 * Histogram based entropy computation function.
 	 * @param nPoint Number of points. Same as the length of bin array.
@@ -49,18 +127,21 @@ public:
 	static float computeEntropy_HistogramBased( float* freqArray, int nBin, bool toNormalize );
 	/**
 	 * KDE based entropy computation function.
+	 * Uses the binned estimator of ITL_kde, evaluated at ITL_kde::DEFAULT_NR_OF_EVAL_POINTS points.
 	 * @param data Pointer to data array.
-	 * @param nPoint Number of points to be sampled. Equivalent to nBin.
+	 * @param nPoint Number of points.
 	 * @param h Kernel Bandwidth (Put 0 to allow the software decide the bandwidth)
 	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
 	 */
 	static float computeEntropy_KDEBased( float* data, int nPoint, float h, bool toNormalize );
 
 	/**
-	 * KDE based ***Dummy*** entropy computation function.
+	 * KDE based entropy computation function for vector data.
+	 * Differential entropy of the directions under a von Mises-Fisher kernel
+	 * (see ITL_sphericalkde); independent of any bin count.
 	 * @param data Pointer to data array.
-	 * @param nPoint Number of points to be sampled. Equivalent to nBin.
-	 * @param h Kernel Bandwidth (Put 0 to allow the software decide the bandwidth)
+	 * @param nPoint Number of vectors.
+	 * @param h Angular kernel bandwidth in radians, kappa = 1/h^2 (Put 0 to allow the software decide the bandwidth)
 	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
 	 */
 	static float computeEntropy_KDEBased( VECTOR3* data, int nPoint, float h, bool toNormalize );
@@ -72,7 +153,8 @@ public:
 	 * @paran var Variance of the point set
 	 */
 	static float evaluateKernel( float x, float mu, float var );
-	
+
+
 };
 
 #endif
@@ -14,15 +14,26 @@
 #include "ITL_field.h"
 #include "ITL_grid_regular.h"
 #include "ITL_datastore.h"
+#include "ITL_fieldspan.h"
+#include "ITL_bricklayout.h"
 
 template <class T>
 class ITL_field_regular: public ITL_field<T>
 {
 	ITL_grid_regular<T> grid;			/**< Grid associated to the field. */
 	ITL_datastore<T> datastore;			/**< Data store associated to the field. */
+	ITL_bricklayout layout;				/**< Order of the points in the datastore (linear unless set with setLayout). */
 
 public:
 
+	/**
+	 * Memory layouts of the data (see setLayout).
+	 */
+	enum {
+		LAYOUT_LINEAR = 0,		/**< x-fastest order (default). */
+		LAYOUT_BRICKED = 1		/**< Cubic bricks in Morton order (see ITL_bricklayout). */
+	};
+
 	/**
 	 * Default constructor.
 	 */
@@ -32,9 +43,13 @@ public:
 		//this->datastore = NULL;
 	}
 
+	/**
+	 * Copy constructor. The copy shares the data of that field (see ITL_datastore).
+	 */
 	ITL_field_regular( const ITL_field_regular<T>& that )
 	{
 		this->grid = that.grid;
+		this->layout = that.layout;
 		this->datastore = that.datastore;
 
 	}
@@ -42,6 +57,7 @@ public:
 	ITL_field_regular( ITL_field_regular<T>& that )
 	{
 		this->grid = that.grid;
+		this->layout = that.layout;
 		this->datastore = that.datastore;
 
 	}
@@ -51,6 +67,7 @@ public:
 		if (this != &that ) // protect against invalid self-assignment
 		{
 			this->grid = that.grid;
+			this->layout = that.layout;
 			this->datastore = that.datastore;
 		}
 		// by convention, always return *this
@@ -62,6 +79,7 @@ public:
 		if (this != &that ) // protect against invalid self-assignment
 		{
 			this->grid = that.grid;
+			this->layout = that.layout;
 			this->datastore = that.datastore;
 
 			/*
@@ -81,6 +99,32 @@ public:
 		return *this;
 	}
 
+	#if __cplusplus >= 201103L
+	/**
+	 * Move constructor. Takes over the data of that field.
+	 */
+	ITL_field_regular( ITL_field_regular<T>&& that )
+	{
+		this->grid = that.grid;
+		this->layout = that.layout;
+		this->datastore = std::move( that.datastore );
+	}
+
+	/**
+	 * Move assignment. Takes over the data of that field.
+	 */
+	ITL_field_regular& operator= ( ITL_field_regular<T>&& that )
+	{
+		if (this != &that )
+		{
+			this->grid = that.grid;
+			this->layout = that.layout;
+			this->datastore = std::move( that.datastore );
+		}
+		return *this;
+	}
+	#endif
+
 	/**
 	 * Constructor. 
 	 * @param ndim Dimensionality of field.
@@ -164,8 +208,9 @@ public:
 	 * @param data pointer to 1D array of elements.
 	 * @param ndim Dimensionality of field.
 	 * @param dim Length of field along each dimension.
+	 * @param toCopy FALSE wraps data without copying it (the caller keeps ownership).
 	 */
-	ITL_field_regular( T* data, int ndim, int* dim )
+	ITL_field_regular( T* data, int ndim, int* dim, bool toCopy = true )
 	{
 		// Initialize grid
 		//this->grid = new ITL_grid_regular<T>( ndim );
@@ -185,7 +230,7 @@ public:
 		//this->datastore = new ITL_datastore<T>( data, ITL_util<int>::prod( &this->grid->dimWithPad[0], this->grid->nDim ) );
 		int dimWithPad[4];
 		getSizeWithPad( dimWithPad );
-		datastore.init( data, ITL_util<int>::prod( dimWithPad, grid.getNumDim() ) );
+		initData( data, ITL_util<int>::prod( dimWithPad, grid.getNumDim() ), toCopy );
 
 
 	}// constructor 1
@@ -195,8 +240,9 @@ public:
 	 * @param ndim Dimensionality of field.
 	 * @param l Pointer to array containing lower grid (associated to the field) bounds in continuous space along each dimension.
 	 * @param h Pointer to array containing upper grid (associated to the field) bounds in continuous space along each dimension.
+	 * @param toCopy FALSE wraps data without copying it (the caller keeps ownership).
 	 */
-	ITL_field_regular( T* data, int ndim, float* l, float* h )
+	ITL_field_regular( T* data, int ndim, float* l, float* h, bool toCopy = true )
 	{
 		// Initialize grid
 		//this->grid = new ITL_grid_regular<T>( ndim );
@@ -208,7 +254,7 @@ public:
 		// Initialize datastore
 		int dim[4];
 		getSize( dim );
-		datastore.init( data, ITL_util<int>::prod( dim, ndim ) );
+		initData( data, ITL_util<int>::prod( dim, ndim ), toCopy );
 
 
 	}// constructor
@@ -223,11 +269,12 @@ public:
 	 * @param lPad Pointer to array containing ghost layer span along each dimension on the lower end.
 	 * @param hPad Pointer to array containing ghost layer span along each dimension on the upper end.
 	 * @param neighborhoodsize Neighborhood length for each point.
+	 * @param toCopy FALSE wraps data without copying it (the caller keeps ownership).
 	 */
 	ITL_field_regular( T* data, int ndim,
 					   float* l, float* h,
 					   int* lPad, int* hPad,
-					   int neighborhoodsize )
+					   int neighborhoodsize, bool toCopy = true )
 	{
 		// Initialize grid
 		//this->grid = new ITL_grid_regular<T>( ndim );
@@ -240,7 +287,7 @@ public:
 		//this->datastore = new ITL_datastore<T>( data, ITL_util<int>::prod( &this->grid->dimWithPad[0], this->grid->nDim ) );
 		int dimWithPad[4];
 		getSizeWithPad( dimWithPad );
-		datastore.init( data, ITL_util<int>::prod( dimWithPad, grid.getNumDim() ) );
+		initData( data, ITL_util<int>::prod( dimWithPad, grid.getNumDim() ), toCopy );
 
 
 	}// Constructor
@@ -255,11 +302,12 @@ public:
 	 * @param lPad Pointer to array containing ghost layer span along each dimension on the lower end.
 	 * @param hPad Pointer to array containing ghost layer span along each dimension on the upper end.
 	 * @param neighborhoodsizearray Neighborhood length for each dimension.
+	 * @param toCopy FALSE wraps data without copying it (the caller keeps ownership).
 	 */
 	ITL_field_regular( T* data, int ndim,
 					   float* l, float* h,
 					   int* lPad, int* hPad,
-					   int* neighborhoodsizearray )
+					   int* neighborhoodsizearray, bool toCopy = true )
 	{
 		// Initialize grid
 		//this->grid = new ITL_grid_regular<T>( ndim );
@@ -272,7 +320,7 @@ public:
 		//this->datastore = new ITL_datastore<T>( data, ITL_util<int>::prod( &this->grid->dimWithPad[0], this->grid->nDim ) );
 		int dimWithPad[4];
 		getSizeWithPad( dimWithPad );
-		datastore.init( data, ITL_util<int>::prod( dimWithPad, grid.getNumDim() ) );
+		initData( data, ITL_util<int>::prod( dimWithPad, grid.getNumDim() ), toCopy );
 
 
 	}// Constructor
@@ -282,6 +330,7 @@ public:
 		// Initialize grid
 		//this->grid = new ITL_grid_regular<T>( ndim );
 		grid.init( ndim );
+		layout = ITL_bricklayout();
 
 		// set grid bounds
 		this->setBounds( l, h );
@@ -293,11 +342,12 @@ public:
 		datastore.init( ITL_util<int>::prod( dim, grid.getNumDim() ) );
 	}
 
-	void initialize( T* data, int ndim, float *l, float *h )
+	void initialize( T* data, int ndim, float *l, float *h, bool toCopy = true )
 	{
 		// Initialize grid
 		//this->grid = new ITL_grid_regular<T>( ndim );
 		grid.init( ndim );
+		layout = ITL_bricklayout();
 
 		// set grid bounds
 		this->setBounds( l, h );
@@ -306,10 +356,103 @@ public:
 		//this->datastore = new ITL_datastore<T>( data, ITL_util<int>::prod( &this->grid->dim[0], ndim ) );
 		int dim[4];
 		getSize( dim );
-		datastore.init( data, ITL_util<int>::prod( dim, grid.getNumDim() ) );
+		initData( data, ITL_util<int>::prod( dim, grid.getNumDim() ), toCopy );
 
 	}
 
+	/**
+	 * File mapping initialization function.
+	 * Makes this field (without pad, bounds 0 to dim-1) a private memory
+	 * mapping of raw data in a file instead of a copy (see ITL_datastore::initMapped).
+	 * @param fileName File name.
+	 * @param ndim Dimensionality of field.
+	 * @param dim Length of field along each dimension.
+	 * @param offset Byte offset of the data in the file (past its header).
+	 * @param accessHint ITL_datastore<T>::ACCESS_* hint for the expected access pattern.
+	 * @return FALSE if the file could not be mapped.
+	 */
+	bool initializeMapped( const char* fileName, int ndim, int* dim, size_t offset,
+						   int accessHint = ITL_datastore<T>::ACCESS_SEQUENTIAL )
+	{
+		grid.init( ndim );
+		layout = ITL_bricklayout();
+
+		// set grid bounds: 0 to N-1
+		float lowEnd[4] = { 0, 0, 0, 0 };
+		float highEnd[4] = { 0, 0, 0, 0 };
+		for( int i=0; i<ndim; i++ )
+			highEnd[i] = (float)(dim[i]-1);
+		this->setBounds( lowEnd, highEnd );
+
+		size_t nData = 1;
+		for( int i=0; i<ndim; i++ )
+			nData *= (size_t)dim[i];
+		return datastore.initMapped( fileName, offset, nData, accessHint );
+	}
+
+	/**
+	 * @return TRUE if the data of the field is a memory mapping of a file.
+	 */
+	bool
+	isDataMapped() const
+	{
+		return datastore.isMapped();
+	}
+
+	/**
+	 * Sub-block initialization function.
+	 * Makes this field (without pad) the block [low, high] of a source field.
+	 * If the block is contiguous in the source (it spans whole padded rows
+	 * along all dimensions but the last), the field is a view sharing the
+	 * memory of the source; otherwise the block is copied once.
+	 * @param source Field the block is taken from.
+	 * @param low Lower bound along each dimension (global index space, inclusive).
+	 * @param high Higher bound along each dimension (global index space, inclusive).
+	 */
+	void initializeSubField( ITL_field_regular<T>& source, float *low, float *high )
+	{
+		int nDim = source.getNumDim();
+		int lowInt[4] = { 0, 0, 0, 0 };
+		int highInt[4] = { 0, 0, 0, 0 };
+		float lowF[4], highF[4];
+		for( int i=0; i<nDim; i++ )
+		{
+			lowInt[i] = (int)floor( low[i] );
+			highInt[i] = (int)ceil( high[i] );
+			lowF[i] = (float)lowInt[i];
+			highF[i] = (float)highInt[i];
+		}
+
+		grid.init( nDim );
+		layout = ITL_bricklayout();
+		this->setBounds( lowF, highF );
+		int nSubPoint = this->getSize();
+
+		// Contiguous if the source is linear and every dimension but the last spans it with pad
+		int dimWithPad[4];
+		source.getSizeWithPad( dimWithPad );
+		bool isContiguous = ( source.getLayout() == LAYOUT_LINEAR );
+		for( int i=0; i<nDim-1; i++ )
+			if( highInt[i] - lowInt[i] + 1 != dimWithPad[i] )
+				isContiguous = false;
+
+		if( isContiguous )
+		{
+			int sourceLow[4] = { 0, 0, 0, 0 };
+			int sourceHigh[4] = { 0, 0, 0, 0 };
+			source.getBounds( sourceLow, sourceHigh );
+			int offset = source.convert3DIndex( lowInt[0] - sourceLow[0],
+												lowInt[1] - sourceLow[1],
+												lowInt[2] - sourceLow[2] );
+			datastore.initView( source.datastore, offset, nSubPoint );
+		}
+		else
+		{
+			datastore.init( nSubPoint );
+			source.getDataBetween( lowInt, highInt, getDataFull() );
+		}
+	}
+
 
 
 	/**
@@ -421,21 +564,13 @@ public:
 					lowSub[0] = x * blockSize[0];
 					if( isSharingNeighbor == true )	highSub[0] = std::min( (float)highInt[0], lowSub[0] + blockSize[0] );
 					
-					// Initialize subfield 
-					((*subfieldArray)+blockIndex)->initialize( nDim, lowSub, highSub );//, this->grid->lowPad, this->grid->highPad, this->grid->neighborhoodSize );
+					// Initialize subfield and load its data: a view of the full field
+					// if the block is contiguous in it, else a single copy
+					((*subfieldArray)+blockIndex)->initializeSubField( *this, lowSub, highSub );//, this->grid->lowPad, this->grid->highPad, this->grid->neighborhoodSize );
 					//#ifdef DEBUG_MODE
 					printf( "%d: %f %f %f %f %f %f\n", blockIndex, lowSub[0], lowSub[1], lowSub[2], highSub[0], highSub[1], highSub[2] );
 					//#endif
 
-					// load (copy from datastore of full field) Data to the subfield
-					cout << "a" << endl;
-					int nSubPoint = ( highSub[0] - lowSub[0] + 1 ) * ( highSub[1] - lowSub[1] + 1 ) * ( highSub[2] - lowSub[2] + 1 );
-					T* subData = new T[nSubPoint];
-					this->getDataBetween( lowSub, highSub, subData );
-					((*subfieldArray)+blockIndex)->setDataFull( subData, nSubPoint );
-					delete [] subData;
-					cout << "b" << endl;
-
 					//#ifdef DEBUG_MODE
 					float m = ITL_util<SCALAR>::Min( (SCALAR*)((*subfieldArray)+blockIndex)->getDataFull(), ((*subfieldArray)+blockIndex)->getSize() );
 					float M = ITL_util<SCALAR>::Max( (SCALAR*)((*subfieldArray)+blockIndex)->getDataFull(), ((*subfieldArray)+blockIndex)->getSize() );
@@ -448,6 +583,7 @@ public:
 			}
 		}
 
+		delete [] blockSize;
 		delete [] lowSub;
 		delete [] highSub;
 	}// end function
@@ -456,19 +592,19 @@ public:
 	/**
 	 * Function for creating a partition or subfield
 	 * within the specified bounds.
+	 * The subfield shares the memory of this field when the block is contiguous
+	 * in it (see initializeSubField), and holds a single copy otherwise.
 	 * @param low Lower bound along each dimension.
 	 * @param high Higher bound along each dimension.
 	 */
-	/*
-	ITL_field<T>* createSubField( float* low, float* high )
+	ITL_field_regular<T>* createSubField( float* low, float* high )
 	{
-		// Allocate memory for 3D block
-		ITL_field_regular<T>* newField = new ITL_field_regular<T>( this->getDataBetween( low, high ), this->grid->nDim, this->grid->dim );
+		ITL_field_regular<T>* newField = new ITL_field_regular<T>();
+		newField->initializeSubField( *this, low, high );
 
 		return newField;
 
 	}// end function
-	*/
 
 	/**
 	 * Data accessor function type 1.
@@ -493,7 +629,7 @@ public:
 	{
 		// Convert index to 1D
 		//int index1d = this->grid->convert3DIndex( x, y, z );
-		int index1d = grid.convert3DIndex( x, y, z );
+		int index1d = convert3DIndex( x, y, z );
 
 		// Get data
 		//return this->datastore->array[index1d];
@@ -571,7 +707,17 @@ public:
 		fprintf( stderr, "%d %d %d\n", dimLength[0], dimLength[1], dimLength[2] );
 		#endif
 
-
+		// Bricked layout: rows are not contiguous in the datastore
+		if( layout.isBricked() )
+		{
+			for( int z=0; z<dimLength[2]; z++ )
+				for( int y=0; y<dimLength[1]; y++ )
+					for( int x=0; x<dimLength[0]; x++ )
+						retData[localOffset++] = getDataFull()[ convert3DIndex( lowBoundary[0] - blockLowInt[0] + x,
+																				lowBoundary[1] - blockLowInt[1] + y,
+																				lowBoundary[2] - blockLowInt[2] + z ) ];
+			return;
+		}
 
 		for( int z=0; z<dimLength[2]; z++ )
 		{
@@ -626,6 +772,61 @@ public:
 		return datastore.getData();
 	}// end function
 
+	/**
+	 * Raw data accessor function.
+	 * Non-virtual access to the padded array for kernels: index (x, y, z) of
+	 * the span is the padded point (x, y, z), as in getDataAt( x, y, z ).
+	 * Only for the linear layout.
+	 * @return Span of the entire field, with pad.
+	 */
+	ITL_fieldspan<T>
+	getSpan()
+	{
+		assert( !layout.isBricked() );
+		int dimWithPad[4] = { 1, 1, 1, 1 };
+		grid.getSizeWithPad( dimWithPad );
+
+		return ITL_fieldspan<T>( getDataFull(), dimWithPad[0], dimWithPad[1], dimWithPad[2] );
+	}// end function
+
+	/**
+	 * Strided raw data accessor function.
+	 * View of a box of the field, optionally taking every step-th point along
+	 * each axis, without copying it.
+	 * @param lowBoundary Lower bound along each dimension (inclusive, in global space;
+	 * the pad lies just below the lower and above the higher bound of the field).
+	 * @param highBoundary Higher bound along each dimension (inclusive).
+	 * @param step Sampling step along each dimension (NULL for every point).
+	 * @return Span of the box.
+	 */
+	ITL_fieldspan<T>
+	getSpan( int* lowBoundary, int* highBoundary, int* step = NULL )
+	{
+		ITL_fieldspan<T> full = getSpan();
+		ITL_fieldspan<T> box;
+		int blockLowInt[4] = { 0, 0, 0, 0 };
+		int blockHighInt[4];
+		int lowPad[4] = { 0, 0, 0, 0 };
+		int highPad[4];
+		grid.getBounds( blockLowInt, blockHighInt );
+		grid.getPadSize( lowPad, highPad );
+
+		box.data = full.data;
+		for( int i=0; i<3; i++ )
+		{
+			int l = ( i < grid.getNumDim() ) ? lowBoundary[i] - blockLowInt[i] + lowPad[i] : 0;
+			int h = ( i < grid.getNumDim() ) ? highBoundary[i] - blockLowInt[i] + lowPad[i] : 0;
+			int s = ( step != NULL && i < grid.getNumDim() ) ? step[i] : 1;
+			assert( l >= 0 && h < full.dim[i] && s > 0 );
+
+			box.data += l*full.stride[i];
+			box.dim[i] = ( h >= l ) ? ( h - l ) / s + 1 : 0;
+			box.stride[i] = s*full.stride[i];
+		}
+
+		return box;
+	}// end function
+
 	virtual int
 	getSize()
 	{
@@ -748,7 +949,7 @@ public:
 	{
 		// Convert index to 1D
 		//int index1d = this->grid->convert3DIndex( x, y, z );
-		int index1d = grid.convert3DIndex( x, y, z );
+		int index1d = convert3DIndex( x, y, z );
 
 		// Set data
 		//this->datastore->array[index1d] = data;
@@ -766,7 +967,7 @@ public:
 
 	/**
 	 * Data mutator function type 4.
-	 * Sets data for entire field (shallow copy).
+	 * Sets data for entire field (shallow copy: the field views the data, which the caller keeps owning).
 	 * @param data pointer to data
 	 */
 	virtual void
@@ -789,12 +990,98 @@ public:
 	}// end function
 
 
+	/**
+	 * Function for 3D index (padded space) to datastore index conversion, in the layout of the field.
+	 */
 	int
 	convert3DIndex( int x, int y, int z )
 	{
-		return grid.convert3DIndex( x, y, z );
+		return layout.isBricked() ? layout.convert3DIndex( x, y, z ) : grid.convert3DIndex( x, y, z );
+	}
+
+	/**
+	 * Memory layout set function.
+	 * Reorders the data in place. In the bricked layout the datastore holds
+	 * whole bricks (getBrickLayout().getStorageSize() points, no longer in
+	 * x-fastest order): read it through convert3DIndex, getDataAt( x, y, z ),
+	 * getDataBetween or the layout-aware kernels (ITL_neighborhood,
+	 * ITL_localentropy), not as a linear array. getSpan is for linear fields only.
+	 * @param layoutType LAYOUT_LINEAR or LAYOUT_BRICKED.
+	 * @param brickSize Number of points along each axis of a brick (power of two).
+	 */
+	void
+	setLayout( int layoutType, int brickSize = 8 )
+	{
+		assert( layoutType == LAYOUT_LINEAR || layoutType == LAYOUT_BRICKED );
+		if( layoutType == getLayout() && ( layoutType == LAYOUT_LINEAR || brickSize == layout.getBrickSize() ) )
+			return;
+
+		int dimWithPad[4] = { 1, 1, 1, 1 };
+		grid.getSizeWithPad( dimWithPad );
+		int nPointWithPad = dimWithPad[0] * dimWithPad[1] * dimWithPad[2];
+
+		// Back to the linear order first
+		if( layout.isBricked() )
+		{
+			ITL_datastore<T> linear;
+			linear.init( nPointWithPad );
+			layout.toLinear( getDataFull(), linear.getData() );
+			datastore = linear;
+			layout = ITL_bricklayout();
+		}
+
+		if( layoutType == LAYOUT_BRICKED )
+		{
+			ITL_bricklayout bricked;
+			bricked.init( dimWithPad, brickSize );
+			ITL_datastore<T> storage;
+			storage.init( bricked.getStorageSize() );
+			bricked.toBricked( getDataFull(), storage.getData() );
+			datastore = storage;
+			layout = bricked;
+		}
+	}// end function
+
+	/**
+	 * @return LAYOUT_LINEAR or LAYOUT_BRICKED.
+	 */
+	int
+	getLayout() const
+	{
+		return layout.isBricked() ? LAYOUT_BRICKED : LAYOUT_LINEAR;
+	}
+
+	/**
+	 * @return Index mapping of the bricked layout.
+	 */
+	const ITL_bricklayout&
+	getBrickLayout() const
+	{
+		return layout;
+	}
+
+	/**
+	 * @return TRUE if the data of the field is shared with other fields or owned by the caller.
+	 */
+	bool
+	isDataShared() const
+	{
+		return datastore.isShared();
 	}
 
+private:
+
+	void
+	initData( T* data, int ndata, bool toCopy )
+	{
+		if( toCopy )
+			datastore.init( data, ndata );
+		else
+			datastore.initView( data, ndata );
+	}
+
+public:
+
 	/**
 	 * Destructor.
 	 */
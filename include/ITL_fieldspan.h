@@ -0,0 +1,96 @@
+/**
+ * Raw view of the data of a regular field.
+ * A typed data pointer with a size and an element stride along each axis, so
+ * that kernels can read and write a field (or a box or sub-sampling of it)
+ * with plain pointer arithmetic instead of a virtual getDataAt/setDataAt call
+ * per element. A span does not own its data: it is valid as long as the field
+ * it was taken from keeps its datastore.
+ * Created on: Oct 17, 2026.
+ * @see ITL_field_regular::getSpan
+ */
+
+#ifndef ITL_FIELDSPAN_H_
+#define ITL_FIELDSPAN_H_
+
+#include "ITL_header.h"
+
+template <class T>
+struct ITL_fieldspan
+{
+	T* data;			/**< Element at (0, 0, 0) of the span. */
+	int dim[3];			/**< Number of elements along each axis. */
+	size_t stride[3];	/**< Distance, in elements, between neighbors along each axis. */
+
+	/**
+	 * Default constructor: an empty span.
+	 */
+	ITL_fieldspan()
+	{
+		data = NULL;
+		dim[0] = dim[1] = dim[2] = 0;
+		stride[0] = stride[1] = stride[2] = 0;
+	}// end constructor
+
+	/**
+	 * Constructor for a dense x-fastest array.
+	 * @param ptr Pointer to the first element.
+	 * @param nx Number of elements along x.
+	 * @param ny Number of elements along y.
+	 * @param nz Number of elements along z.
+	 */
+	ITL_fieldspan( T* ptr, int nx, int ny, int nz )
+	{
+		data = ptr;
+		dim[0] = nx;
+		dim[1] = ny;
+		dim[2] = nz;
+		stride[0] = 1;
+		stride[1] = (size_t)nx;
+		stride[2] = (size_t)nx*ny;
+	}// end constructor
+
+	/**
+	 * Element accessor function.
+	 * @param x x-coordinate in the span.
+	 * @param y y-coordinate in the span.
+	 * @param z z-coordinate in the span.
+	 * @return Reference to the element.
+	 */
+	T&
+	at( int x, int y, int z ) const
+	{
+		return data[ x*stride[0] + y*stride[1] + z*stride[2] ];
+	}// end function
+
+	/**
+	 * Row accessor function.
+	 * @return Pointer to the first element of row (y, z); its elements are stride[0] apart.
+	 */
+	T*
+	row( int y, int z ) const
+	{
+		return data + y*stride[1] + z*stride[2];
+	}// end function
+
+	/**
+	 * @return Number of elements in the span.
+	 */
+	size_t
+	getSize() const
+	{
+		return (size_t)dim[0]*dim[1]*dim[2];
+	}// end function
+
+	/**
+	 * @return TRUE if the elements of the span are one dense array, so that
+	 * data[0..getSize()-1] can be scanned as a flat loop.
+	 */
+	bool
+	isContiguous() const
+	{
+		return stride[0] == 1 && stride[1] == (size_t)dim[0] && stride[2] == (size_t)dim[0]*dim[1];
+	}// end function
+};
+
+#endif
+/* ITL_FIELDSPAN_H_ */
@@ -14,14 +14,19 @@
 #include "ITL_histogram.h"
 #include "ITL_histogrammapper.h"
 #include "ITL_entropycore.h"
+#include "ITL_pool.h"
 
-template <class T>
+/**
+ * @tparam T Type of the field values.
+ * @tparam B Type of the bin Ids (int, uint16_t or uint8_t, see ITL_histogrammapper::getBinIdSize).
+ */
+template <class T, class B = int>
 class ITL_globalentropy
 {
 public:
 
 	ITL_field<T> *dataField;				/**< A scalar field containing field data (PLAN TO REMOVE) */
-	ITL_field_regular<int>* binData;		/**< A scalar field containing histogram bins corresponding to field points. (created or deleted elsewhere) */
+	ITL_field_regular<B>* binData;			/**< A scalar field containing histogram bins corresponding to field points. (created or deleted elsewhere) */
 
 	T histogramMin;							/**< Lower limit of histogram range (PLAN TO REMOVE) */
 	T histogramMax;							/**< Upper limit of histogram range (PLAN TO REMOVE) */
@@ -34,6 +39,7 @@ public:
 	// ADD-BY-ABON 11/07/2011
 	ITL_histogram *histogram;				/**< Pointer to the histogram class (created or deleted elsewhere). */
 	int nBin;								/**< Number of bins used for histogram computation. */
+	ITL_pool* pool;							/**< Optional pool the frequency lists are taken from (created or deleted elsewhere). */
 
 public:
 
@@ -46,6 +52,7 @@ public:
 		binData = NULL;
 		histogramRangeSet = false;
 		histogram = hist;
+		pool = NULL;
 
 		freqList = NULL;
 		normFreqList = NULL;
@@ -54,18 +61,29 @@ public:
 
 	/**
 	 * Constructor
+	 * @param p Optional pool the frequency lists are taken from, e.g. when a
+	 * computer is created per block; it must outlive this object.
 	 */
-	ITL_globalentropy( ITL_field_regular<int> *binF, ITL_histogram *hist, int nbin )
+	ITL_globalentropy( ITL_field_regular<B> *binF, ITL_histogram *hist, int nbin, ITL_pool* p = NULL )
 	{
 		binData = binF;
 		histogram = hist;
 		nBin = nbin;
+		pool = p;
 
 		freqList = NULL;
 		normFreqList = NULL;
 
-		freqList = new int[nBin];
-		normFreqList = new float[nBin];
+		if( pool != NULL )
+		{
+			freqList = pool->acquire<int>( nBin );
+			normFreqList = pool->acquire<float>( nBin );
+		}
+		else
+		{
+			freqList = new int[nBin];
+			normFreqList = new float[nBin];
+		}
 
 	}// End constructor
 
@@ -74,6 +92,12 @@ public:
 	 */
 	~ITL_globalentropy()
 	{
+		if( pool != NULL )
+		{
+			pool->release( normFreqList );
+			pool->release( freqList );
+			return;
+		}
 		if( freqList != NULL ) delete [] freqList;
 		if( normFreqList != NULL ) delete [] normFreqList;
 	}
@@ -174,12 +198,34 @@ public:
 		ITL_histogrammapper<int>::computeHistogramFrequencies( &binData, freqList, nBin );
 
 		// Normalize the frequencies
-		float nPoint = (float)binData->getSize();
-		for( int i=0; i<nBin; i++ )
-			normFreqList[i] = freqList[i] / nPoint;
+		normalizeFrequencies( binData->getSize() );
 
 	}
 
+	/**
+	 * Fused global entropy computation function.
+	 * Bins and counts the field in a single streaming pass, without the bin
+	 * field, so that the entropy costs one read of the data (see
+	 * ITL_histogrammapper::computeHistogramFrequencies_Scalar and _Vector).
+	 * The bin field given to the constructor is not used and can be NULL.
+	 * @param dataField Scalar (T = SCALAR) or vector (T = VECTOR3) field.
+	 * @param histMapper Mapper with the histogram range (scalars, see
+	 * ITL_histogrammapper::setHistogramRange) or the histogram (vectors).
+	 * @param toNormalize TRUE indicates that the computed entropy value needs to be normalized.
+	 */
+	void
+	computeGlobalEntropyDirect( ITL_field_regular<T>* dataField, ITL_histogrammapper<T>* histMapper, bool toNormalize )
+	{
+		assert( freqList != NULL );
+		assert( normFreqList != NULL );
+
+		computeFrequenciesDirect( dataField, histMapper );
+		normalizeFrequencies( dataField->getSize() );
+
+		globalEntropy = ITL_entropycore::computeEntropy_HistogramBased( freqList,
+										  dataField->getSize(), nBin, toNormalize );
+	}// End function
+
 	/**
 	 * Histogram frequency data accessor function.
 	 * Returns pointer to integer array storing the histogram freqencies.
@@ -218,6 +264,27 @@ public:
 	{
 		return this->globalEntropy;
 	}// end function
+
+private:
+
+	void
+	normalizeFrequencies( int nPoint )
+	{
+		for( int i=0; i<nBin; i++ )
+			normFreqList[i] = freqList[i] / (float)nPoint;
+	}
+
+	void
+	computeFrequenciesDirect( ITL_field_regular<SCALAR>* dataField, ITL_histogrammapper<SCALAR>* histMapper )
+	{
+		histMapper->computeHistogramFrequencies_Scalar( dataField, freqList, nBin );
+	}
+
+	void
+	computeFrequenciesDirect( ITL_field_regular<VECTOR3>* dataField, ITL_histogrammapper<VECTOR3>* histMapper )
+	{
+		histMapper->computeHistogramFrequencies_Vector( dataField, freqList, nBin );
+	}
 };
 
 #endif
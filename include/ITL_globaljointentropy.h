@@ -11,6 +11,7 @@
 #include "ITL_header.h"
 #include "ITL_field_regular.h"
 #include "ITL_entropycore.h"
+#include "ITL_sparsehistogram.h"
 
 template <class T>
 class ITL_globaljointentropy
@@ -38,10 +39,10 @@ public:
 	{
 		//this->dataField1 = f1;
 		//this->dataField2 = f2;
-		this->binData = NULL;
+		this->binData = f;
 		this->jointFreqList = NULL;
 		//histogramRangeSet = false;
-		//histogram = hist;
+		histogram = hist;
 	}
 	
 	/**
@@ -264,32 +265,30 @@ public:
 	{
 		// Scan through bin Ids and keep count
 		if( jointFreqList == NULL ) jointFreqList = new int[nBin*nBin];
-		for( int i=0; i<nBin*nBin; i++ )
-			jointFreqList[i] = 0;
 		//for( int i=0; i<binData->grid->nVertices; i++ )
 			//jointFreqList[ binData->datastore->array[i] ] ++;
-		for( int i=0; i<binData->getSize(); i++ )
-			jointFreqList[ binData->getDataAt(i) ] ++;
+		memset( jointFreqList, 0, sizeof(int)*nBin*nBin );
+		const int* binIds = binData->getDataFull();
+		int nPoint = binData->getSize();
+		for( int i=0; i<nPoint; i++ )
+			jointFreqList[ binIds[i] ] ++;
 	}
 
 	/**
 	 * Global joint Entropy computation function.
-	 * Creates a scalar field that contains entropy at each grid vertex.
+	 * Only the occupied joint bins are stored; call computeJointHistogramFrequencies for the dense list.
 	 * @param nBins Number of bins used in histogram computation.
 	 */
 	void computeGlobalJointEntropyOfField( int nBin, bool toNormalize, int method = 0 )
 	{
 		if( method == 0 )
 		{
-			// Check if frequencies are already computed from bin Ids
-			// If not, only then compute frequencies from bin Ids
-			computeJointHistogramFrequencies( nBin*nBin );
-
-			// Compute entropy from joint frequency list
-			this->globalJointEntropy = ITL_entropycore::computeEntropy_HistogramBased( this->binData->getDataFull(),
-																					   this->jointFreqList,
-																					   this->binData->getSize(),
-																					   nBin*nBin, toNormalize );
+			// Count the combined bin Ids into a sparse joint histogram
+			ITL_sparsehistogram jointHistogram( min( binData->getSize(), nBin*nBin ) );
+			jointHistogram.add( this->binData->getDataFull(), this->binData->getSize() );
+
+			// Compute entropy from the occupied joint bins
+			this->globalJointEntropy = jointHistogram.computeEntropy( nBin*nBin, toNormalize );
 
 		}
 
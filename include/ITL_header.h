@@ -22,6 +22,7 @@
 #include <cmath>
 #include <cassert>
 #include <float.h>
+#include <stdint.h>
 #include <ctime>
 #include <vector>
 #include <string>
@@ -43,9 +44,6 @@ const double	eps = 1.0E-6;
 #define CLOCKS_PER_MS CLOCKS_PER_SEC/1000.0f
 //#define DEBUG_MODE
 
-//#define DUPLICATE
-#define MIRROR
-
 #define VERY_HIGH_VALUE 1.0E6;
 
 #endif
@@ -12,6 +12,7 @@
 
 #include "ITL_header.h"
 #include "ITL_vectormatrix.h"
+#include "ITL_histogramtable.h"
 // ADD-BY-Tzu-Hsuan-BEGIN-02/13
 #include "ITL_util.h"
 #include "ITL_field_regular.h"
@@ -26,23 +27,15 @@ public:
 	};
 	// ADD-BY-LEETEN 10/07/2011-END
 
-	float* theta[5];					/**< Angle variable. Angle related to spherical coordinates. */
-	float* phi[5];						/**< Angle variable. Angle related to spherical coordinates. */
-	float* thetaCenter[5];				/**< Angle variable. Angle related to spherical coordinates. */
-	float* phiCenter[5];				/**< Angle variable. Angle related to spherical coordinates. */
-	VECTOR3* binCenter[5];
-
+	/**
+	 * How mapVectorsToBins converts vectors to bins.
+	 */
+	enum {
+		VECTOR_BINNING_SPHERICAL = 0,	/**< Spherical coordinates and the angle map (default). */
+		VECTOR_BINNING_CUBEMAP = 1		/**< Cube-map cells; no trigonometry, approximate near patch borders. */
+	};
 
-	bool bIsAngleMapInitialized[5];	/**< Boolean flag. Flag is set if the angle maps have been initialized. */
-	bool bIsPatchRead;				/**< Boolean flag. Flag is set if the patch file has been read. */
-	
-	int nResolution;				/**< Number of histogram resolutions available, maximum 5 available */
-	int nBin[5];					/**< Histogram parameter. Numer of bins. */
-	int iNrOfThetas[5];				/**< Histogram parameter. Number of thetas.  */
-	int iNrOfPhis[5];				/**< Histogram parameter. Number of phis.  */
-	float fNrOfThetas[5];			/**< Histogram parameter. Number of phis.  */
-	float fNrOfPhis[5];				/**< Histogram parameter. Number of phis.  */
-	int* piAngleMap[5];			/**< Histogram parameter. Mapping from vector to a region in sperical coordinates.  */
+	ITL_histogramtable* table;		/**< Shared, read-only lookup tables. */
 
 	// ADD-BY-Tzu-Hsuan-BEGIN-02/13
 	float histogramLow;
@@ -53,6 +46,9 @@ public:
 	bool hist_RangeSet;
 	// ADD-BY-Tzu-Hsuan-END-02/13
 
+	int vectorBinningMode;			/**< Vector binning mode, one of VECTOR_BINNING_*. */
+	int iCubeMapResolution[ITL_histogramtable::MAX_NR_OF_RESOLUTIONS];	/**< Cube map. Number of cells along each side of a face, 0 if not selected. */
+	const int* piCubeMap[ITL_histogramtable::MAX_NR_OF_RESOLUTIONS];	/**< Cube map. Mapping from cube-map cell to patch index (owned by the table). */
 
 public:
 
@@ -60,11 +56,13 @@ public:
 	 * Constructor.
 	 * @param patchFileName Path of patch file on disc.
 	 * @param nBins Desired number of bins in the histogram.
+	 * @param cacheFileName Optional binary cache of the tables. It is mapped
+	 * if it matches the bins and the patches, otherwise the patches are read and the cache is written.
 	 */
 	// MOD-BY-LEETEN 10/07/2011-FROM:
 		// ITL_histogram( const char* patchFileName, int nBins );
 	// TO:
-	ITL_histogram( const char* patchFileName, int nbin = DEFAULT_NR_OF_BINS );
+	ITL_histogram( const char* patchFileName, int nbin = DEFAULT_NR_OF_BINS, const char* cacheFileName = NULL );
 	// MOD-BY-LEETEN 10/07/2011-END
 	
 	/**
@@ -72,41 +70,44 @@ public:
 	 * @param patchfilename Path of patch file on disc.
 	 * @param nbin Desired number of bins in the histogram.
 	 * @param nresoltion Number of resolutions of the historgam.
+	 * @param cacheFileName Optional binary cache of the tables of all resolutions.
 	 */	
-	ITL_histogram( const char** patchfilename, int *nbin, int nresolution );
-	
+	ITL_histogram( const char** patchfilename, int *nbin, int nresolution, const char* cacheFileName = NULL );
+
 	/**
-	 * Histogram initialization function.
-	 * @param patchFileName Path of patch file on disc.
-	 * @param nBins Desired number of bins in the histogram.
+	 * Constructor sharing existing lookup tables.
+	 * Use one ITL_histogram per thread (or per computation) on the same table;
+	 * the table is not copied.
+	 * @param sharedTable Lookup tables; an owner is added.
 	 */
-	// MOD-BY-LEETEN 10/07/2011-FROM:
-		// static void ITL_init_histogram( const char* patchFileName, int nBins );
-	// TO:
-	void ITL_init_histogram( const char* patchFileName, int iRes = 0 );
-	// MOD-BY-LEETEN 10/07/2011-END
+	ITL_histogram( ITL_histogramtable* sharedTable );
 
 	/**
-	 * Patch header reader. Reads patch information from the in-built header.
-	 * 
+	 * Copy constructor. The copy shares the lookup tables.
 	 */
-	void readPatches_header();
+	ITL_histogram( const ITL_histogram& that );
+
 	/**
-	 * Patch file reader.
-	 * @param patchFileName Path of patch file on disc.
-	 *
+	 * Assignment operator. Shares the lookup tables of the other histogram.
 	 */
-	void readPatches_region( const char* patchFileName, int iRes = 0 );
+	ITL_histogram& operator= ( const ITL_histogram& that );
+
 	/**
-	 * Actual angle map computation doen here.
-	 * @param nBins Desired number of bins in the histogram.
+	 * Destructor. Releases the lookup tables.
 	 */
-	void ITL_compute_table();
+	~ITL_histogram();
+
 	/**
-	 * Actual angle map computation doen here.
-	 * @param nBins Desired number of bins in the histogram.
+	 * @return The shared lookup tables.
 	 */
-	void ITL_compute_table( int iRes );
+	ITL_histogramtable* getTable() const;
+
+	/**
+	 * Angle map cache writer.
+	 * @param cacheFileName Path of the cache file.
+	 * @return false if the cache could not be written.
+	 */
+	bool writeAngleMapCache( const char* cacheFileName );
 
 	/**
 	 * Actual angle map computation done here.
@@ -133,6 +134,40 @@ public:
 	 */
 	int get_bin_number_3D(VECTOR3 v, int iRes = 0 );
 
+	/**
+	 * Batch vector-to-bin conversion routine.
+	 * Converts contiguous (x, y, z) triples to patch indices with the same
+	 * lookup table as get_bin_number_3D (or the cube map, see setVectorBinningMode).
+	 * @param xyz Array of n vectors stored as x0 y0 z0 x1 y1 z1 ...
+	 * @param n Number of vectors.
+	 * @param out Array of n bin ids.
+	 * @param iRes Resolution of the histogram.
+	 */
+	void mapVectorsToBins( const float* xyz, size_t n, int* out, int iRes = 0 );
+	void mapVectorsToBins( const float* xyz, size_t n, uint16_t* out, int iRes = 0 );
+	void mapVectorsToBins( const float* xyz, size_t n, uint8_t* out, int iRes = 0 );
+
+	/**
+	 * Batch vector-to-bin conversion routine for vectors stored as separate components.
+	 * @param x Array of n x-components.
+	 * @param y Array of n y-components.
+	 * @param z Array of n z-components.
+	 * @param n Number of vectors.
+	 * @param out Array of n bin ids.
+	 * @param iRes Resolution of the histogram.
+	 */
+	void mapVectorsToBins( const float* x, const float* y, const float* z, size_t n, int* out, int iRes = 0 );
+	void mapVectorsToBins( const float* x, const float* y, const float* z, size_t n, uint16_t* out, int iRes = 0 );
+	void mapVectorsToBins( const float* x, const float* y, const float* z, size_t n, uint8_t* out, int iRes = 0 );
+
+	/**
+	 * Selects how mapVectorsToBins converts vectors to bins.
+	 * The cube map is taken from the shared table, which builds it once.
+	 * @param mode One of VECTOR_BINNING_*.
+	 * @param nFaceRes Number of cube-map cells along each side of a face (0 for nBin/2).
+	 */
+	void setVectorBinningMode( int mode, int nFaceRes = 0 );
+
 	/**
 	 * 2D Vector-to-bin conversion Routine.
 	 * Function converts the vector from Cartesian coodinates to the patch index
@@ -168,6 +203,16 @@ public:
 	 */
 	VECTOR3 getXYZ( float theta, float phi );
 
+private:
+
+	void initializeState();
+
+	template <class B>
+	void mapVectorsToBinsCore( const float* x, const float* y, const float* z, size_t stride,
+							   size_t n, B* out, int iRes );
+
+public:
+
 	// ADD-BY-Tzu-Hsuan-BEGIN-02/13
 	int crossValidateSpeedUp( ITL_field_regular<SCALAR> *scalarField, char *fieldType, int nMax, int start, int step);
 	void computeHistogramBinField_h( ITL_field_regular<SCALAR> *scalarField, char *fieldType, int nBin, char* binMapFile);
@@ -15,8 +15,11 @@
 #include "ITL_statutil.h"
 #include "ITL_histogram.h"
 #include "ITL_trianglepatch.h"
+#include "ITL_sphericalhierarchy.h"
+#include "ITL_kde.h"
 //#include "ITL_geodesictree.h"
 #include "ITL_field_regular.h"
+#include "ITL_pool.h"
 
 //template<typename T>
 //inline bool isinf(T value)
@@ -34,19 +37,12 @@ class ITL_histogrammapper
 	SCALAR histogramMinArray[2], histogramMaxArray[2];
 	list<VECTOR3> vertexList[20];
 	VECTOR3** vertexList2;
+	int nGridLevel;					/**< Number of levels of vertexList2. */
 	list<ITL_trianglepatch> triangleList[20];
 
-	float* theta;					/**< Angle variable. Angle related to spherical coordinates. */
-	float* phi;						/**< Angle variable. Angle related to spherical coordinates. */
+	const ITL_histogramtable* geodesicTable;	/**< Angle map of the geodesic patches, built by computeTable1 (NULL until then). */
 
-	bool bIsAngleMapInitialized;    /**< Boolean flag. Flag is set if the angle maps have been initialized. */
-	bool bIsPatchRead;				/**< Boolean flag. Flag is set if the patch file has been read. */
-
-	int iNrOfThetas;				/**< Histogram parameter. Number of thetas.  */
-	int iNrOfPhis;					/**< Histogram parameter. Number of phis.  */
-	float fNrOfThetas;				/**< Histogram parameter. Number of phis.  */
-	float fNrOfPhis;				/**< Histogram parameter. Number of phis.  */
-	int* piAngleMap;				/**< Histogram parameter. Mapping from vector to a region in sperical coordinates. */
+	ITL_pool* pool;					/**< Optional pool the bin fields are taken from (created or deleted elsewhere). */
 
 
 
@@ -60,8 +56,68 @@ public:
 	{
 		this->histogram = hist;
 		histogramRangeSet = false;
+		vertexList2 = NULL;
+		nGridLevel = 0;
+		geodesicTable = NULL;
+		pool = NULL;
+	}
+
+	/**
+	 * Destructor.
+	 */
+	~ITL_histogrammapper()
+	{
+		if( geodesicTable != NULL )
+			geodesicTable->release();
+		for( int i=0; i<nGridLevel; i++ )
+			delete [] vertexList2[i];
+		delete [] vertexList2;
 	}
 
+	/**
+	 * Pool set function.
+	 * When set, the bin fields created by computeHistogramBinField_Scalar and
+	 * computeHistogramBinField_Vector take their data from the pool, and must
+	 * be given back with releaseBinField.
+	 * @param p Pool (owned by the caller), NULL to allocate bin fields with new.
+	 */
+	void setPool( ITL_pool* p )
+	{
+		pool = p;
+	}// end function
+
+	/**
+	 * Bin field release function.
+	 * Deletes a bin field created by this mapper (giving its data back to the pool, if any).
+	 * @param binField Pointer to the address of the bin field, set to NULL.
+	 */
+	template <class B>
+	void
+	releaseBinField( ITL_field_regular<B>** binField )
+	{
+		if( pool != NULL )
+			pool->releaseField( *binField );
+		else
+			delete (*binField);
+		(*binField) = NULL;
+	}// end function
+
+	/**
+	 * Bin Id size selection function.
+	 * Bin fields can store their Ids as uint8_t, uint16_t or int; the smallest
+	 * type that holds all bins cuts the memory and gather bandwidth of the bin
+	 * field by 4x or 2x.
+	 * @param nBin Number of bins.
+	 * @return Number of bytes per bin Id: 1 (uint8_t), 2 (uint16_t) or 4 (int).
+	 */
+	static int
+	getBinIdSize( int nBin )
+	{
+		if( nBin <= 256 )	return 1;
+		if( nBin <= 65536 )	return 2;
+		return 4;
+	}// end function
+
 	/**
 	 * 1D histogram range set function.
 	 * Sets the value range for a 1D histogram. Also sets a boolean indicator histogramRangeSet.
@@ -100,10 +156,12 @@ public:
 	 * @param dataField Pointer to the (scalar) field whose histogram is to be computed.
 	 * @param binField Pointer to the address of assigned for the bin-ID field to be computed in this function.
 	 * @param nBins Number of bins to use in histogram computation.
+	 * The bin Id type B must hold nBin bins (see getBinIdSize).
 	 */
+	template <class B>
 	void
 	computeHistogramBinField_Scalar( ITL_field_regular<T>* dataField,
-									 ITL_field_regular<int>** binField,
+									 ITL_field_regular<B>** binField,
 									 int nBin )
 	{
 		float low[4];
@@ -111,7 +169,7 @@ public:
 		int lowPad[4];
 		int highPad[4];
 		int neighborhoodSize[4];
-		SCALAR nextV, rangeValue;
+		SCALAR rangeValue;
 
 		assert( dataField->getDataFull() != NULL );
 
@@ -129,10 +187,10 @@ public:
 			printf( "binfield High Pad: %d %d %d\n", highPad[0], highPad[1], highPad[2] );
 			#endif
 
-			(*binField) = new ITL_field_regular<int>( dataField->getNumDim(),
-													  low, high,
-													  lowPad, highPad,
-													  neighborhoodSize );
+			(*binField) = createBinField<B>( dataField->getNumDim(),
+											  low, high,
+											  lowPad, highPad,
+											  neighborhoodSize );
 		}
 
 		// Compute the range over which histogram computation needs to be done
@@ -159,32 +217,40 @@ public:
 
 		// Scan through each point of the histogram field
 		// and convert field value to bin ID
-		int index1d = 0;
-		int binId = 0;
-		int dimWithPad[4];
-		(*binField)->getSizeWithPad( dimWithPad );
+		ITL_fieldspan<T> values = dataField->getSpan();
+		ITL_fieldspan<B> binIds = (*binField)->getSpan();
+		assert( values.getSize() == binIds.getSize() );
 
-		for( int z=0; z<dimWithPad[2]; z++ )
-		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					// Get scalar value at location
-					// ******************* Need to resolve typecast issue *************************
-					nextV = dataField->getDataAt( index1d );
+		mapScalarsToBins( values.data, (int)values.getSize(), histogramMin, binWidth, nBin, binIds.data );
 
-					// Obtain the binID corresponding to the value at this location
-					binId = (int)floor( ( nextV - histogramMin ) / binWidth  );
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-					(*binField)->setDataAt( index1d, binId );
+	}// end function
 
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
+	/**
+	 * Scalar to bin Id mapping kernel.
+	 * Same bins as clamping floor( ( v - minValue ) / binWidth ) to [0, nBin-1],
+	 * with the clamp done before the integer conversion so that the loop has no
+	 * branches and vectorizes (also at -O2 when built with OpenMP); NaN values
+	 * fall in bin 0.
+	 * @param values Array of scalar values.
+	 * @param nVal Number of values.
+	 * @param minValue Lower limit of the histogram range.
+	 * @param binWidth Width of each bin.
+	 * @param nBin Number of bins.
+	 * @param binIds Array of nVal bin Ids to be computed in this function.
+	 */
+	template <class S, class B>
+	static void
+	mapScalarsToBins( const S* values, int nVal, SCALAR minValue, float binWidth, int nBin, B* binIds )
+	{
+		const float lastBin = (float)( nBin-1 );
+		#pragma omp simd
+		for( int i=0; i<nVal; i++ )
+		{
+			float t = ( (SCALAR)values[i] - minValue ) / binWidth;
+			t = ( t >= 0.0f ) ? t : 0.0f;
+			t = ( t <= lastBin ) ? t : lastBin;
+			binIds[i] = (B)(int)t;
 		}
-
 	}// end function
 
 	/**
@@ -197,7 +263,7 @@ public:
 	void
 	computeHistogramBinField_Scalar_NS( SCALAR* scalarList, int nVal, int* binField, int nBin )
 	{
-		SCALAR nextV, rangeValue;
+		SCALAR rangeValue;
 
 		assert( scalarList != NULL );
 
@@ -226,19 +292,22 @@ public:
 
 		// Scan through each point of the histogram field
 		// and convert field value to bin ID
-		int binId = 0;
-
-		for( int i=0; i<nVal; i++ )
-		{
-			// Obtain the binID corresponding to the value at this location
-			binId = (int)floor( ( scalarList[i] - histogramMin ) / binWidth  );
-			binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-
-			binField[i] = binId;
-		}
+		mapScalarsToBins( scalarList, nVal, histogramMin, binWidth, nBin, binField );
 
 	}// end function
 
+	/**
+	 * Selects how vectors are converted to bins by the vector binning functions.
+	 * With ITL_histogram::VECTOR_BINNING_CUBEMAP the direction is looked up on
+	 * the dominant-axis cube face instead of going through spherical coordinates.
+	 * @param mode One of ITL_histogram::VECTOR_BINNING_*.
+	 * @param nFaceRes Number of cube-map cells along each side of a face (0 for default).
+	 */
+	void
+	setVectorBinningMode( int mode, int nFaceRes = 0 )
+	{
+		histogram->setVectorBinningMode( mode, nFaceRes );
+	}// end function
 
 	/**
 	 * Histogram bin assignment function for vector fields.
@@ -248,10 +317,12 @@ public:
 	 * @param nBin Number of bins to use in histogram computation.
 	 * @param iRes Optional (not in use at present).
 	 * @param binMapFile Optional (not in use at present).
+	 * The bin Id type B must hold the bin ids of the histogram (see getBinIdSize).
 	 */
+	template <class B>
 	void
 	computeHistogramBinField_Vector( ITL_field_regular<T>* dataField,
-			 	 	 	 	 	 	 ITL_field_regular<int>** binField,
+			 	 	 	 	 	 	 ITL_field_regular<B>** binField,
 			 	 	 	 	 	 	 int nBin,
 			 	 	 	 	 	 	 int iRes = 0,
 			 	 	 	 	 	 	 char* binMapFile = NULL )
@@ -264,7 +335,6 @@ public:
 		int dimWithPad[4];
 
 		assert( dataField->getDataFull() != NULL );
-		VECTOR3 nextV;
 
 		// Initialize the padded scalar field for histogram bins
 		if( (*binField) == NULL )
@@ -280,39 +350,21 @@ public:
 			printf( "binfield High Pad: %d %d %d\n", highPad[0], highPad[1], highPad[2] );
 			#endif
 
-			(*binField) = new ITL_field_regular<int>( dataField->getNumDim(),
-													  low, high,
-													  lowPad, highPad,
-													  neighborhoodSize );
+			(*binField) = createBinField<B>( dataField->getNumDim(),
+											  low, high,
+											  lowPad, highPad,
+											  neighborhoodSize );
 		}
 
-		// Scan through each point of the histogram field
-		// and convert field value to bin ID
-		int index1d = 0;
-		int binId = 0;
+		// Convert all the vectors of the histogram field to bin IDs at once;
+		// both fields store the padded grid contiguously in the same order
 		(*binField)->getSizeWithPad( dimWithPad );
+		int nPoint = dimWithPad[0] * dimWithPad[1] * dimWithPad[2];
+		B* binIds = (*binField)->getDataFull();
 
-		for( int z=0; z<dimWithPad[2]; z++ )
-		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					// Get vector at location
-					nextV = (VECTOR3)dataField->getDataAt( index1d );
-
-					// Obtain the binID corresponding to the value at this location
-					binId = histogram->get_bin_number_3D( nextV, iRes );
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-
-					// Set bin field
-					(*binField)->setDataAt( index1d, binId );
-
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
-		}
+		histogram->mapVectorsToBins( (const float*)dataField->getDataFull(), nPoint, binIds, iRes );
+		for( int i=0; i<nPoint; i++ )
+			binIds[i] = (B)ITL_util<int>::clamp( (int)binIds[i], 0, nBin-1 );
 
         // delete lPadHisto;
         // delete hPadHisto;
@@ -336,62 +388,57 @@ public:
 											 char* binMapFile = NULL )
 	{
 		assert( vecList != NULL );
-		VECTOR3 nextV;
-
-		// Scan through each point of the histogram field
-		// and convert field value to bin ID
-		int index1d = 0;
-		int binId = 0;
 
+		// Convert all the vectors to bin IDs at once
+		histogram->mapVectorsToBins( (const float*)vecList, nVec, binField, iRes );
 		for( int i=0; i<nVec; i++ )
-		{
-			nextV = vecList[i];
-
-			// Obtain the binID corresponding to the value at this location
-			binId = histogram->get_bin_number_3D( nextV, iRes );
-			//binId = getBinNumber3DViaTable( nextV, nBin );
-
-			binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-
-			binField[index1d] = binId;
-
-			// increment to the next grid vertex
-			index1d += 1;
-		}
+			binField[i] = ITL_util<int>::clamp( binField[i], 0, nBin-1 );
 
 	}// end function
 
 
 	/**
-	 * Function for reading the lookup table provided in the header file.
-	 * Generally not needed by the user.
+	 * Histogram bin assignment function for vector fields on a nested spherical hierarchy.
+	 * Creates a scalar field of finest-level patch Ids at each grid vertex; the
+	 * histograms of coarser levels follow from ITL_sphericalhierarchy::computeCoarseFrequencies.
+	 * @param dataField Pointer to the (vector) field whose histogram is to be computed.
+	 * @param binField Pointer to the address of assigned for the bin-ID field to be computed in this function.
+	 * @param hierarchy Nested spherical patches.
 	 */
 	void
-	readPatches_header( int nBin )
+	computeHistogramBinField_Vector_Hierarchical( ITL_field_regular<T>* dataField,
+												  ITL_field_regular<int>** binField,
+												  ITL_sphericalhierarchy* hierarchy )
 	{
-		static char szPatch[] = {
-		#include "ITL_patch.h"
-		};
+		float low[4];
+		float high[4];
+		int lowPad[4];
+		int highPad[4];
+		int neighborhoodSize[4];
+		int dimWithPad[4];
 
-		char *szToken = strtok(szPatch, "\n");
-		float f2Temp[2];
+		assert( dataField->getDataFull() != NULL );
+		assert( hierarchy != NULL );
 
-		for(int i=0;i<nBin; i++)
+		// Initialize the padded scalar field for histogram bins
+		if( (*binField) == NULL )
 		{
-			float fAngle_radian;
-			sscanf( szToken,"%f, %f", &f2Temp[0],&f2Temp[1] );
-			theta[i*2+0] = f2Temp[0];
-			theta[i*2+1] = f2Temp[1];
-			szToken = strtok(NULL, "\n");
-			//printf( "%f %f\n", f2Temp[0], f2Temp[1] );
-
-			sscanf(szToken,"%f, %f", &f2Temp[0],&f2Temp[1] );
-			phi[i*2+0] = f2Temp[0];
-			phi[i*2+1] = f2Temp[1];
-			szToken = strtok(NULL, "\n");
-			//printf( "%f %f\n", f2Temp[0], f2Temp[1] );
+			dataField->getBounds( low, high );
+			dataField->getPadSize( lowPad, highPad );
+			dataField->getNeighborhoodSize( neighborhoodSize );
+
+			(*binField) = new ITL_field_regular<int>( dataField->getNumDim(),
+													  low, high,
+													  lowPad, highPad,
+													  neighborhoodSize );
 		}
-	}
+
+		// Convert all the vectors to finest-level patch IDs at once
+		(*binField)->getSizeWithPad( dimWithPad );
+		int nPoint = dimWithPad[0] * dimWithPad[1] * dimWithPad[2];
+		hierarchy->mapVectorsToBins( (const float*)dataField->getDataFull(), nPoint, (*binField)->getDataFull() );
+
+	}// end function
 
 	/**
 	 * Alternate function for histogram bin assignment for vector fields.
@@ -412,7 +459,6 @@ public:
 		int lowPad[4];
 		int highPad[4];
 		int neighborhoodSize[4];
-		int dimWithPad[4];
 
 		assert( dataField->getDataFull() != NULL );
 		VECTOR3 nextV;
@@ -439,31 +485,21 @@ public:
 
 		// Scan through each point of the histogram field
 		// and convert field value to bin ID
-		int index1d = 0;
 		int binId = 0;
-		(*binField)->getSizeWithPad( dimWithPad );
+		ITL_fieldspan<T> values = dataField->getSpan();
+		ITL_fieldspan<int> binIds = (*binField)->getSpan();
+		int nPoint = (int)binIds.getSize();
 
-		for( int z=0; z<dimWithPad[2]; z++ )
+		for( int i=0; i<nPoint; i++ )
 		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					// Get vector at location
-					nextV = (VECTOR3)dataField->getDataAt( index1d );
-
-					// Obtain the binID corresponding to the value at this location
-					//binId = getBinNumber3D( nextV, &vertexList[nDivision-1], &triangleList[nDivision-1]  );
-					binId = getBinNumber3DViaTable( nextV, nBin );
-
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
+			// Get vector at location
+			nextV = (VECTOR3)values.data[i];
 
-					(*binField)->setDataAt( index1d, binId );
+			// Obtain the binID corresponding to the value at this location
+			//binId = getBinNumber3D( nextV, &vertexList[nDivision-1], &triangleList[nDivision-1]  );
+			binId = getBinNumber3DViaTable( nextV, nBin );
 
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
+			binIds.data[i] = ITL_util<int>::clamp( binId, 0, nBin-1 );
 		}
 
         // delete lPadHisto;
@@ -488,10 +524,8 @@ public:
 		int lowPad[4];
 		int highPad[4];
 		int neighborhoodSize[4];
-		int dimWithPad[4];
 
 		assert( dataField->getDataFull() != NULL );
-		T *nextV = new T();
 
 		// Initialize the padded scalar field for histogram bins
 		if( (*binField) == NULL )
@@ -508,32 +542,18 @@ public:
 
 		// Scan through each point of the histogram field
 		// and convert field value to bin ID
-		int index1d = 0;
 		int binId = 0;
-		(*binField)->getSizeWithPad( dimWithPad );
+		ITL_fieldspan<T> values = dataField->getSpan();
+		ITL_fieldspan<int> binIds = (*binField)->getSpan();
+		int nPoint = (int)binIds.getSize();
 
-		for( int z=0; z<dimWithPad[2]; z++ )
+		for( int i=0; i<nPoint; i++ )
 		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					// Get vector at location
-					*nextV = dataField->getDataAt( index1d );
-
-					// Obtain the binID corresponding to the value at this location
-					binId = histogram->get_bin_number_2D( *nextV, nBin );
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-					(*binField)->setDataAt( index1d, binId );
-
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
+			// Obtain the binID corresponding to the vector at this location
+			binId = histogram->get_bin_number_2D( values.data[i], nBin );
+			binIds.data[i] = ITL_util<int>::clamp( binId, 0, nBin-1 );
 		}
 
-        delete nextV;
-
 	}// end function
 
 	/**
@@ -555,7 +575,6 @@ public:
 		int lowPad[4];
 		int highPad[4];
 		int neighborhoodSize[4];
-		int dimWithPad[4];
 
 		// Compute bin width
 		float binWidthX = ( mMArray[1] - mMArray[0] ) / (float)nBin;
@@ -625,41 +644,21 @@ public:
 
 		// Scan through each point of the histogram field
 		// and convert field value to bin ID
-		int index1d = 0;
-		int binId = 0;
-		(*binFieldX)->getSizeWithPad( dimWithPad );
+		ITL_fieldspan<T> values = dataField->getSpan();
+		int* binIdsX = (*binFieldX)->getDataFull();
+		int* binIdsY = (*binFieldY)->getDataFull();
+		int* binIdsZ = (*binFieldZ)->getDataFull();
+		int nPoint = (int)values.getSize();
 
-		for( int z=0; z<dimWithPad[2]; z++ )
+		for( int i=0; i<nPoint; i++ )
 		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					//printf( "%d %d %d %d %d %d %d\n", dimWithPad[0], dimWithPad[1], dimWithPad[2], x, y, z, index1d );
-					// Get vector at location
-					nextV = (VECTOR3)dataField->getDataAt( index1d );
-					//nextV.Normalize();
-					//cout << nextV[0] << " " << nextV[1] << " " << nextV[2] << endl;
-
-					// Obtain the binID corresponding to the value at this location
-					binId = (int)floor( ( nextV.x() - mMArray[0] ) / binWidthX );
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-					(*binFieldX)->setDataAt( index1d, binId );
-
-					// Obtain the binID corresponding to the value at this location
-					binId = (int)floor( ( nextV.y() - mMArray[2] ) / binWidthY );
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-					(*binFieldY)->setDataAt( index1d, binId );
-
-					// Obtain the binID corresponding to the value at this location
-					binId = (int)floor( ( nextV.z() - mMArray[4] ) / binWidthZ );
-					binId = ITL_util<int>::clamp( binId, 0, nBin-1 );
-					(*binFieldZ)->setDataAt( index1d, binId );
-
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
+			// Get vector at location
+			nextV = (VECTOR3)values.data[i];
+
+			// Obtain the binID corresponding to each component at this location
+			binIdsX[i] = ITL_util<int>::clamp( (int)floor( ( nextV.x() - mMArray[0] ) / binWidthX ), 0, nBin-1 );
+			binIdsY[i] = ITL_util<int>::clamp( (int)floor( ( nextV.y() - mMArray[2] ) / binWidthY ), 0, nBin-1 );
+			binIdsZ[i] = ITL_util<int>::clamp( (int)floor( ( nextV.z() - mMArray[4] ) / binWidthZ ), 0, nBin-1 );
 		}
 		//cout << "data scan completed" << endl;
         // delete lPadHisto;
@@ -680,7 +679,6 @@ public:
 		int lowPad[4];
 		int highPad[4];
 		int neighborhoodSize[4];
-		T nextVField1, nextVField2;
 
 		//assert( this->dataField1->datastore->array != NULL );
 		//assert( this->dataField2->datastore->array != NULL );
@@ -716,39 +714,22 @@ public:
 		T rangeValue2 = histogramMaxArray[1] - histogramMinArray[1];
 		float binWidth2 = rangeValue2 / (float)nBin;
 
-		// Scan through each point of the histogram field
-		// and convert field value to bin ID
-		int index1d = 0;
-		int binId1, binId2, combinedBinId;
-		int dimWithPad[4];
-		dataField1->getSizeWithPad( dimWithPad );
-		for( int z=0; z<dimWithPad[2]; z++ )
-		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					// Get vector at this location from both fields individually
-					nextVField1 = dataField1->getDataAt( index1d );
-					nextVField2 = dataField1->getDataAt( index1d );
-
-					// Obtain the binID corresponding to the value at this location from both fields individually
-					binId1 = (int)floor( ( nextVField1 - histogramMinArray[0] ) / binWidth1  );
-					binId1 = ITL_util<int>::clamp( binId1, 0, nBin-1 );
-					binId2 = (int)floor( ( nextVField2 - histogramMinArray[1] ) / binWidth2  );
-					binId2 = ITL_util<int>::clamp( binId2, 0, nBin-1 );
+		// Obtain the bin IDs of both fields individually
+		ITL_fieldspan<T> values1 = dataField1->getSpan();
+		ITL_fieldspan<T> values2 = dataField2->getSpan();
+		int nPoint = (int)values1.getSize();
+		assert( values2.getSize() == values1.getSize() );
+		int* binIds = (*binField)->getDataFull();
+		int* binIds2 = new int[nPoint];
 
-					// Combine the two bin indices from the two fields
-					combinedBinId = binId2 * nBin + binId1;
+		mapScalarsToBins( values1.data, nPoint, histogramMinArray[0], binWidth1, nBin, binIds );
+		mapScalarsToBins( values2.data, nPoint, histogramMinArray[1], binWidth2, nBin, binIds2 );
 
-					// Store the bin ID
-					(*binField)->setDataAt( index1d, combinedBinId );
+		// Combine the two bin indices from the two fields
+		for( int i=0; i<nPoint; i++ )
+			binIds[i] = binIds2[i] * nBin + binIds[i];
 
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
-		}
+		delete [] binIds2;
 
 		// delete lPadHisto;
 		// delete hPadHisto;
@@ -774,8 +755,6 @@ public:
 
 		assert( dataField1->getDataFull() != NULL );
 		assert( dataField2->getDataFull() != NULL );
-		VECTOR3 nextVField1;
-		VECTOR3 nextVField2;
 
 		// Initialize the padded scalar field for histogram bins
 		if( (*binField) == NULL )
@@ -790,40 +769,101 @@ public:
 													  neighborhoodSize );
 		}
 
-		// Scan through each point of the histogram field
-		// and convert field value to bin ID
-		int index1d = 0;
+		// Obtain the bin IDs of both fields individually, in batches
 		dataField1->getSizeWithPad( dimWithPad );
-		for( int z=0; z<dimWithPad[2]; z++ )
+		int nPoint = dimWithPad[0] * dimWithPad[1] * dimWithPad[2];
+		int* binIds = (*binField)->getDataFull();
+		int* binIds2 = new int[nPoint];
+
+		histogram->mapVectorsToBins( (const float*)dataField1->getDataFull(), nPoint, binIds );
+		histogram->mapVectorsToBins( (const float*)dataField2->getDataFull(), nPoint, binIds2 );
+
+		// Combine the two bin indices from the two fields
+		for( int i=0; i<nPoint; i++ )
+			binIds[i] = binIds2[i] * nBin + binIds[i];
+
+		delete [] binIds2;
+
+	}// end function
+
+	/**
+	 * Fused histogram function for scalar fields.
+	 * Bins the values of the field and counts them in one streaming pass, a
+	 * cache-sized chunk of bin Ids at a time, without creating a bin field.
+	 * Gives the same counts as computeHistogramBinField_Scalar followed by
+	 * computeHistogramFrequencies. If no range is set, a min-max pass finds it
+	 * first, so set the range to read the data only once.
+	 * @param dataField Pointer to the (scalar) field whose histogram is to be computed.
+	 * @param freqList Array of nBin counts to be computed in this function.
+	 * @param nBin Number of bins to use in histogram computation.
+	 */
+	void
+	computeHistogramFrequencies_Scalar( ITL_field_regular<T>* dataField,
+										int* freqList,
+										int nBin )
+	{
+		assert( dataField->getDataFull() != NULL );
+		const T* values = dataField->getSpan().data;
+		int nPoint = dataField->getSize();
+
+		if( histogramRangeSet == false )
 		{
-			for( int y=0; y<dimWithPad[1]; y++ )
-			{
-				for( int x=0; x<dimWithPad[0]; x++ )
-				{
-					// Get vector at this location from both fields individually
-					nextVField1 = dataField1->getDataAt( index1d );
-					nextVField2 = dataField2->getDataAt( index1d );
+			histogramMin = ITL_util<SCALAR>::Min( (SCALAR*)values, nPoint );
+			histogramMax = ITL_util<SCALAR>::Max( (SCALAR*)values, nPoint );
+		}
+		float binWidth = ( histogramMax - histogramMin ) / (float)nBin;
 
-					// Obtain the binID corresponding to the value at this location from both fields individually
-					int binValue1 = histogram->get_bin_number_3D( nextVField1 );
-					int binValue2 = histogram->get_bin_number_3D( nextVField2 );
+		const int chunkSize = 4096;
+		int binIds[chunkSize];
+		vector<int> count( 4*nBin, 0 );
+		for( int i=0; i<nPoint; i+=chunkSize )
+		{
+			int n = min( chunkSize, nPoint - i );
+			mapScalarsToBins( values + i, n, histogramMin, binWidth, nBin, binIds );
+			accumulateBinIds( binIds, n, &count[0], nBin );
+		}
+		sumBinCounts( &count[0], freqList, nBin );
 
-					// Combine the two bin indices from the two fields
-					int combinedBin = binValue2 * nBin + binValue1;
+	}// end function
 
-					// Store the bin ID
-					(*binField)->setDataAt( index1d, combinedBin );
+	/**
+	 * Fused histogram function for vector fields.
+	 * Bins the vectors of the field and counts them in one streaming pass,
+	 * without creating a bin field. Gives the same counts as
+	 * computeHistogramBinField_Vector followed by computeHistogramFrequencies.
+	 * @param dataField Pointer to the (vector) field whose histogram is to be computed.
+	 * @param freqList Array of nBin counts to be computed in this function.
+	 * @param nBin Number of bins to use in histogram computation.
+	 * @param iRes Resolution of the histogram (see ITL_histogram::mapVectorsToBins).
+	 */
+	void
+	computeHistogramFrequencies_Vector( ITL_field_regular<T>* dataField,
+										int* freqList,
+										int nBin,
+										int iRes = 0 )
+	{
+		assert( dataField->getDataFull() != NULL );
+		const float* xyz = (const float*)dataField->getSpan().data;
+		int nPoint = dataField->getSize();
 
-					// increment to the next grid vertex
-					index1d += 1;
-				}
-			}
+		const int chunkSize = 4096;
+		int binIds[chunkSize];
+		vector<int> count( 4*nBin, 0 );
+		for( int i=0; i<nPoint; i+=chunkSize )
+		{
+			int n = min( chunkSize, nPoint - i );
+			histogram->mapVectorsToBins( xyz + 3*(size_t)i, n, binIds, iRes );
+			for( int j=0; j<n; j++ )
+				binIds[j] = ITL_util<int>::clamp( binIds[j], 0, nBin-1 );
+			accumulateBinIds( binIds, n, &count[0], nBin );
 		}
+		sumBinCounts( &count[0], freqList, nBin );
 
 	}// end function
 
+	template <class B>
 	static void
-	computeHistogramFrequencies( ITL_field_regular<int>** binField,
+	computeHistogramFrequencies( ITL_field_regular<B>** binField,
 								 int* freqList,
 								 int nBin )
 	{
@@ -831,18 +871,13 @@ public:
 		assert( freqList != NULL );
 
 		// Scan through bin Ids and keep count
-		for( int i=0; i<nBin; i++ )
-			freqList[i] = 0;
+		countBinIds( (*binField)->getSpan().data, (*binField)->getSize(), freqList, nBin );
 
-		for( int i=0; i<(*binField)->getSize(); i++ )
-		{
-			//cout << (*binField)->getDataAt(i) << endl;
-			freqList[ (*binField)->getDataAt(i) ] ++;
-		}
 	}// end function
 
+	template <class B>
 	static void
-	computeHistogramFrequencies( ITL_field_regular<int>** binField,
+	computeHistogramFrequencies( ITL_field_regular<B>** binField,
 								 float* freqList,
 								 int nBin )
 	{
@@ -850,22 +885,18 @@ public:
 		assert( freqList != NULL );
 
 		// Scan through bin Ids and keep count
-		for( int i=0; i<nBin; i++ )
-			freqList[i] = 0;
-
-		for( int i=0; i<(*binField)->getSize(); i++ )
-		{
-			//cout << (*binField)->getDataAt(i) << endl;
-			freqList[ (*binField)->getDataAt(i) ] ++;
-		}
+		int nPoint = (*binField)->getSize();
+		vector<int> count( nBin );
+		countBinIds( (*binField)->getSpan().data, nPoint, &count[0], nBin );
 
 		for( int i=0; i<nBin; i++ )
-			freqList[i] /= (float)(*binField)->getSize();
+			freqList[i] = (float)count[i] / (float)nPoint;
 
 	}// end function
 
+	template <class B>
 	static void
-	computeHistogramFrequencies( ITL_field_regular<int>** binField,
+	computeHistogramFrequencies( ITL_field_regular<B>** binField,
 								 double* freqList,
 								 int nBin )
 	{
@@ -873,18 +904,77 @@ public:
 		assert( freqList != NULL );
 
 		// Scan through bin Ids and keep count
+		int nPoint = (*binField)->getSize();
+		vector<int> count( nBin );
+		countBinIds( (*binField)->getSpan().data, nPoint, &count[0], nBin );
+
 		for( int i=0; i<nBin; i++ )
-			freqList[i] = 0;
+			freqList[i] = (double)count[i] / (float)nPoint;
+
+	}// end function
 
-		for( int i=0; i<(*binField)->getSize(); i++ )
+	/**
+	 * Bin counting kernel.
+	 * Increments of the same bin by consecutive points depend on each other,
+	 * so large arrays are counted into four interleaved sub-histograms that
+	 * are summed at the end.
+	 * @param binIds Array of bin Ids.
+	 * @param nPoint Number of bin Ids.
+	 * @param freqList Array of nBin counts to be computed in this function.
+	 * @param nBin Number of bins.
+	 */
+	template <class B>
+	static void
+	countBinIds( const B* binIds, int nPoint, int* freqList, int nBin )
+	{
+		memset( freqList, 0, sizeof(int)*nBin );
+		if( nPoint < 16*nBin )
 		{
-			//cout << (*binField)->getDataAt(i) << endl;
-			freqList[ (*binField)->getDataAt(i) ] ++;
+			for( int i=0; i<nPoint; i++ )
+				freqList[ binIds[i] ] ++;
+			return;
 		}
 
-		for( int i=0; i<nBin; i++ )
-			freqList[i] /= (float)(*binField)->getSize();
+		vector<int> count( 4*nBin, 0 );
+		accumulateBinIds( binIds, nPoint, &count[0], nBin );
+		sumBinCounts( &count[0], freqList, nBin );
+	}// end function
+
+	/**
+	 * Adds bin Ids to the four interleaved sub-histograms of countBinIds.
+	 * @param binIds Array of bin Ids.
+	 * @param nPoint Number of bin Ids.
+	 * @param count Array of 4*nBin counts, incremented in this function.
+	 * @param nBin Number of bins.
+	 */
+	template <class B>
+	static void
+	accumulateBinIds( const B* binIds, int nPoint, int* count, int nBin )
+	{
+		int* c0 = count;
+		int* c1 = c0 + nBin;
+		int* c2 = c1 + nBin;
+		int* c3 = c2 + nBin;
+		int i = 0;
+		for( ; i+4<=nPoint; i+=4 )
+		{
+			c0[ binIds[i] ] ++;
+			c1[ binIds[i+1] ] ++;
+			c2[ binIds[i+2] ] ++;
+			c3[ binIds[i+3] ] ++;
+		}
+		for( ; i<nPoint; i++ )
+			c0[ binIds[i] ] ++;
+	}// end function
 
+	/**
+	 * Sums the four sub-histograms of accumulateBinIds into freqList.
+	 */
+	static void
+	sumBinCounts( const int* count, int* freqList, int nBin )
+	{
+		for( int b=0; b<nBin; b++ )
+			freqList[b] = count[b] + count[nBin+b] + count[2*nBin+b] + count[3*nBin+b];
 	}// end function
 
 	static void
@@ -949,10 +1039,6 @@ public:
 			evalPointArray[i] = m + i * ( (M-m) / (nEvalPoint-1) );
 		}
 
-		// Initialize density array
-		for( int i=0; i<nEvalPoint; i++ )
-			densityArray[i] = 0;
-
 		// Estimate kernel bandwidth
 		double mu = ITL_statutil<float>::Mean( data, nPoint );
 		double var = ITL_statutil<float>::Variance( data, nPoint, mu );
@@ -961,35 +1047,15 @@ public:
 		#endif
 		if( h == 0 )
 		{
-			h = 1.06 * var * pow( nPoint,-0.2f ) ;
+			h = ITL_kde::estimateBandwidth( var, nPoint );
 		}
 		#ifdef DEBUG_MODE
 		printf( "Number of points in the field: %d\n", nPoint );
 		printf( "Kernel bandwidth: %f\n", h );
 		#endif
 
-		// Estimate densities at each evaluation point
-		double sumOfKernels = 0;
-		for( int i=0; i<nEvalPoint; i++ )
-		{
-			sumOfKernels = 0;
-			for( int j=0; j<nPoint; j++ )
-			{
-				double d = ITL_histogrammapper::evaluateGaussianKernel( ( evalPointArray[i] - data[j] ) / h, 0, 1 );
-				if( d != d  )
-				{
-					fprintf( stderr, "nan found: %d, %d, %g %g %g\n", i, j, evalPointArray[i], data[j], d );
-					exit(0);
-				}
-				//if( isinf( d )  )
-				//{
-				//	fprintf( stderr, "inf found: %d, %d, %g %g %g\n", i, j, evalPointArray[i], data[j], d );
-				//	exit(0);
-				//}
-				sumOfKernels += d;
-			}
-			densityArray[i] = sumOfKernels / (nPoint*h);
-		}
+		// Estimate densities at the evaluation points (binned, O(N + M log M))
+		ITL_kde::computeDensity( data, nPoint, h, m, M, nEvalPoint, densityArray );
 
 	}// End function
 
@@ -1361,6 +1427,61 @@ public:
 
 	}// End function
 
+	/**
+	 * Cross-validation for vector fields on a nested spherical hierarchy.
+	 * Only the finest level needs to be binned: the frequencies of every
+	 * coarser level are sums of child counts.
+	 * @param freqList Frequencies at the finest level of the hierarchy.
+	 * @param N Number of samples.
+	 * @param hierarchy Nested spherical patches.
+	 * @param nBinArray Number of bins of each level (size: number of levels).
+	 * @param scoreList Cross-validation score of each level (size: number of levels).
+	 * @param nBinOptimal Number of bins with the lowest score.
+	 */
+	void
+	crossValidate_hierarchical_vector( int* freqList, double N,
+									   ITL_sphericalhierarchy* hierarchy,
+									   int* nBinArray, double* scoreList,
+									   int* nBinOptimal )
+	{
+		int nLevel = hierarchy->getNumLevels();
+		int finest = nLevel-1;
+		int* freqListCur = new int[hierarchy->getNumBins( finest )];
+		double* normFreqListPtr = new double[hierarchy->getNumBins( finest )];
+		double minScore = 0;
+		int minScoreIndex = finest;
+
+		for( int i = finest; i>=0; i-- )
+		{
+			nBinArray[i] = hierarchy->getNumBins( i );
+			hierarchy->computeCoarseFrequencies( freqList, finest, freqListCur, i );
+
+			// Bin width is the solid angle of a patch
+			double h = ( 4*pi ) / (double)nBinArray[i];
+
+			for( int j=0; j<nBinArray[i]; j++ )
+				normFreqListPtr[j] = freqListCur[j] / N;
+
+			scoreList[i] = computeCrossValidationScore( normFreqListPtr, nBinArray[i], N, h );
+
+			#ifdef DEBUG_MODE
+			printf( "%d: %d, %g, %g\n", i, nBinArray[i], h, scoreList[i] );
+			#endif
+
+			if( i == finest || scoreList[i] < minScore )
+			{
+				minScore = scoreList[i];
+				minScoreIndex = i;
+			}
+		}
+
+		(*nBinOptimal) = nBinArray[minScoreIndex];
+
+		delete [] freqListCur;
+		delete [] normFreqListPtr;
+
+	}// End function
+
 	/**
 	 * Cross-validation score computation function.
 	 *
@@ -1489,6 +1610,10 @@ public:
 			level ++;
 		}
 
+		for( int i=0; i<nGridLevel; i++ )
+			delete [] vertexList2[i];
+		delete [] vertexList2;
+		nGridLevel = nDivision;
 		vertexList2 = new VECTOR3*[nDivision];
 		for( int i=0; i<nDivision; i++ )
 		{
@@ -1731,35 +1856,6 @@ public:
 
 	}// end function
 
-	/**
-	 * Function for pre-computating the mapping from spherical pathes to bin Ids.
-	 * Generally not needed by the user.
-	 */
-	void
-	computeTable( int nBin )
-	{
-		iNrOfThetas = nBin*2;							/**< Histogram parameter. Number of thetas.  */
-		iNrOfPhis = nBin;								/**< Histogram parameter. Number of phis.  */
-		fNrOfThetas = (float)iNrOfThetas;				/**< Histogram parameter. Number of phis.  */
-		fNrOfPhis = (float)iNrOfPhis;					/**< Histogram parameter. Number of phis.  */
-		piAngleMap = new int[iNrOfThetas*iNrOfPhis];	/**< Histogram parameter. Mapping from vector to a region in sperical coordinates.  */
-
-		for( int t = 0; t < iNrOfThetas; t++ )
-			for( int p = 0; p < iNrOfPhis; p++ )
-			{
-				float fTheta =	M_PI * 2.0f * float(t) / fNrOfThetas;
-				float fPhi =	M_PI * float(p) / fNrOfPhis;
-				int iBin = getBinByAngle( fTheta, fPhi, nBin );
-				//cout << iBin << endl;
-				if( iBin >= 0 )
-					piAngleMap[t*iNrOfPhis + p] = iBin;
-			}
-
-		// set the flag to true
-		bIsAngleMapInitialized = true;
-
-	}// end function
-
 	/**
 	 * Alternate function for pre-computating the mapping from spherical pathes to bin Ids.
 	 * Generally not needed by the user.
@@ -1779,10 +1875,10 @@ public:
 		double quadLen = sqrt( triangleArea );
 
 		// Compute minimum resolution of the table
-		iNrOfThetas = (int)((2*pi)/(double)quadLen);
-		iNrOfPhis = (int)(pi/(double)quadLen);
-		fNrOfThetas = (float)iNrOfThetas;
-		fNrOfPhis = (float)iNrOfPhis;
+		int iNrOfThetas = (int)((2*pi)/(double)quadLen);
+		int iNrOfPhis = (int)(pi/(double)quadLen);
+		float fNrOfThetas = (float)iNrOfThetas;
+		float fNrOfPhis = (float)iNrOfPhis;
 
 		#ifdef DEBUG_MODE
 		fprintf( stderr, "Triangular patch area: %g\n", triangleArea );
@@ -1791,7 +1887,7 @@ public:
 		#endif
 
 		// Allocate memory for lookup table entries
-		piAngleMap = new int[iNrOfThetas*iNrOfPhis];
+		int* piAngleMap = new int[iNrOfThetas*iNrOfPhis];
 
 		int unResolvedCount = 0;
 		int index = 0;
@@ -1815,6 +1911,7 @@ public:
 					piAngleMap[t*iNrOfPhis + p] = iBin;
 				else
 				{
+					piAngleMap[t*iNrOfPhis + p] = 0;
 					unResolvedCount ++;
 					printf( "Negative bin id: %d, theta: %g phi: %g\n", iBin, fTheta, fPhi );
 				}
@@ -1824,8 +1921,10 @@ public:
 			}// end inner for
 		}// end outer for
 
-		// set the flag to true
-		bIsAngleMapInitialized = true;
+		// Hand the map to a shared table
+		if( geodesicTable != NULL )
+			geodesicTable->release();
+		geodesicTable = new ITL_histogramtable( nBin, iNrOfThetas, iNrOfPhis, piAngleMap );
 	}
 
 	/**
@@ -1888,76 +1987,19 @@ public:
 
 	}// end function
 
-	int
-	getBinNumber3DViaTable( VECTOR3 v, int nBin )
-	{
-		// convert the vector from Cartesian coodinates to sphercial coordinates;
-		// the magnitude is ignored.
-		float mytheta = getAngle(v.x(), v.y());//0~2pi
-		float myphi = getAngle2(sqrt(v.x()*v.x()+v.y()*v.y()), v.z());//0~pi
-
-		//if( !theta || !phi )
-		//{
-		//	printf("read in the regions first\n");
-		//	return -1;
-		//}
-
-		if( bIsAngleMapInitialized == false )
-			computeTable( nBin );
-
-		// map the angle to the bin number
-		int iTheta	=	min( iNrOfThetas - 1,	int( fNrOfThetas * mytheta / (M_PI * 2.0)));
-		int iPhi	=	min( iNrOfPhis - 1, int( fNrOfPhis * myphi	/ M_PI));
-
-		return piAngleMap[ iTheta * iNrOfPhis + iPhi];
-	}
-
-
 	/**
-	 * Function to convert the angles in the spherical coordinates (mytheta, myphi) to the patch index
-	 * according to the lookup table composed of theta and phi. Generally not needed by the user.
-	 * @param binnum Number of entries in the lookup table.
+	 * Function for converting vectors to bin Ids via an angle map: the one of
+	 * the geodesic patches if computeTable1 was called, else the one of the histogram.
+	 * @param v Vector; the magnitude is ignored.
+	 * @param nBin Number of bins.
 	 */
 	int
-	getBinByAngle( float mytheta, float myphi, int binnum )
+	getBinNumber3DViaTable( VECTOR3 v, int nBin )
 	{
-		for(int i=0; i<binnum;i++)
-		{
-			if( (mytheta>=theta[i*2+0]) && (mytheta<=theta[i*2+1])&&
-				(myphi>=phi[i*2+0]) && (myphi<=phi[i*2+1])
-				)
-			{
-				return i;
-			}
-		}
-		for(int i=0; i<binnum;i++)
-		{
-			if( ((mytheta+2*pi)>=theta[i*2+0]) && ((mytheta+2*pi)<=theta[i*2+1])&&
-				(myphi>=phi[i*2+0]) && (myphi<=phi[i*2+1])
-				)
-			{
-				return i;
-			}
-		}
-		for(int i=0; i<binnum;i++)
-		{
-			if( ((mytheta)>=theta[i*2+0]) && ((mytheta)<=theta[i*2+1])&&
-				((myphi+2*pi)>=phi[i*2+0]) && ((myphi+2*pi)<=phi[i*2+1] )
-				)
-			{
-				return i;
-			}
-		}
-		for(int i=0; i<binnum;i++)
-		{
-			if( ((mytheta+2*pi)>=theta[i*2+0]) && ((mytheta+2*pi)<=theta[i*2+1])&&
-				((myphi+2*pi)>=phi[i*2+0]) && ((myphi+2*pi)<=phi[i*2+1])
-				)
-			{
-				return i;
-			}
-		}
-		return -1;
+		const ITL_histogramtable* table = ( geodesicTable != NULL ) ? geodesicTable : histogram->getTable();
+		assert( table->getNumBins() == nBin );
+
+		return table->get_bin_number_3D( v );
 	}
 
 	/*
@@ -2085,6 +2127,21 @@ public:
 		}
 	}
 
+private:
+
+	// The geodesic table is owned; mappers are not copied
+	ITL_histogrammapper( const ITL_histogrammapper& );
+	ITL_histogrammapper& operator= ( const ITL_histogrammapper& );
+
+	template <class B>
+	ITL_field_regular<B>*
+	createBinField( int ndim, float* low, float* high, int* lowPad, int* highPad, int* neighborhoodSize )
+	{
+		if( pool != NULL )
+			return pool->acquireField<B>( ndim, low, high, lowPad, highPad, neighborhoodSize );
+		return new ITL_field_regular<B>( ndim, low, high, lowPad, highPad, neighborhoodSize );
+	}
+
 };
 
 #endif
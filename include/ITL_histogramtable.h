@@ -0,0 +1,197 @@
+/**
+ * Histogram lookup table class.
+ * Immutable, reference-counted lookup tables of the spherical histogram:
+ * patch bounds, bin centers, the angle maps and the patch index of every
+ * resolution. All tables are complete when the constructor returns, so any
+ * number of threads and ITL_histogram instances can read them without locks.
+ * Per-computation state lives in ITL_histogram.
+ * Created on: Oct 17, 2026.
+ * @see ITL_histogram
+ */
+
+#ifndef ITL_HISTOGRAMTABLE_H_
+#define ITL_HISTOGRAMTABLE_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "ITL_header.h"
+#include "ITL_vectormatrix.h"
+#include "ITL_cubemap.h"
+
+class ITL_histogramtable
+{
+public:
+	enum {
+		MAX_NR_OF_RESOLUTIONS = 5,
+		ANGLE_MAP_CACHE_VERSION = 2
+	};
+
+private:
+	float* theta[MAX_NR_OF_RESOLUTIONS];			/**< Angle variable. Angle related to spherical coordinates. */
+	float* phi[MAX_NR_OF_RESOLUTIONS];				/**< Angle variable. Angle related to spherical coordinates. */
+	float* thetaCenter[MAX_NR_OF_RESOLUTIONS];		/**< Angle variable. Angle related to spherical coordinates. */
+	float* phiCenter[MAX_NR_OF_RESOLUTIONS];		/**< Angle variable. Angle related to spherical coordinates. */
+	VECTOR3* binCenter[MAX_NR_OF_RESOLUTIONS];
+
+	int nResolution;								/**< Number of histogram resolutions available. */
+	int nBin[MAX_NR_OF_RESOLUTIONS];				/**< Histogram parameter. Numer of bins. */
+	int iNrOfThetas[MAX_NR_OF_RESOLUTIONS];			/**< Histogram parameter. Number of thetas.  */
+	int iNrOfPhis[MAX_NR_OF_RESOLUTIONS];			/**< Histogram parameter. Number of phis.  */
+	float fNrOfThetas[MAX_NR_OF_RESOLUTIONS];		/**< Histogram parameter. Number of phis.  */
+	float fNrOfPhis[MAX_NR_OF_RESOLUTIONS];			/**< Histogram parameter. Number of phis.  */
+	int* piAngleMap[MAX_NR_OF_RESOLUTIONS];			/**< Histogram parameter. Mapping from vector to a region in sperical coordinates.  */
+	unsigned int uiPatchHash[MAX_NR_OF_RESOLUTIONS];	/**< Angle map cache. Hash of the patches of each resolution, to detect stale caches. */
+
+	int iNrOfBucketThetas[MAX_NR_OF_RESOLUTIONS];	/**< Patch index. Number of buckets along theta. */
+	int iNrOfBucketPhis[MAX_NR_OF_RESOLUTIONS];		/**< Patch index. Number of buckets along phi. */
+	double dBucketThetaMin[MAX_NR_OF_RESOLUTIONS];	/**< Patch index. Smallest theta covered by any patch. */
+	double dBucketPhiMin[MAX_NR_OF_RESOLUTIONS];	/**< Patch index. Smallest phi covered by any patch. */
+	double dBucketThetaWidth[MAX_NR_OF_RESOLUTIONS];/**< Patch index. Extent of a bucket along theta. */
+	double dBucketPhiWidth[MAX_NR_OF_RESOLUTIONS];	/**< Patch index. Extent of a bucket along phi. */
+	int* piBucketOffset[MAX_NR_OF_RESOLUTIONS];		/**< Patch index. Start of each bucket in piBucketPatch (size #buckets+1). */
+	int* piBucketPatch[MAX_NR_OF_RESOLUTIONS];		/**< Patch index. Ids of the patches overlapping each bucket, in ascending order. */
+
+	char* pcCache;									/**< Angle map cache. Mapped cache holding the tables, NULL if the tables are owned. */
+	size_t cacheSize;								/**< Angle map cache. Size of the mapped cache in bytes. */
+
+	mutable std::atomic<int> refCount;				/**< Number of owners of the table. */
+	mutable std::mutex cubeMapMutex;				/**< Serializes the construction of cube maps. */
+	mutable std::map< std::pair<int, int>, int* > cubeMaps;	/**< Cube maps built so far, keyed by (resolution, face resolution). */
+
+public:
+
+	/**
+	 * Constructor. The reference count starts at 1.
+	 * @param patchFileName Path of patch file on disc ('!' for the built-in patches).
+	 * @param nbin Desired number of bins in the histogram.
+	 * @param cacheFileName Optional binary cache of the tables. It is mapped
+	 * if it matches the bins and the patches, otherwise the patches are read and the cache is written.
+	 */
+	ITL_histogramtable( const char* patchFileName, int nbin, const char* cacheFileName = NULL );
+
+	/**
+	 * Constructor for several resolutions. The reference count starts at 1.
+	 * @param patchfilename Path of patch file on disc for each resolution.
+	 * @param nbin Desired number of bins for each resolution.
+	 * @param nresolution Number of resolutions of the historgam.
+	 * @param cacheFileName Optional binary cache of the tables of all resolutions.
+	 */
+	ITL_histogramtable( const char** patchfilename, int *nbin, int nresolution, const char* cacheFileName = NULL );
+
+	/**
+	 * Constructor for an angle map computed elsewhere (e.g. from geodesic patches).
+	 * The table takes over the map. It has no patch bounds, so only the
+	 * vector-to-bin conversions (get_bin_number_3D, mapVectorsToBins and the
+	 * cube maps) are available. The reference count starts at 1.
+	 * @param nbin Number of bins.
+	 * @param nthetas Number of angle map entries along theta.
+	 * @param nphis Number of angle map entries along phi.
+	 * @param angleMap Bin Id of each (theta, phi) entry, allocated with new [].
+	 */
+	ITL_histogramtable( int nbin, int nthetas, int nphis, int* angleMap );
+
+	/**
+	 * Adds an owner to the table.
+	 */
+	void acquire() const;
+
+	/**
+	 * Removes an owner; the table is deleted with its last owner.
+	 */
+	void release() const;
+
+	int getNumResolutions() const { return nResolution; }
+	int getNumBins( int iRes = 0 ) const { return nBin[iRes]; }
+	VECTOR3 getBinCenter( int binId, int iRes = 0 ) const { return binCenter[iRes][binId]; }
+
+	/**
+	 * Converts angles in spherical coordinates to the patch index.
+	 * @param mytheta theta corresponding to the local vector.
+	 * @param myphi phi corresponding to the local vector.
+	 * @param binnum Number of patches to search.
+	 * @param iRes Resolution of the histogram.
+	 */
+	int get_bin_by_angle( float mytheta, float myphi, int binnum, int iRes = 0 ) const;
+
+	/**
+	 * Vector-to-bin conversion via the angle map.
+	 * @param v Vector; the magnitude is ignored.
+	 * @param iRes Resolution of the histogram.
+	 */
+	int get_bin_number_3D( VECTOR3 v, int iRes = 0 ) const;
+
+	/**
+	 * Batch vector-to-bin conversion via the angle map.
+	 * Angles are computed with polynomial approximations accurate to ~1e-7
+	 * radians, far below the table resolution, so the loop vectorizes.
+	 * @param x Array of x-components.
+	 * @param y Array of y-components.
+	 * @param z Array of z-components.
+	 * @param stride Distance between consecutive components of one array (3 for xyz triples).
+	 * @param n Number of vectors.
+	 * @param out Array of n bin ids.
+	 * @param iRes Resolution of the histogram.
+	 */
+	template <class B>
+	void mapVectorsToBins( const float* x, const float* y, const float* z, size_t stride,
+						   size_t n, B* out, int iRes ) const;
+
+	/**
+	 * Batch vector-to-bin conversion via a cube map returned by getCubeMap.
+	 */
+	template <class B>
+	void mapVectorsToBinsCubeMap( const float* x, const float* y, const float* z, size_t stride,
+								  size_t n, B* out, const int* cubeMap, int nFaceRes ) const;
+
+	/**
+	 * Cube map of a resolution. Built on first request (under a lock) and kept
+	 * until the table is deleted, so the returned table never changes.
+	 * @param iRes Resolution of the histogram.
+	 * @param nFaceRes Number of cells along each side of a face.
+	 */
+	const int* getCubeMap( int iRes, int nFaceRes ) const;
+
+	/**
+	 * Angle map cache writer.
+	 * @param cacheFileName Path of the cache file.
+	 * @return false if the cache could not be written.
+	 */
+	bool writeAngleMapCache( const char* cacheFileName ) const;
+
+	/**
+	 * Theta computation.
+	 */
+	static float getAngle( float x, float y );
+
+	/**
+	 * Phi computation.
+	 */
+	static float getAngle2( float x, float y );
+
+	/**
+	 * Spherical to Cartesian conversion.
+	 */
+	static VECTOR3 getXYZ( float theta, float phi );
+
+private:
+
+	// Tables are shared; owners call release() instead of delete
+	~ITL_histogramtable();
+	ITL_histogramtable( const ITL_histogramtable& );
+	ITL_histogramtable& operator= ( const ITL_histogramtable& );
+
+	void initialize( const char** patchfilename, const char* cacheFileName );
+	void readPatches_header();
+	void readPatches_region( const char* patchFileName, int iRes );
+	void computeTable( int iRes );
+	void buildPatchIndex( int iRes );
+	int lookupPatchIndex( double mytheta, double myphi, int iRes ) const;
+	bool loadAngleMapCache( const char* cacheFileName );
+	static unsigned int hashPatchSource( const char* patchFileName );
+	static void releaseAngleMapCache( char* pcData, size_t nBytes );
+};
+
+#endif
+/* ITL_HISTOGRAMTABLE_H_ */
@@ -0,0 +1,242 @@
+/**
+ * Integral histogram class.
+ * Per-bin 3D prefix sums of a bin field, so that the histogram of any
+ * axis-aligned box is obtained from 8 lookups per bin instead of copying and
+ * rescanning the voxels of the box. To bound memory for large nBin the prefix
+ * sums can be kept at tile corners only (tileSize > 1): the tile-aligned core
+ * of a box is then answered from the prefix sums and the remaining shell of
+ * less than one tile per face is counted from the bin field.
+ * Box coordinates follow ITL_field_regular::getDataBetween: inclusive bounds
+ * in the global index space of the field.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_INTEGRALHISTOGRAM_H_
+#define ITL_INTEGRALHISTOGRAM_H_
+
+#include "ITL_header.h"
+#include "ITL_field_regular.h"
+#include "ITL_entropycore.h"
+
+/**
+ * @tparam B Type of the bin Ids (int, uint16_t or uint8_t, see ITL_histogrammapper::getBinIdSize).
+ */
+template <class B = int>
+class ITL_integralhistogram
+{
+	ITL_field_regular<B>* binField;	/**< Bin field the histograms are computed from. */
+	int nBin;							/**< Number of histogram bins. */
+	int tileSize;						/**< Spacing of the stored prefix sums, in voxels. */
+	int fieldLow[3];					/**< Global index of the first voxel of the field. */
+	int dim[3];							/**< Number of voxels along each axis. */
+	int nCorner[3];						/**< Number of stored corners along each axis. */
+	vector<int> prefixSum;				/**< Per corner, nBin counts of the voxels below it on every axis. */
+
+public:
+
+	/**
+	 * Constructor. Builds the prefix sums in O( #voxels + #corners*nBin ).
+	 * @param binfield Bin field; in the linear layout; must not change while the integral histogram is used.
+	 * @param nbin Number of histogram bins.
+	 * @param tilesize Spacing of the stored prefix sums; 1 stores a full integral histogram,
+	 * larger tiles divide its memory by tilesize^3.
+	 */
+	ITL_integralhistogram( ITL_field_regular<B>* binfield, int nbin, int tilesize = 1 )
+	{
+		assert( binfield != NULL && nbin > 0 && tilesize > 0 );
+		assert( binfield->getLayout() == ITL_field_regular<B>::LAYOUT_LINEAR );
+		binField = binfield;
+		nBin = nbin;
+		tileSize = tilesize;
+
+		int high[3];
+		int dimWithPad[4] = { 1, 1, 1, 1 };
+		fieldLow[0] = fieldLow[1] = fieldLow[2] = 0;
+		binField->getBounds( fieldLow, high );
+		binField->getSizeWithPad( dimWithPad );
+		for( int d=0; d<3; d++ )
+		{
+			dim[d] = dimWithPad[d];
+			nCorner[d] = ( dim[d] + tileSize - 1 ) / tileSize + 1;
+		}
+
+		// Histogram of each tile, stored at the corner above it
+		prefixSum.assign( (size_t)nCorner[0]*nCorner[1]*nCorner[2]*nBin, 0 );
+		const B* binIds = binField->getDataFull();
+		int index1d = 0;
+		for( int z=0; z<dim[2]; z++ )
+			for( int y=0; y<dim[1]; y++ )
+				for( int x=0; x<dim[0]; x++ )
+				{
+					size_t corner = getCornerIndex( x/tileSize + 1, y/tileSize + 1, z/tileSize + 1 );
+					prefixSum[ corner*nBin + binIds[index1d++] ] ++;
+				}
+
+		// Cumulative sums along x, y and z
+		for( int z=0; z<nCorner[2]; z++ )
+			for( int y=0; y<nCorner[1]; y++ )
+				for( int x=1; x<nCorner[0]; x++ )
+					accumulate( getCornerIndex( x, y, z ), getCornerIndex( x-1, y, z ) );
+		for( int z=0; z<nCorner[2]; z++ )
+			for( int y=1; y<nCorner[1]; y++ )
+				for( int x=0; x<nCorner[0]; x++ )
+					accumulate( getCornerIndex( x, y, z ), getCornerIndex( x, y-1, z ) );
+		for( int z=1; z<nCorner[2]; z++ )
+			for( int y=0; y<nCorner[1]; y++ )
+				for( int x=0; x<nCorner[0]; x++ )
+					accumulate( getCornerIndex( x, y, z ), getCornerIndex( x, y, z-1 ) );
+
+	}// end constructor
+
+	/**
+	 * Histogram of a box.
+	 * @param low Lower bound along each dimension (inclusive).
+	 * @param high Higher bound along each dimension (inclusive).
+	 * @param freq Array of nBin counts (allocated by the caller).
+	 */
+	void
+	getBoxHistogram( const int* low, const int* high, int* freq ) const
+	{
+		memset( freq, 0, sizeof(int)*nBin );
+
+		// Box in local voxels, half-open [a, b)
+		int a[3], b[3], ca[3], cb[3];
+		bool hasCore = true;
+		for( int d=0; d<3; d++ )
+		{
+			a[d] = ITL_util<int>::clamp( low[d] - fieldLow[d], 0, dim[d] );
+			b[d] = ITL_util<int>::clamp( high[d] - fieldLow[d] + 1, a[d], dim[d] );
+
+			// Corners bounding the tile-aligned core
+			ca[d] = ( a[d] + tileSize - 1 ) / tileSize;
+			cb[d] = ( b[d] == dim[d] ) ? nCorner[d] - 1 : b[d] / tileSize;
+			if( getCornerPosition( ca[d], d ) >= getCornerPosition( cb[d], d ) )
+				hasCore = false;
+		}
+		if( a[0] == b[0] || a[1] == b[1] || a[2] == b[2] )
+			return;
+
+		int coreLow[3] = { b[0], b[1], b[2] };
+		int coreHigh[3] = { b[0], b[1], b[2] };
+		if( hasCore )
+		{
+			// 8 lookups per bin
+			const int* p111 = &prefixSum[ getCornerIndex( cb[0], cb[1], cb[2] )*nBin ];
+			const int* p011 = &prefixSum[ getCornerIndex( ca[0], cb[1], cb[2] )*nBin ];
+			const int* p101 = &prefixSum[ getCornerIndex( cb[0], ca[1], cb[2] )*nBin ];
+			const int* p110 = &prefixSum[ getCornerIndex( cb[0], cb[1], ca[2] )*nBin ];
+			const int* p001 = &prefixSum[ getCornerIndex( ca[0], ca[1], cb[2] )*nBin ];
+			const int* p010 = &prefixSum[ getCornerIndex( ca[0], cb[1], ca[2] )*nBin ];
+			const int* p100 = &prefixSum[ getCornerIndex( cb[0], ca[1], ca[2] )*nBin ];
+			const int* p000 = &prefixSum[ getCornerIndex( ca[0], ca[1], ca[2] )*nBin ];
+			for( int i=0; i<nBin; i++ )
+				freq[i] = p111[i] - p011[i] - p101[i] - p110[i] + p001[i] + p010[i] + p100[i] - p000[i];
+
+			for( int d=0; d<3; d++ )
+			{
+				coreLow[d] = getCornerPosition( ca[d], d );
+				coreHigh[d] = getCornerPosition( cb[d], d );
+			}
+		}
+
+		// Count the shell around the core from the bin field
+		const B* binIds = binField->getDataFull();
+		for( int z=a[2]; z<b[2]; z++ )
+			for( int y=a[1]; y<b[1]; y++ )
+			{
+				const B* row = binIds + ( (size_t)z*dim[1] + y )*dim[0];
+				bool inCore = ( z >= coreLow[2] && z < coreHigh[2] && y >= coreLow[1] && y < coreHigh[1] );
+				if( !inCore )
+				{
+					for( int x=a[0]; x<b[0]; x++ )
+						freq[ row[x] ] ++;
+					continue;
+				}
+				for( int x=a[0]; x<coreLow[0]; x++ )
+					freq[ row[x] ] ++;
+				for( int x=coreHigh[0]; x<b[0]; x++ )
+					freq[ row[x] ] ++;
+			}
+
+	}// end function
+
+	/**
+	 * Histogram of a box given in floating-point coordinates (low is floored, high is ceiled).
+	 */
+	void
+	getBoxHistogram( const float* low, const float* high, int* freq ) const
+	{
+		int lowInt[3], highInt[3];
+		toIntBox( low, high, lowInt, highInt );
+		getBoxHistogram( lowInt, highInt, freq );
+	}// end function
+
+	/**
+	 * Entropy of the histogram of a box.
+	 * @param low Lower bound along each dimension (inclusive).
+	 * @param high Higher bound along each dimension (inclusive).
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 */
+	float
+	getBoxEntropy( const int* low, const int* high, bool toNormalize = false ) const
+	{
+		vector<int> freq( nBin );
+		getBoxHistogram( low, high, &freq[0] );
+
+		int nPoint = 0;
+		for( int i=0; i<nBin; i++ )
+			nPoint += freq[i];
+
+		return ITL_entropycore::computeEntropy_CountBased( &freq[0], nPoint, nBin, toNormalize );
+	}// end function
+
+	/**
+	 * Entropy of the histogram of a box given in floating-point coordinates.
+	 */
+	float
+	getBoxEntropy( const float* low, const float* high, bool toNormalize = false ) const
+	{
+		int lowInt[3], highInt[3];
+		toIntBox( low, high, lowInt, highInt );
+		return getBoxEntropy( lowInt, highInt, toNormalize );
+	}// end function
+
+	int getNumBins() const { return nBin; }
+	int getTileSize() const { return tileSize; }
+
+private:
+
+	size_t
+	getCornerIndex( int cx, int cy, int cz ) const
+	{
+		return ( (size_t)cz*nCorner[1] + cy )*nCorner[0] + cx;
+	}
+
+	int
+	getCornerPosition( int c, int d ) const
+	{
+		return min( c*tileSize, dim[d] );
+	}
+
+	void
+	accumulate( size_t to, size_t from )
+	{
+		int* t = &prefixSum[ to*nBin ];
+		const int* f = &prefixSum[ from*nBin ];
+		for( int i=0; i<nBin; i++ )
+			t[i] += f[i];
+	}
+
+	static void
+	toIntBox( const float* low, const float* high, int* lowInt, int* highInt )
+	{
+		for( int d=0; d<3; d++ )
+		{
+			lowInt[d] = (int)floor( low[d] );
+			highInt[d] = (int)ceil( high[d] );
+		}
+	}
+};
+
+#endif
+/* ITL_INTEGRALHISTOGRAM_H_ */
@@ -13,6 +13,7 @@
 #include <mpi.h>
 #include "ITL_header.h"
 #include "ITL_util.h"
+#include "ITL_field_regular.h"
 #include <fstream>
 #include <sstream>
 
@@ -139,6 +140,66 @@ public:
 
 	}// end function
 
+	/**
+	 * Serial file mapper.
+	 * Field stored as binary file in vec format, mapped into memory after its
+	 * header instead of read: no allocation or copy at startup, pages are read
+	 * on first touch and shared with other processes mapping the file. The
+	 * field can be modified; changes are private to the process. Falls back to
+	 * reading the file if it cannot be mapped.
+	 * @param fileName File name.
+	 * @param nDim Dimensionality of the field.
+	 * @param dim Length of field along each dimension (can be a zero filled array)
+	 * @param accessHint ITL_datastore<T>::ACCESS_* hint for the expected access pattern.
+	 * @return pointer to a field without pad (delete it to unmap the file), NULL
+	 * if the file cannot be opened, its header is truncated or the field is too large
+	 */
+	static ITL_field_regular<T>* mapFieldBinarySerial( const char* fileName, int nDim, int* dim,
+													   int accessHint = ITL_datastore<T>::ACCESS_SEQUENTIAL )
+	{
+		// Read header
+		FILE* dataFile = fopen( fileName, "rb" );
+		if( dataFile == NULL )
+		{
+			fprintf( stderr, "Cannot open %s\n", fileName );
+			return NULL;
+		}
+		size_t nRead = fread( dim, sizeof(int), nDim, dataFile );
+		fclose( dataFile );
+		if( nRead != (size_t)nDim )
+		{
+			fprintf( stderr, "Truncated header in %s\n", fileName );
+			return NULL;
+		}
+
+		// Fields are indexed with int, mapped or read
+		size_t nel = 1;
+		for( int i=0; i<nDim; i++ )
+			nel *= (size_t)max( dim[i], 0 );
+		if( nel > (size_t)INT_MAX )
+		{
+			fprintf( stderr, "%s holds %lu values, more than a field can index\n", fileName, (unsigned long)nel );
+			return NULL;
+		}
+
+		ITL_field_regular<T>* field = new ITL_field_regular<T>();
+		if( !field->initializeMapped( fileName, nDim, dim, sizeof(int)*(size_t)nDim, accessHint ) )
+		{
+			// Read the data instead
+			T* array = readFieldBinarySerial( fileName, nDim, dim );
+			delete field;
+			field = new ITL_field_regular<T>( array, nDim, dim );
+			delete [] array;
+		}
+
+		#ifdef DEBUG_MODE
+		printf( "%d values mapped from file\n", field->getSize() );
+		#endif
+
+		return field;
+
+	}// end function
+
 	/**
 	 * Serial file writer.
 	 * Stores field binary file in vec format.
@@ -9,6 +9,10 @@
 #ifndef ITL_LOCALENTROPY_H_
 #define ITL_LOCALENTROPY_H_
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "ITL_header.h"
 // ADD-BY-LEETEN 07/18/2011-BEGIN
 #include "ITL_histogram.h"
@@ -21,17 +25,27 @@
 #include "ITL_field_regular.h"
 #include "ITL_field_unstructured.h"
 #include "ITL_entropycore.h"
+#include "ITL_neighborhood.h"
+#include "ITL_tetvolume.h"
+#include "ITL_pool.h"
 
 #include "ITL_cell.h"
 
-template <class T>
+/**
+ * @tparam T Type of the field values.
+ * @tparam B Type of the bin Ids (int, uint16_t or uint8_t, see ITL_histogrammapper::getBinIdSize).
+ */
+template <class T, class B = int>
 class ITL_localentropy
 {
 public:
 
 	ITL_field<T> *dataField;
-	ITL_field_regular<int>* binData;	/**< A scalar field containing histogram bins corresponding to field points. */
+	ITL_field_regular<B>* binData;		/**< A scalar field containing histogram bins corresponding to field points. */
 	ITL_field_regular<float> *entropyField;
+	ITL_field_regular<float> *coarseEntropyField;	/**< Entropy on the lattice of the last strided computation. */
+	float stridedMaxError;				/**< Maximum interpolation error of the last strided computation. */
+	float stridedRMSError;				/**< RMS interpolation error of the last strided computation. */
 
 	T histogramMin;
 	T histogramMax;
@@ -42,6 +56,9 @@ public:
 
 	ITL_histogram *histogram;			// ADD-BY-ABON 11/07/2011
 	int nBin;
+	int nThread;						/**< Number of threads for the entropy field (0 for the OpenMP default). */
+	int boundaryMode;					/**< How neighbors outside the field are read (ITL_neighborhood::BOUNDARY_*). */
+	ITL_pool* pool;						/**< Optional pool the entropy field is taken from (created or deleted elsewhere). */
 
 	//double* pointDistList;
 
@@ -55,8 +72,12 @@ public:
 		this->dataField = f;
 		this->binData = NULL;
 		this->entropyField = NULL;
+		this->coarseEntropyField = NULL;
 		histogramRangeSet = false;		// ADD-BY-ABON 07/19/2011
 		histogram = hist;				// ADD-BY-ABON 11/07/2011
+		nThread = 0;
+		boundaryMode = ITL_neighborhood::BOUNDARY_MIRROR;
+		pool = NULL;
 
 		//pointDistList = NULL;
 	}// End constructor
@@ -64,97 +85,482 @@ public:
 	/**
 	 * Constructor.
 	 */
-	ITL_localentropy( ITL_field_regular<int> *bindata, ITL_histogram *hist, int nbin )
+	ITL_localentropy( ITL_field_regular<B> *bindata, ITL_histogram *hist, int nbin )
 	{
 		this->binData = bindata;
 		histogram = hist;
 		nBin = nbin;
+		nThread = 0;
+		boundaryMode = ITL_neighborhood::BOUNDARY_MIRROR;
+		pool = NULL;
 
 		this->entropyField = NULL;
+		this->coarseEntropyField = NULL;
+		stridedMaxError = stridedRMSError = 0;
 
 		//pointDistList = NULL;
 
 	}// End constructor
+
+	/**
+	 * Destructor.
+	 * Deletes the coarse entropy field; the entropy field belongs to the caller.
+	 */
+	~ITL_localentropy()
+	{
+		if( coarseEntropyField != NULL )
+			delete coarseEntropyField;
+	}// End destructor
 	
+	/**
+	 * Thread count set function.
+	 * Sets the number of threads used by computeLocalEntropyOfField, e.g. the
+	 * share of a node's cores given to one MPI rank. Results do not depend on it.
+	 * @param nthread Number of threads; 0 uses the OpenMP default (OMP_NUM_THREADS).
+	 */
+	void setNumThreads( int nthread )
+	{
+		nThread = nthread;
+	}// end function
+
+	/**
+	 * Pool set function.
+	 * When set, the entropy field is taken from the pool, and the caller gives
+	 * it back with ITL_pool::releaseField once it is done with it.
+	 * @param p Pool (owned by the caller), NULL to allocate the entropy field with new.
+	 */
+	void setPool( ITL_pool* p )
+	{
+		pool = p;
+	}// end function
+
+	/**
+	 * Boundary mode set function.
+	 * Selects how the neighbors outside the padded field are read by the next computation.
+	 * @param mode ITL_neighborhood::BOUNDARY_MIRROR (default), BOUNDARY_CLAMP or BOUNDARY_ZERO.
+	 */
+	void setBoundaryMode( int mode )
+	{
+		boundaryMode = mode;
+	}// end function
+
 	/**
 	 * Entropy computation function.
 	 * Creates a scalar field that contains entropy at each grid vertex.
+	 * Rows are split into contiguous chunks over the threads; each thread reuses
+	 * its own scratch histogram, and every row is computed the same way for any
+	 * number of threads. Large bin fields can be put in the bricked layout
+	 * (ITL_field_regular::setLayout) to keep the neighborhood planes within a
+	 * few pages; the entropy field is the same in either layout.
 	 * @param nBins Number of bins used in histogram computation.
 	 */
 	void
 	computeLocalEntropyOfField( bool toNormalize )
 	{
-		float low[4];
-		float high[4];
-		int lowPad[4];
-		int highPad[4];
-		int neighborhoodSize[4];
-
 		// Allocate memory for entropy field (a non-padded scalar field), if not already done
-		if( this->entropyField == NULL )
+		allocateEntropyField();
+
+		// Compute histogram if it is not already done
+		//if( this->binData == NULL )
+		//	this->computeHistogramBinField( nBins );
+
+		// Neighbor coordinate tables with the boundary mode of this computation
+		ITL_neighborhood neighborhood( binData, boundaryMode );
+
+		//pointDistList = new double[ dim[0]*dim[1]*dim[2]*nBin ];
+
+		// Compute and store the value of entropy at every point
+		this->computeEntropyLattice( neighborhood, 1, entropyField->getDataFull(), toNormalize );
+
+		//FILE* dumpFile = fopen( "histDump.bin", "wb" );
+		//fwrite( pointDistList, sizeof(double)*dim[0]*dim[1]*dim[2]*nBin, 1, dumpFile );
+		//fclose( dumpFile );
+
+	}// end function
+
+	/**
+	 * Strided entropy computation function.
+	 * Quick-look variant of computeLocalEntropyOfField: entropy is only computed
+	 * on a coarse lattice made of every stride-th point along each axis, plus
+	 * the last point of each axis so that the lattice spans the field. This
+	 * costs about 1/stride^2 of the full field (rows are skipped along y and z,
+	 * and along x the window slides by stride planes per lattice point).
+	 * The lattice values are kept in the coarse entropy field; the full field
+	 * can be reconstructed from them by trilinear interpolation.
+	 * The error of the interpolation is measured against exact entropy at a
+	 * fixed pseudo-random subsample of points (see getStridedError).
+	 * @param stride Spacing of the lattice along each axis, in voxels (1 computes every point).
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 * @param toInterpolate TRUE reconstructs the full-resolution entropy field.
+	 * @param nValidation Number of points of the validation subsample (0 skips the validation).
+	 */
+	void
+	computeLocalEntropyOfField_Strided( int stride, bool toNormalize,
+										bool toInterpolate = true, int nValidation = 1024 )
+	{
+		assert( stride > 0 );
+
+		ITL_neighborhood neighborhood( binData, boundaryMode );
+
+		// Lattice point i of an axis lies at min( i*stride, dim-1 )
+		float low[4] = { 0, 0, 0, 0 };
+		float high[4] = { 0, 0, 0, 0 };
+		int nLattice[3];
+		for( int d=0; d<3; d++ )
+		{
+			nLattice[d] = getNumLatticePoints( neighborhood.getSize( d ), stride );
+			high[d] = nLattice[d] - 1.0f;
+		}
+		if( coarseEntropyField != NULL )
+			delete coarseEntropyField;
+		coarseEntropyField = new ITL_field_regular<float>( binData->getNumDim(), low, high );
+
+		this->computeEntropyLattice( neighborhood, stride, coarseEntropyField->getDataFull(), toNormalize );
+
+		// Reconstruct the full field
+		if( toInterpolate )
 		{
-			binData->getBounds( low, high );
-			binData->getPadSize( lowPad, highPad );
-
-			#ifdef DEBUG_MODE
-			printf( "Low: %g %g %g\n", low[0], low[1], low[2] );
-			printf( "High: %g %g %g\n", high[0], high[1], high[2] );
-			printf( "Low Pad: %d %d %d\n", lowPad[0], lowPad[1], lowPad[2] );
-			printf( "High Pad: %d %d %d\n", highPad[0], highPad[1], highPad[2] );
+			allocateEntropyField();
+			int nX = neighborhood.getSize( 0 );
+			int nRow = neighborhood.getSize( 1 ) * neighborhood.getSize( 2 );
+			float* entropy = entropyField->getDataFull();
+			#ifdef _OPENMP
+			int nThreadToUse = ( nThread > 0 ) ? nThread : omp_get_max_threads();
 			#endif
 
-			this->entropyField = new ITL_field_regular<SCALAR>( binData->getNumDim(),
-																low, high );
+			#pragma omp parallel for schedule(static) num_threads( nThreadToUse )
+			for( int row=0; row<nRow; row++ )
+			{
+				int y = row % neighborhood.getSize( 1 );
+				int z = row / neighborhood.getSize( 1 );
+				for( int x=0; x<nX; x++ )
+					entropy[ (size_t)row*nX + x ] = interpolateLattice( x, y, z, stride, nLattice,
+																		 coarseEntropyField->getDataFull(),
+																		 neighborhood );
+			}
 		}
 
-		// Compute total number of vertices in the neighborhood, including the vertext itself
-		binData->getNeighborhoodSize( neighborhoodSize );
-		//fprintf( stderr, "Neighborhoodsize: %d %d %d\n", neighborhoodSize[0], neighborhoodSize[1], neighborhoodSize[2] );
+		// Exact entropy at the validation subsample
+		stridedMaxError = 0;
+		stridedRMSError = 0;
+		if( nValidation > 0 )
+		{
+			vector<int> binArray( neighborhood.getNumNeighbors() );
+			vector<int> localFreqList( nBin );
+			const B* binIds = binData->getDataFull();
+			double sumSquare = 0;
+			unsigned int seed = 12345;
+			for( int i=0; i<nValidation; i++ )
+			{
+				// One draw per axis, as a single draw only reaches 2^24 points
+				int coord[3];
+				for( int d=0; d<3; d++ )
+				{
+					seed = seed * 1103515245u + 12345u;
+					coord[d] = (int)( ( seed >> 8 ) % (unsigned int)neighborhood.getSize( d ) );
+				}
+				int x = coord[0];
+				int y = coord[1];
+				int z = coord[2];
+
+				neighborhood.gather( binIds, x, y, z, &binArray[0] );
+				float exact = ITL_entropycore::computeEntropy_HistogramBased( &binArray[0], &localFreqList[0],
+																			 neighborhood.getNumNeighbors(), nBin, toNormalize );
+				float approx = interpolateLattice( x, y, z, stride, nLattice,
+												   coarseEntropyField->getDataFull(), neighborhood );
+				double e = fabs( (double)exact - approx );
+				stridedMaxError = max( stridedMaxError, (float)e );
+				sumSquare += e*e;
+			}
+			stridedRMSError = (float)sqrt( sumSquare / nValidation );
+		}
 
-		int nNeighbors = (int)( ( 2.0f*neighborhoodSize[0] + 1.0f ) *
-						     ( 2.0f*neighborhoodSize[1] + 1.0f ) *
-						     ( 2.0f*neighborhoodSize[2] + 1.0f ) );
+	}// end function
 
-		// Compute histogram if it is not already done
-		//if( this->binData == NULL )
-		//	this->computeHistogramBinField( nBins );
+	/**
+	 * Interpolation error accessor function.
+	 * Error of the last computeLocalEntropyOfField_Strided against exact entropy
+	 * at its validation subsample (0 if it was skipped).
+	 * @param maxError Maximum absolute difference.
+	 * @param rmsError Root mean square difference.
+	 */
+	void getStridedError( float* maxError, float* rmsError )
+	{
+		*maxError = stridedMaxError;
+		*rmsError = stridedRMSError;
+	}// end function
 
-		int index1d = 0;
-		int dim[4];
-		entropyField->getSize( dim );
-		//fprintf( stderr, "Enfield dim: %d %d %d\n", dim[0], dim[1], dim[2] );
+	/**
+	 * Entropy computation function.
+	 * Computes entropy at every point of a lattice (every stride-th point along
+	 * each axis plus the last one) and stores it in x-fastest order.
+	 * Rows are split into contiguous chunks over the threads.
+	 * @param neighborhood Neighbor coordinate tables of the bin field.
+	 * @param stride Spacing of the lattice along each axis (1 for every point).
+	 * @param entropy Array of entropy values, one per lattice point.
+	 */
+	void computeEntropyLattice( const ITL_neighborhood& neighborhood, int stride,
+								float* entropy, bool toNormalize )
+	{
+		int nLattice[3];
+		for( int d=0; d<3; d++ )
+			nLattice[d] = getNumLatticePoints( neighborhood.getSize( d ), stride );
 
-		//pointDistList = new double[ dim[0]*dim[1]*dim[2]*nBin ];
+		int nRow = nLattice[1] * nLattice[2];
+		#ifdef _OPENMP
+		int nThreadToUse = ( nThread > 0 ) ? nThread : omp_get_max_threads();
+		#endif
+
+		#pragma omp parallel num_threads( nThreadToUse )
+		{
+			// Scratch of this thread, reused by all its rows
+			vector<int> localFreqList( nBin, 0 );
+			vector<int> planeOffset( ( 2*neighborhood.getNeighborhoodSize(1) + 1 ) *
+									 ( 2*neighborhood.getNeighborhoodSize(2) + 1 ) *
+									 max( neighborhood.getLayout().getNumBricks( 0 ), 1 ) );
+
+			#pragma omp for schedule(static)
+			for( int row=0; row<nRow; row++ )
+			{
+				int y = min( ( row % nLattice[1] ) * stride, neighborhood.getSize( 1 ) - 1 );
+				int z = min( ( row / nLattice[1] ) * stride, neighborhood.getSize( 2 ) - 1 );
+
+				// Compute and store the value of entropy at every lattice point of this row
+				this->computeEntropyRow( neighborhood, y, z, stride,
+										 &localFreqList[0], &planeOffset[0],
+										 entropy + (size_t)row*nLattice[0], toNormalize );
+
+			}// end for : row
+		}
+
+	}// end function
+
+	/**
+	 * Entropy computation function.
+	 * Computes entropy at every stride-th point of a row of the field (fixed y
+	 * and z), and at its last point.
+	 * The local histogram and its sum of c*log2(c) slide along x: each step
+	 * removes the planes of bins leaving the neighborhood and adds the entering
+	 * ones, so a step of one point costs (2r+1)^2 updates instead of a full
+	 * (2r+1)^3 recount, and a step of s points at most min(s, 2r+1) times that.
+	 * In zero mode, neighbor rows outside the field only add a constant count to bin 0.
+	 * @param neighborhood Neighbor coordinate tables of the bin field.
+	 * @param y y-coordinate of the row.
+	 * @param z z-coordinate of the row.
+	 * @param stride Spacing of the computed points along x (1 for every point).
+	 * @param freqList Scratch histogram of nBin counts.
+	 * @param planeOffset Scratch of (2r+1)^2 plane offsets (times the number of bricks along x in the bricked layout).
+	 * @param entropy Entropy of each computed point of the row.
+	 */
+	void computeEntropyRow( const ITL_neighborhood& neighborhood,
+							int y, int z, int stride,
+							int* freqList, int* planeOffset,
+							float* entropy, bool toNormalize )
+	{
+		if( neighborhood.getLayout().isBricked() )
+			this->template computeEntropyRowInLayout<true>( neighborhood, y, z, stride, freqList, planeOffset, entropy, toNormalize );
+		else
+			this->template computeEntropyRowInLayout<false>( neighborhood, y, z, stride, freqList, planeOffset, entropy, toNormalize );
+	}// end function
+
+	/**
+	 * Index of the point at x-coordinate c of neighborhood row p: an offset
+	 * from the start of the row in the linear layout, or an offset in the
+	 * brick holding the point in the bricked layout.
+	 */
+	template <bool BRICKED>
+	static int
+	getRowIndex( const int* planeOffset, int p, int nRowBrick, int c, int shift, int mask )
+	{
+		return BRICKED ? planeOffset[ p*nRowBrick + ( c >> shift ) ] + ( c & mask ) : planeOffset[p] + c;
+	}
+
+	/**
+	 * computeEntropyRow for one layout of the bin field.
+	 */
+	template <bool BRICKED>
+	void computeEntropyRowInLayout( const ITL_neighborhood& neighborhood,
+									int y, int z, int stride,
+									int* freqList, int* planeOffset,
+									float* entropy, bool toNormalize )
+	{
+		const B* binIds = this->binData->getDataFull();
+		const ITL_bricklayout& layout = neighborhood.getLayout();
+		int shift = layout.getBrickShift();
+		int mask = layout.getBrickMask();
+		int nRowBrick = BRICKED ? layout.getNumBricks( 0 ) : 1;
+		const int* mapX = neighborhood.getCoordinateTable( 0 );
+		const int* mapY = neighborhood.getCoordinateTable( 1 );
+		const int* mapZ = neighborhood.getCoordinateTable( 2 );
+		int nX = neighborhood.getSize( 0 );
+		int nNeighbors = neighborhood.getNumNeighbors();
+		int windowX = 2*neighborhood.getNeighborhoodSize( 0 ) + 1;
+
+		// Offsets of the rows of one yz-plane of the neighborhood that lie inside the field
+		int nPlane = 0;
+		int nOutside = 0;
+		for( int k = 0; k <= 2*neighborhood.getNeighborhoodSize( 2 ); k++ )
+			for( int j = 0; j <= 2*neighborhood.getNeighborhoodSize( 1 ); j++ )
+			{
+				if( mapZ[z+k] < 0 || mapY[y+j] < 0 )
+				{
+					nOutside += windowX;
+					continue;
+				}
+				if( BRICKED )
+					layout.getRowTable( mapY[y+j], mapZ[z+k], planeOffset + nPlane*nRowBrick );
+				else
+					planeOffset[nPlane] = ( mapZ[z+k] * neighborhood.getSizeWithPad( 1 ) +
+											mapY[y+j] ) * neighborhood.getSizeWithPad( 0 );
+				nPlane++;
+			}
 
-		for( int z=0; z<dim[2]; z++ )
+		// Histogram of the neighborhood of the first point
+		memset( freqList, 0, sizeof(int)*nBin );
+		double sumCLogC = 0;
+		if( nOutside > 0 )
 		{
-			for( int y=0; y<dim[1]; y++ )
+			freqList[0] = nOutside;
+			sumCLogC = ITL_entropycore::countLogCount( nOutside );
+		}
+		for( int i = 0; i < windowX; i++ )
+			for( int p = 0; p < nPlane; p++ )
 			{
-				for( int x=0; x<dim[0]; x++ )
+				int b = ( mapX[i] < 0 ) ? 0 : binIds[ getRowIndex<BRICKED>( planeOffset, p, nRowBrick, mapX[i], shift, mask ) ];
+				sumCLogC = ITL_entropycore::updateCountLogCount( sumCLogC, freqList[b], 1 );
+				freqList[b] ++;
+			}
+		entropy[0] = ITL_entropycore::computeEntropy_CountBased( sumCLogC, nNeighbors, nBin, toNormalize );
+
+		// Counts never exceed nNeighbors, so small neighborhoods can use the table directly
+		const double* cLogC = ( nNeighbors < ITL_entropycore::COUNT_TABLE_SIZE ) ?
+							  ITL_entropycore::getCountLogCountTable() : NULL;
+
+		// Slide along x; the window of point x covers mapX[x] to mapX[x+windowX-1]
+		int nLatticeX = getNumLatticePoints( nX, stride );
+		int x0 = 0;
+		for( int l = 1; l < nLatticeX; l++ )
+		{
+			int x1 = min( l*stride, nX-1 );
+			int nMoved = min( x1 - x0, windowX );
+			for( int q = 0; q < nMoved; q++ )
+			{
+				int leaving = mapX[x0 + q];
+				int entering = mapX[x1 + windowX - nMoved + q];
+				for( int p = 0; p < nPlane; p++ )
 				{
-					// Compute and store the value of entropy at this point
-					this->computeEntropySinglePoint( x, y, z, nNeighbors, index1d, toNormalize );
+					int bOut = ( leaving < 0 ) ? 0 : binIds[ getRowIndex<BRICKED>( planeOffset, p, nRowBrick, leaving, shift, mask ) ];
+					int bIn = ( entering < 0 ) ? 0 : binIds[ getRowIndex<BRICKED>( planeOffset, p, nRowBrick, entering, shift, mask ) ];
+					if( bOut == bIn )
+						continue;
+
+					if( cLogC != NULL )
+					{
+						int cOut = freqList[bOut]--;
+						int cIn = freqList[bIn]++;
+						sumCLogC += ( cLogC[cIn+1] - cLogC[cIn] ) + ( cLogC[cOut-1] - cLogC[cOut] );
+					}
+					else
+					{
+						sumCLogC = ITL_entropycore::updateCountLogCount( sumCLogC, freqList[bOut], -1 );
+						freqList[bOut] --;
+						sumCLogC = ITL_entropycore::updateCountLogCount( sumCLogC, freqList[bIn], 1 );
+						freqList[bIn] ++;
+					}
+				}
+			}
+			entropy[l] = ITL_entropycore::computeEntropy_CountBased( sumCLogC, nNeighbors, nBin, toNormalize );
+			x0 = x1;
+		}
 
-					// increment to the next element
-					index1d ++;
+	}// end function
 
-				}// end for : x
-			}// end for : y
-		}// end for : z
+	/**
+	 * @return Number of lattice points along an axis of n points: every stride-th point and the last one.
+	 */
+	static int
+	getNumLatticePoints( int n, int stride )
+	{
+		return ( n - 1 + stride - 1 ) / stride + 1;
+	}// end function
 
+	/**
+	 * Trilinear interpolation function.
+	 * @return Value at point (x, y, z) of the field interpolated from the lattice values.
+	 */
+	static float
+	interpolateLattice( int x, int y, int z, int stride, const int* nLattice,
+						const float* lattice, const ITL_neighborhood& neighborhood )
+	{
+		int p[3] = { x, y, z };
+		int i0[3], i1[3];
+		float w[3];
+		for( int d=0; d<3; d++ )
+		{
+			// Lattice cell [i0, i1] around the point
+			i0[d] = min( p[d] / stride, nLattice[d] - 1 );
+			i1[d] = min( i0[d] + 1, nLattice[d] - 1 );
+			int c0 = i0[d] * stride;
+			int c1 = min( i1[d] * stride, neighborhood.getSize( d ) - 1 );
+			w[d] = ( c1 > c0 ) ? (float)( p[d] - c0 ) / ( c1 - c0 ) : 0.0f;
+		}
 
-		//FILE* dumpFile = fopen( "histDump.bin", "wb" );
-		//fwrite( pointDistList, sizeof(double)*dim[0]*dim[1]*dim[2]*nBin, 1, dumpFile );
-		//fclose( dumpFile );
+		float v = 0;
+		for( int k=0; k<2; k++ )
+			for( int j=0; j<2; j++ )
+				for( int i=0; i<2; i++ )
+				{
+					float weight = ( i ? w[0] : 1.0f - w[0] ) * ( j ? w[1] : 1.0f - w[1] ) * ( k ? w[2] : 1.0f - w[2] );
+					if( weight == 0 )
+						continue;
+					int index = ( ( k ? i1[2] : i0[2] ) * nLattice[1] + ( j ? i1[1] : i0[1] ) ) * nLattice[0] +
+								( i ? i1[0] : i0[0] );
+					v += weight * lattice[index];
+				}
+		return v;
+	}// end function
 
+	/**
+	 * Allocates the entropy field (a non-padded scalar field), if not already done.
+	 */
+	void
+	allocateEntropyField()
+	{
+		if( this->entropyField != NULL )
+			return;
+
+		float low[4];
+		float high[4];
+		binData->getBounds( low, high );
+
+		#ifdef DEBUG_MODE
+		int lowPad[4] = { 0, 0, 0, 0 };
+		int highPad[4] = { 0, 0, 0, 0 };
+		binData->getPadSize( lowPad, highPad );
+		printf( "Low: %g %g %g\n", low[0], low[1], low[2] );
+		printf( "High: %g %g %g\n", high[0], high[1], high[2] );
+		printf( "Low Pad: %d %d %d\n", lowPad[0], lowPad[1], lowPad[2] );
+		printf( "High Pad: %d %d %d\n", highPad[0], highPad[1], highPad[2] );
+		#endif
+
+		if( pool != NULL )
+			this->entropyField = pool->acquireField<SCALAR>( binData->getNumDim(), low, high );
+		else
+			this->entropyField = new ITL_field_regular<SCALAR>( binData->getNumDim(),
+																low, high );
 	}// end function
 
 	/**
 	 * Entropy computation function.
-	 * Creates a scalar field that contains entropy at each vertex of the unstructured grid.
+	 * Computes entropy at each vertex of the unstructured grid from the exact
+	 * volume of its neighborhood box per bin: cells contained in the box add
+	 * their whole value distribution, intersected cells are clipped to the box
+	 * first. Vertices are split over the threads, each with its own histogram
+	 * and clipping scratch.
 	 * @param nBins Number of bins used in histogram computation.
+	 * @return Array of entropy at each vertex (allocated here, freed by the caller).
 	 */
-	void computeLocalEntropyOfField_Unstructured( int nBins, bool toNormalize )
+	float* computeLocalEntropyOfField_Unstructured( int nBins, bool toNormalize )
 	{
 		assert(dataField);
 		//ITL_grid_unstructured<SCALAR>* uGrid = dynamic_cast<ITL_grid_unstructured<SCALAR>*>(dataField->grid);
@@ -192,89 +598,53 @@ public:
 		float binWidth = rangeValue / (float)nBins;
 		// MOD-BY-LEETEN 04/09/2012-END
 
-		float* entropyField = new float[uGrid->getSize()];
+		int nVertices = uGrid->getSize();
+		float* vertexEntropy = new float[nVertices];
+
+		#ifdef _OPENMP
+		int nThreadToUse = ( nThread > 0 ) ? nThread : omp_get_max_threads();
+		#endif
 
-		//compute entropy at each vertex
-		for (int i = 0; i < uGrid->getSize(); ++i)
+		#pragma omp parallel num_threads( nThreadToUse )
 		{
-			float entropy = computeEntropySinglePoint_Unstructrued(i, nBins, binWidth, toNormalize);
-			entropyField[i] = entropy;
+			// Scratch of this thread, reused by all its vertices
+			vector<double> hist( nBins );
+			vector<ITL_tetvolume::Tet> pieces;
+			vector<ITL_tetvolume::Tet> scratch;
+
+			//compute entropy at each vertex
+			#pragma omp for schedule(dynamic, 64)
+			for (int i = 0; i < nVertices; ++i)
+				vertexEntropy[i] = computeEntropySinglePoint_Unstructured( i, nBins, binWidth, &hist[0],
+																		   pieces, scratch, toNormalize );
 		}
+
+		return vertexEntropy;
 	}
 
 	/**
 	 * Entropy computation function.
 	 * Computes entropy at a spatial point in the field.
+	 * @param neighborhood Neighborhood gather of the bin field (sets the boundary mode).
 	 * @param x x-coordinate of the spatial point.
 	 * @param y y-coordinate of the spatial point.
 	 * @param z z-coordinate of the spatial point.
-	 * @param nNeighbors total number of neighbors in the neighborhood (including self).
-	 * @param nBins Number of bins to use in histogram computation.
 	 * @param entropyFieldIndex 1D index to the entopy field.
 	 */
-	void computeEntropySinglePoint( int x, int y, int z,
-									int nNeighbors,
+	void computeEntropySinglePoint( const ITL_neighborhood& neighborhood,
+									int x, int y, int z,
 									int entropyFieldIndex, bool toNormalize )
 	{
+		int nNeighbors = neighborhood.getNumNeighbors();
 		#if defined( _WIN32 ) || defined( _WIN64 )
 			int* binArray = new int[nNeighbors];
-			int* localFreqList = new int[nBins];
+			int* localFreqList = new int[nBin];
 		#else
 			int binArray[nNeighbors];
 			int localFreqList[nBin];
 		#endif
-		int index1d = 0;
-		int binArrayIndex = 0;
-
-		/*
-		for( int k = -this->binData->grid->neighborhoodSize; k <= this->binData->grid->neighborhoodSize; k++ )
-		{
-			for( int j = -this->binData->grid->neighborhoodSize; j <= this->binData->grid->neighborhoodSize; j++ )
-			{
-				for( int i = -this->binData->grid->neighborhoodSize; i <= this->binData->grid->neighborhoodSize; i++ )
-				{
-		*/
-		int neighborhoodSize[4];
-		int lowPad[4];
-		int highPad[4];
-		int dimWithPad[4];
-		binData->getSizeWithPad( dimWithPad );
-		binData->getPadSize( lowPad, highPad );
-		binData->getNeighborhoodSize( neighborhoodSize );
-		//cout << dimWithPad[0] << " " << dimWithPad[1] << " " << dimWithPad[2] << " " << endl;
-		//cout << lowPad[0] << " " << lowPad[1] << " " << lowPad[2] << " " << endl;
-		//cout << highPad[0] << " " << highPad[1] << " " << highPad[2] << " " << endl;
-		//cout << neighborhoodSize[0] << " " << neighborhoodSize[1] << " " << neighborhoodSize[2] << " " << endl;
-
-		for( int k = -neighborhoodSize[2]; k <= neighborhoodSize[2]; k++ )
-		{
-			for( int j = -neighborhoodSize[1]; j <= neighborhoodSize[1]; j++ )
-			{
-				for( int i = -neighborhoodSize[0]; i <= neighborhoodSize[0]; i++ )
-				{
-
-					// Convert the 1D index corresponding to the point
-					#ifdef DUPLICATE
-					index1d = this->binData->grid->convert3DIndex( ITL_util<int>::clamp( x+i+this->binData->grid->lowPad[0], 0, this->binData->grid->dimWithPad[0]-1 ),
-													ITL_util<int>::clamp( y+j+this->binData->grid->lowPad[1], 0, this->binData->grid->dimWithPad[1]-1 ),
-													ITL_util<int>::clamp( z+k+this->binData->grid->lowPad[2], 0, this->binData->grid->dimWithPad[2]-1 ) );
-					#endif
-
-					#ifdef MIRROR
-					index1d = this->binData->convert3DIndex( ITL_util<int>::mirror( x+i+lowPad[0], 0, dimWithPad[0]-1 ),
-													ITL_util<int>::mirror( y+j+lowPad[1], 0, dimWithPad[1]-1 ),
-													ITL_util<int>::mirror( z+k+lowPad[2], 0, dimWithPad[2]-1 ) );
-					#endif
-
-					// Obtain the binID corresponding to the value at this location
-					//cout << i << " " << j << " " << k << " " << index1d << endl;
-					binArray[binArrayIndex] = this->binData->getDataAt( index1d );
-
-					// Move to next point in the neighborhood
-					binArrayIndex ++;
-				}
-			}
-		}
+		// Straight-line gather in the interior, boundary mode in the shell
+		neighborhood.gather( this->binData->getDataFull(), x, y, z, binArray );
 
 		// Compute entropy
 		float entropy = ITL_entropycore::computeEntropy_HistogramBased( binArray, localFreqList, nNeighbors, nBin, toNormalize );
@@ -288,7 +658,7 @@ public:
 
 
 		// Store entropy
-		this->entropyField->setDataAt( entropyFieldIndex, entropy );
+		this->entropyField->getDataFull()[entropyFieldIndex] = entropy;
 
 		#if defined( _WIN32 ) || defined( _WIN64 )
 			delete [] binArray;
@@ -303,193 +673,79 @@ public:
 	 * @param vid vertex id
 	 * @param nBins Number of bins to use in histogram computation.
 	 * @param binWidth width of each bin
+	 * @param hist Scratch histogram of nBins volumes.
+	 * @param pieces Scratch list of clipped tetrahedra.
+	 * @param scratch Scratch list of the clipping.
 	 */
-	float computeEntropySinglePoint_Unstructrued(int vid, int nBins, float binWidth, bool toNormalize)
+	float computeEntropySinglePoint_Unstructured( int vid, int nBins, float binWidth, double* hist,
+												  vector<ITL_tetvolume::Tet>& pieces,
+												  vector<ITL_tetvolume::Tet>& scratch, bool toNormalize )
 	{
 		//ITL_grid_unstructured<SCALAR>* uGrid = dynamic_cast<ITL_grid_unstructured<SCALAR>*>(dataField->grid);
 		ITL_grid_unstructured<SCALAR>* uGrid = dynamic_cast<ITL_grid_unstructured<SCALAR>*>(dataField->getGrid());
 		ITL_vertex<SCALAR>& vert = uGrid->vertexList[vid];
 
 		//min/max of neighborhood box
-		vec3<SCALAR> nei_min(vert.x - uGrid->radius, vert.y - uGrid->radius, vert.z - uGrid->radius);
-		vec3<SCALAR> nei_max(vert.x + uGrid->radius, vert.y + uGrid->radius, vert.z + uGrid->radius);
+		double nei_min[3] = { vert.x - uGrid->radius, vert.y - uGrid->radius, vert.z - uGrid->radius };
+		double nei_max[3] = { vert.x + uGrid->radius, vert.y + uGrid->radius, vert.z + uGrid->radius };
 
 		//get list of intersected and contained cells of vid's neighborhood box
 		std::vector<int>& intersectCells = uGrid->intersectCells[vid];
 		std::vector<int>& containedCells = uGrid->containCells[vid];
 
-		//sample density
-		int density = 10;
-
-		float* hist = new float[nBins];
-		memset(hist, 0, sizeof(float) * nBins);
+		memset( hist, 0, sizeof(double) * nBins );
 
-		//each sample point's percentage in the whole cell
-		float sampleFraction = 1.0/(density*density*density);
-
-		//sample each intersected cell
-		for (int i = 0; i < intersectCells.size(); ++i)
+		//for intersected cells, distribute the volume of the part inside the box
+		for (size_t i = 0; i < intersectCells.size(); ++i)
 		{
-			ITL_cell<SCALAR>* tet = &(uGrid->cellList[intersectCells[i]]);
-			SCALAR inc = 1.0/density;
-			SCALAR s, t, u;
-			vec3<SCALAR> v0(uGrid->vertexList[tet->v[0]].x, uGrid->vertexList[tet->v[0]].y, uGrid->vertexList[tet->v[0]].z);
-			vec3<SCALAR> v1(uGrid->vertexList[tet->v[1]].x, uGrid->vertexList[tet->v[1]].y, uGrid->vertexList[tet->v[1]].z);
-			vec3<SCALAR> v2(uGrid->vertexList[tet->v[2]].x, uGrid->vertexList[tet->v[2]].y, uGrid->vertexList[tet->v[2]].z);
-			vec3<SCALAR> v3(uGrid->vertexList[tet->v[3]].x, uGrid->vertexList[tet->v[3]].y, uGrid->vertexList[tet->v[3]].z);
-
-			SCALAR f0 = uGrid->vertexList[tet->v[0]].f;
-			SCALAR f1 = uGrid->vertexList[tet->v[1]].f;
-			SCALAR f2 = uGrid->vertexList[tet->v[2]].f;
-			SCALAR f3 = uGrid->vertexList[tet->v[3]].f;
-
-			vec3<SCALAR> N1( v1.x - v0.x, v2.x - v0.x, v3.x - v0.x);
-			vec3<SCALAR> N2( v1.y - v0.y, v2.y - v0.y, v3.y - v0.y);
-			vec3<SCALAR> N3( v1.z - v0.z, v2.z - v0.z, v3.z - v0.z);
-			vec3<SCALAR> vmin = nei_min - v0;
-			vec3<SCALAR> vmax = nei_max - v0;
-
-			float volume = abs(N1.dot(N2.cross(N3)) / 6.0);
-			float sampleVolume = volume * sampleFraction;
-
-			/* 
-			we sample the cell in the barycentric coordinate system, s, t, u (1-s-t-u) are the coordinates for each sample,
-			if a sample point is in the neighborhood box, it must satisfy
-			nei_min < v1*s + v2*t + v3*u + v0*(1-s-t-u) < nei_max  in cartesian space 
-			i.e.
-			nei_min - v0 < (v1-v0)*s + (v2-v0)*t + (v3-v0)*u < nei_max - v0  for each x, y, z
-			This defines a parallelepiped
-			We then calculate the 8 corners of the parallelepiped, so to get the range of s, t, u, hopefully they will be much 
-			smaller than [0,1]. Thus we can do less sampling.
-
-			Corner of parallelepiped is given by the intersection of 3 planes
-		    N1 . p = d1
-		    N2 . p = d2
-		    N3 . p = d3
-		    In the above and what follows, "." signifies the dot product and "*" is the cross product. 
-		    The intersection point P is given by:
-		                 d1 ( N2 * N3 ) + d2 ( N3 * N1 ) + d3 ( N1 * N2 )
-		    P = 	-------------------------------------------------------------------------
-		                               N1 . ( N2 * N3 ) 
-			*/
-
-			vec3<SCALAR> C23 = N2.cross(N3);
-			vec3<SCALAR> C31 = N3.cross(N1);
-			vec3<SCALAR> C12 = N1.cross(N2);
-			SCALAR D1C23 = N1.dot(C23);
-			SCALAR stumin[3], stumax[3];
-			if (D1C23)
-			{
-				//get 8 corners
-				vec3<SCALAR> p[8];
-				/*
-				p[0] = ( C23 * vmin.x + C31 * vmin.y + C12 * vmin.z) / D1C23;
-				p[1] = ( C23 * vmin.x + C31 * vmin.y + C12 * vmax.z) / D1C23;
-				p[2] = ( C23 * vmin.x + C31 * vmax.y + C12 * vmin.z) / D1C23;
-				p[3] = ( C23 * vmin.x + C31 * vmax.y + C12 * vmax.z) / D1C23;
-				p[4] = ( C23 * vmax.x + C31 * vmin.y + C12 * vmin.z) / D1C23;
-				p[5] = ( C23 * vmax.x + C31 * vmin.y + C12 * vmax.z) / D1C23;
-				p[6] = ( C23 * vmax.x + C31 * vmax.y + C12 * vmin.z) / D1C23;
-				p[7] = ( C23 * vmax.x + C31 * vmax.y + C12 * vmax.z) / D1C23;
-				*/
-
-				//get s,t,u range
-				stumin[0] = stumin[1] = stumin[2] = 1; 
-				stumax[0] = stumax[1] = stumax[2] = 0; 
-				for (int i = 0; i < 8; ++i)
-				{
-					stumin[0] = stumin[0] < p[i].x ? stumin[0] : p[i].x;
-					stumin[1] = stumin[1] < p[i].y ? stumin[1] : p[i].y;
-					stumin[2] = stumin[2] < p[i].z ? stumin[2] : p[i].z;
-					stumax[0] = stumax[0] > p[i].x ? stumax[0] : p[i].x;
-					stumax[1] = stumax[1] > p[i].y ? stumax[1] : p[i].y;
-					stumax[2] = stumax[2] > p[i].z ? stumax[2] : p[i].z;
-				}
-				stumin[0] = stumin[0] > 0 ? stumin[0] : 0;
-				stumin[1] = stumin[1] > 0 ? stumin[1] : 0;
-				stumin[2] = stumin[2] > 0 ? stumin[2] : 0;
-				stumax[0] = stumax[0] < 1 ? stumax[0] : 1;
-				stumax[1] = stumax[1] < 1 ? stumax[1] : 1;
-				stumax[2] = stumax[2] < 1 ? stumax[2] : 1;
-			}
-			else
-			{
-				stumin[0] = stumin[1] = stumin[2] = 0; 
-				stumax[0] = stumax[1] = stumax[2] = 1;
-			}
-
-			//new starting point for s, t, u 
-			SCALAR s0 = (int(stumin[0] / inc))*inc;
-			SCALAR t0 = (int(stumin[1] / inc))*inc;
-			SCALAR u0 = (int(stumin[2] / inc))*inc;
-
-			//doing incremental calculation to avoid expensive multiplication
-			vec3<SCALAR> ds((v1-v0)*inc), dt((v2-v0)*inc), du((v3-v0)*inc);
-			vec3<SCALAR> cs, ct, cu;
-			vec3<SCALAR> cs0((v1-v0)*s0 - ds), ct0((v2-v0)*t0 - dt), cu0((v3-v0)*u0 -du);
-
-			SCALAR dfs((f1-f0)*inc), dft((f2-f0)*inc), dfu((f3-f0)*inc);
-			SCALAR cfs, cft, cfu;
-			SCALAR cfs0((f1-f0)*s0 - dfs), cft0((f2-f0)*t0 - dft), cfu0((f3-f0)*u0 -dfu);
-
-			cs = cs0;
-			cfs = cfs0;
-			for (s = s0; s <= stumax[0]; s += inc)
-			{
-				cs = cs + ds;
-				ct = cs + ct0;
-				cfs = cfs + dfs;
-				cft = cfs + cft0;
-				for (t = t0; t <= stumax[1] && s + t <=1.00001; t += inc)
-				{
-					ct = ct + dt;
-					cu = ct + cu0;
-					cft = cft + dft;
-					cfu = cft + cfu0;
-					for (u = u0; u <= stumax[2] && s + t + u <= 1.00001; u += inc)
-					{
-						cu = cu + du;
-						cfu = cfu + dfu;
-						vec3<SCALAR> v = cu + v0;
-
-						//if sample points is in box, add contribution to histogram
-						if (v.x >= nei_min.x && v.y >= nei_min.y 
-							&& v.z >= nei_min.z && v.x <= nei_max.x && v.y <= nei_max.y && v.z <= nei_max.z)
-						{
-							SCALAR f = cfu + f0;
-							int binId = (int)floor( ( f - histogramMin ) / binWidth  );
-							binId = ITL_util<int>::clamp( binId, 0, nBins-1 );
-							hist[binId] += sampleVolume;
-						}
-					}
-				}
-			}
+			ITL_tetvolume::Tet tet = getTetrahedron( uGrid, intersectCells[i] );
+			ITL_tetvolume::clipToBox( tet, nei_min, nei_max, pieces, scratch );
+			for (size_t j = 0; j < pieces.size(); ++j)
+				ITL_tetvolume::addValueDistribution( pieces[j], histogramMin, binWidth, nBins, hist );
 		}
 
-		//for contained cells, do contour spectrum
-		double func[21]= {0};
-		double min=0,max=0;
-		int posmin=0,posmax=0;
-		double tt = 0;
-		ITL_grid_tetrahedral<SCALAR>* tetGrid = dynamic_cast<ITL_grid_tetrahedral<SCALAR>*>(uGrid);
-		for (int i = 0; i < containedCells.size(); ++i)
+		//for contained cells, distribute the volume of the whole cell
+		for (size_t i = 0; i < containedCells.size(); ++i)
+			ITL_tetvolume::addValueDistribution( getTetrahedron( uGrid, containedCells[i] ),
+												 histogramMin, binWidth, nBins, hist );
+
+		// Entropy of the volume fractions
+		double total = 0;
+		for (int i = 0; i < nBins; ++i)
+			total += hist[i];
+		if( total <= 0 )
+			return 0.0f;
+
+		double entropy = 0;
+		for (int i = 0; i < nBins; ++i)
 		{
-			tetGrid->local_func(i,func);
-
-			//min and max defines range of cell i
-			min=func[0];
-			max=func[5];
-			posmin = floor((min - histogramMin) / binWidth);
-			for(int j = posmin; histogramMin + j * binWidth < max; j++)
-			{
-				tt = tetGrid->contribution(func,histogramMin + j * binWidth, histogramMin + (j + 1) * binWidth);
-				if(tt > 0 || tt < 0)
-					hist[j] += tt;
-			}
+			double p = hist[i] / total;
+			if( p > 0 )
+				entropy -= p * ( log( p ) / log( 2.0 ) );
 		}
+		if( toNormalize )
+			entropy /= ( log( (double)nBins ) / log( 2.0 ) );
+
+		return (float)entropy;
+	}
 
-		float entropy = ITL_entropycore::computeEntropy_HistogramBased( hist, nBins, toNormalize );
-		return entropy;
+	/**
+	 * @return Tetrahedron of a cell of the grid, with the field value at each vertex.
+	 */
+	static ITL_tetvolume::Tet
+	getTetrahedron( ITL_grid_unstructured<SCALAR>* uGrid, int cid )
+	{
+		ITL_cell<SCALAR>& cell = uGrid->cellList[cid];
+		ITL_tetvolume::Tet tet;
+		for (int j = 0; j < 4; ++j)
+		{
+			const ITL_vertex<SCALAR>& v = uGrid->vertexList[cell.v[j]];
+			tet.v[j].p[0] = v.x;
+			tet.v[j].p[1] = v.y;
+			tet.v[j].p[2] = v.z;
+			tet.v[j].f = v.f;
+		}
+		return tet;
 	}
 
 	// ADD-BY-ABON 07/19/2011-BEGIN	
@@ -523,6 +779,25 @@ public:
 	{
 		return this->entropyField;
 	}// end function
+
+	/**
+	 * Coarse entropy field accessor function.
+	 * Returns the lattice of the last strided computation; lattice point i of
+	 * an axis lies at min( i*stride, dim-1 ) in the entropy field. The field
+	 * belongs to this object: it is replaced by the next strided computation
+	 * and deleted with the object.
+	 * @return pointer to coarse entropy field.
+	 */
+	ITL_field_regular<float>* getCoarseEntropyField()
+	{
+		return this->coarseEntropyField;
+	}// end function
+
+private:
+
+	// The coarse entropy field is owned; instances are not copied
+	ITL_localentropy( const ITL_localentropy& );
+	ITL_localentropy& operator= ( const ITL_localentropy& );
 };
 
 #endif
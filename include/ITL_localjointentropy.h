@@ -11,6 +11,8 @@
 #include "ITL_header.h"
 #include "ITL_field_regular.h"
 #include "ITL_entropycore.h"
+#include "ITL_sparsehistogram.h"
+#include "ITL_neighborhood.h"
 
 template <class T>
 class ITL_localjointentropy
@@ -27,6 +29,9 @@ public:
 
 	ITL_histogram *histogram;	
 
+	ITL_sparsehistogram jointHistogram;		/**< Joint histogram of the current neighborhood (occupied bins only). */
+	int boundaryMode;						/**< How neighbors outside the field are read (ITL_neighborhood::BOUNDARY_*). */
+
 public:
 
 	/**
@@ -40,7 +45,18 @@ public:
 		this->jointEntropyField = NULL;
 		//histogramRangeSet = false;
 		histogram = hist;
+		boundaryMode = ITL_neighborhood::BOUNDARY_MIRROR;
 	}
+
+	/**
+	 * Boundary mode set function.
+	 * Selects how the neighbors outside the padded field are read by the next computation.
+	 * @param mode ITL_neighborhood::BOUNDARY_MIRROR (default), BOUNDARY_CLAMP or BOUNDARY_ZERO.
+	 */
+	void setBoundaryMode( int mode )
+	{
+		boundaryMode = mode;
+	}// end function
 	
 	/**
 	 * Joint histogram bin assignment function.
@@ -261,8 +277,9 @@ public:
 																    low, high );
 	    }
 
-		// Compute total number of vertices in the neighborhood, including the vertext itself
-		int nNeighbors = (int)std::pow( 2.0f*binData->getNeighborhoodSize() + 1.0f, binData->getNumDim() );
+		// Neighborhood gather with the boundary mode of this computation
+		ITL_neighborhood neighborhood( binData, boundaryMode );
+		vector<int> binArray( neighborhood.getNumNeighbors() );
 
 		int index1d = 0;
 		int dim[4];
@@ -274,7 +291,7 @@ public:
 				for( int x=0; x<dim[0]; x++ )
 				{
 					// Compute and store the value of entropy at this point
-					this->computeJointEntropySinglePoint( x, y, z, nNeighbors, nBins, index1d );
+					this->computeJointEntropySinglePoint( neighborhood, x, y, z, &binArray[0], nBins, index1d );
 
 					// increment to the next element
 					index1d ++;
@@ -287,106 +304,42 @@ public:
 	/**
 	 * Entropy computation function.
 	 * Computes entropy at a spatial point in the field.
+	 * @param neighborhood Neighborhood gather of the bin field (sets the boundary mode).
 	 * @param x x-coordinate of the spatial point.
 	 * @param y y-coordinate of the spatial point.
 	 * @param z z-coordinate of the spatial point.
-	 * @param nNeighbors total number of neighbors in the neighborhood (including self).
+	 * @param binArray Scratch array of neighborhood.getNumNeighbors() bin ids.
 	 * @param nBins Number of bins to use in histogram computation.
 	 * @param entropyFieldIndex 1D index to the entopy field.
 	 */
 
-	void computeJointEntropySinglePoint( int x, int y, int z, int nNeighbors, int nBins, int entropyFieldIndex )
+	void computeJointEntropySinglePoint( const ITL_neighborhood& neighborhood, int x, int y, int z,
+										 int* binArray, int nBins, int entropyFieldIndex )
 	{
-		int* binArray = new int[nNeighbors];
-		int index1d = 0;
-		int binArrayIndex = 0;
-
-
-		int neighborhoodSize = binData->getNeighborhoodSize();
-		int lowPad[4];
-		int highPad[4];
-		int dimWithPad[4];
-		binData->getSizeWithPad( dimWithPad );
-		binData->getPadSize( lowPad, highPad );
-		for( int k = -neighborhoodSize; k <= neighborhoodSize; k++ )
-		{
-			for( int j = -neighborhoodSize; j <= neighborhoodSize; j++ )
-			{
-				for( int i = -neighborhoodSize; i <= neighborhoodSize; i++ )
-				{
-					// Convert the 1D index corresponding to the point
-					#ifdef DUPLICATE
-					index1d = this->binData->grid->convert3DIndex( ITL_util<int>::clamp( x+i+this->binData->grid->lowPad[0], 0, this->binData->grid->dimWithPad[0]-1 ),
-													ITL_util<int>::clamp( y+j+this->binData->grid->lowPad[1], 0, this->binData->grid->dimWithPad[1]-1 ),
-													ITL_util<int>::clamp( z+k+this->binData->grid->lowPad[2], 0, this->binData->grid->dimWithPad[2]-1 ) );
-					#endif
-
-					#ifdef MIRROR
-					index1d = this->binData->convert3DIndex( ITL_util<int>::mirror( x+i+lowPad[0], 0, dimWithPad[0]-1 ),
-													ITL_util<int>::mirror( y+j+lowPad[1], 0, dimWithPad[1]-1 ),
-													ITL_util<int>::mirror( z+k+lowPad[2], 0, dimWithPad[2]-1 ) );
-					#endif
-
-					// Obtain the binID corresponding to the value at this location
-					binArray[binArrayIndex] = this->binData->getDataAt( index1d );
-
-					// Move to next point in the neighborhood
-					binArrayIndex ++;
-				}
-			}
-		}
+		// Straight-line gather in the interior, boundary mode in the shell
+		neighborhood.gather( this->binData->getDataFull(), x, y, z, binArray );
 
 		// Compute entropy
-		int* localJointFreqList = NULL;
-		float entropy = this->computeJointEntropy( binArray, localJointFreqList, nNeighbors, nBins*nBins );
+		float entropy = this->computeJointEntropy( binArray, neighborhood.getNumNeighbors(), nBins*nBins );
 
 		// Store entropy
-		this->jointEntropyField->setDataAt( entropyFieldIndex, entropy );
-
-		delete [] localJointFreqList;
-		delete binArray;
+		this->jointEntropyField->getDataFull()[entropyFieldIndex] = entropy;
 
 	}// end function
 
 	/**
 	 * Joint entropy computation function.
+	 * Counts into a sparse histogram, so the cost depends on nels, not on nbins.
 	 * @param binIds Pointer to array containing histogram bin assignments of the points in the neighborhood.
 	 * @param nels Number of points in the neighborhood. Same as the length of bin array.
 	 * @param nbins Number of bins used in histogram computation.
 	 */
-	float computeJointEntropy( int* binIds, int* jointFreqArray, int nels, int nbins )
+	float computeJointEntropy( int* binIds, int nels, int nbins )
 	{
-		// Initialize probability array
-		if( jointFreqArray == NULL ) jointFreqArray = new int[nbins];
-		float* probarray = new float[nbins];
-		for( int i=0; i<nbins; i++ )
-		{
-			jointFreqArray[i] = 0;
-			probarray[i] = 0;
-		}
-
-		// Scan through bin Ids and keep count
-		for( int i = 0; i<nels; i++ )
-			jointFreqArray[ binIds[i] ] ++;
-
-		// Turn count into probabilities
-		for( int i = 0; i<nbins; i++ )
-			probarray[i] = jointFreqArray[i] / (float)nels;
-
-
-		// Compute entropy
-		float entropy = 0;
-		for( int i = 0; i<nbins; i++ )
-		{
-			entropy += ( probarray[i] * ( probarray[i] == 0 ? 0 : ( log( probarray[i] ) / log(2.0) ) ) );
-		}
-
-		entropy = -entropy;
-
-		delete [] jointFreqArray;
-		delete [] probarray;
+		jointHistogram.clear();
+		jointHistogram.add( binIds, nels );
 
-		return entropy;
+		return jointHistogram.computeEntropy( nbins, false );
 	}
 
 	/**
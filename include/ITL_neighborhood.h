@@ -0,0 +1,210 @@
+/**
+ * Neighborhood gather class.
+ * Collects the bin ids of the (2r+1)^3 neighborhood of a point of a padded bin
+ * field. Points whose neighborhood lies inside the padded field (the interior,
+ * i.e. most points) are gathered from a base index plus a precomputed table of
+ * linear offsets, with no per-neighbor coordinate mapping. Only the thin shell
+ * of points near the field boundary maps coordinates back into the field, with
+ * a boundary mode chosen at runtime.
+ * Point coordinates are local to the field without its pad, as in ITL_field_regular::getSize.
+ * Bin fields in the bricked layout are gathered through the same coordinate
+ * tables, with each neighbor indexed in its brick.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_NEIGHBORHOOD_H_
+#define ITL_NEIGHBORHOOD_H_
+
+#include "ITL_header.h"
+#include "ITL_util.h"
+#include "ITL_field_regular.h"
+
+class ITL_neighborhood
+{
+public:
+	/**
+	 * How neighbors outside the padded field are read.
+	 */
+	enum {
+		BOUNDARY_MIRROR = 0,	/**< Reflect about the boundary, repeating the edge voxel (default). */
+		BOUNDARY_CLAMP = 1,		/**< Repeat the edge voxel. */
+		BOUNDARY_ZERO = 2		/**< Neighbors outside the field fall in bin 0. */
+	};
+
+private:
+	int boundaryMode;					/**< One of the BOUNDARY_* modes. */
+	int dim[3];							/**< Size of the field without pad. */
+	int dimWithPad[3];					/**< Size of the padded field. */
+	int lowPad[3];						/**< Pad below the field along each axis. */
+	int neighborhoodSize[3];			/**< Neighborhood radius along each axis. */
+	int nNeighbors;						/**< Number of points in a neighborhood (including self). */
+	int interiorLow[3];					/**< First interior point along each axis. */
+	int interiorHigh[3];				/**< One past the last interior point along each axis. */
+	vector<int> offset;					/**< Linear offset of each neighbor from the point, in gather order. */
+	vector<int> coordinate[3];			/**< Per axis, padded coordinate of each neighbor coordinate from -r to dim+r-1 (-1 outside the field in zero mode). */
+	ITL_bricklayout layout;				/**< Layout of the bin field (linear unless bricked). */
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param binField Padded bin field the neighborhoods are gathered from (any bin Id type).
+	 * @param mode Boundary mode (BOUNDARY_MIRROR, BOUNDARY_CLAMP or BOUNDARY_ZERO).
+	 */
+	template <class B>
+	ITL_neighborhood( ITL_field_regular<B>* binField, int mode = BOUNDARY_MIRROR )
+	{
+		assert( binField != NULL );
+		assert( mode >= BOUNDARY_MIRROR && mode <= BOUNDARY_ZERO );
+		boundaryMode = mode;
+
+		int d4[4] = { 1, 1, 1, 1 };
+		int dWithPad4[4] = { 1, 1, 1, 1 };
+		int lowPad4[4] = { 0, 0, 0, 0 };
+		int highPad4[4] = { 0, 0, 0, 0 };
+		int neighborhoodSize4[4] = { 0, 0, 0, 0 };
+		binField->getSize( d4 );
+		binField->getSizeWithPad( dWithPad4 );
+		binField->getPadSize( lowPad4, highPad4 );
+		binField->getNeighborhoodSize( neighborhoodSize4 );
+
+		nNeighbors = 1;
+		for( int d=0; d<3; d++ )
+		{
+			dim[d] = d4[d];
+			dimWithPad[d] = dWithPad4[d];
+			lowPad[d] = lowPad4[d];
+			neighborhoodSize[d] = neighborhoodSize4[d];
+			nNeighbors *= 2*neighborhoodSize[d] + 1;
+
+			// Interior: x+lowPad-r >= 0 and x+lowPad+r <= dimWithPad-1
+			interiorLow[d] = max( neighborhoodSize[d] - lowPad[d], 0 );
+			interiorHigh[d] = min( dimWithPad[d] - lowPad[d] - neighborhoodSize[d], dim[d] );
+
+			coordinate[d].resize( dim[d] + 2*neighborhoodSize[d] );
+			for( int i=0; i<(int)coordinate[d].size(); i++ )
+				coordinate[d][i] = mapCoordinate( i - neighborhoodSize[d] + lowPad[d], dimWithPad[d], boundaryMode );
+		}
+
+		layout = binField->getBrickLayout();
+
+		// Offsets, in the order of the k-j-i loops of the shell
+		offset.resize( nNeighbors );
+		int n = 0;
+		for( int k = -neighborhoodSize[2]; k <= neighborhoodSize[2]; k++ )
+			for( int j = -neighborhoodSize[1]; j <= neighborhoodSize[1]; j++ )
+				for( int i = -neighborhoodSize[0]; i <= neighborhoodSize[0]; i++ )
+					offset[n++] = ( k*dimWithPad[1] + j )*dimWithPad[0] + i;
+
+	}// end constructor
+
+	/**
+	 * Boundary handling function.
+	 * Maps a coordinate of the padded field that may fall outside it back into it.
+	 * @param c Coordinate in the padded field.
+	 * @param n Size of the padded field along the axis.
+	 * @param mode Boundary mode.
+	 * @return Coordinate in [0, n-1], or -1 if the neighbor is outside the field in zero mode.
+	 */
+	static int
+	mapCoordinate( int c, int n, int mode )
+	{
+		if( c >= 0 && c < n )
+			return c;
+
+		switch( mode )
+		{
+		case BOUNDARY_CLAMP:
+			return ITL_util<int>::clamp( c, 0, n-1 );
+		case BOUNDARY_ZERO:
+			return -1;
+		default:
+			// A radius beyond the field size could reflect past the far side
+			return ITL_util<int>::clamp( ITL_util<int>::mirror( c, 0, n-1 ), 0, n-1 );
+		}
+	}// end function
+
+	/**
+	 * Neighborhood gather function.
+	 * @param binIds Bins of the padded field (getDataFull(), in the layout of the field).
+	 * @param x x-coordinate of the point.
+	 * @param y y-coordinate of the point.
+	 * @param z z-coordinate of the point.
+	 * @param binArray Array of getNumNeighbors() bin ids (allocated by the caller).
+	 */
+	template <class B>
+	void
+	gather( const B* binIds, int x, int y, int z, int* binArray ) const
+	{
+		// Interior: straight-line gather
+		if( isInterior( x, y, z ) && !layout.isBricked() )
+		{
+			const B* base = binIds + ( (size_t)( z + lowPad[2] )*dimWithPad[1] + ( y + lowPad[1] ) )*dimWithPad[0] + ( x + lowPad[0] );
+			const int* off = &offset[0];
+			for( int n=0; n<nNeighbors; n++ )
+				binArray[n] = base[ off[n] ];
+			return;
+		}
+
+		// Boundary shell (or bricked layout): map each coordinate
+		int n = 0;
+		for( int k = 0; k <= 2*neighborhoodSize[2]; k++ )
+		{
+			int cz = coordinate[2][z+k];
+			for( int j = 0; j <= 2*neighborhoodSize[1]; j++ )
+			{
+				int cy = coordinate[1][y+j];
+				if( layout.isBricked() )
+				{
+					for( int i = 0; i <= 2*neighborhoodSize[0]; i++ )
+					{
+						int cx = coordinate[0][x+i];
+						binArray[n++] = ( cz < 0 || cy < 0 || cx < 0 ) ? 0 : binIds[ layout.convert3DIndex( cx, cy, cz ) ];
+					}
+					continue;
+				}
+
+				const B* row = ( cz < 0 || cy < 0 ) ? NULL : binIds + ( (size_t)cz*dimWithPad[1] + cy )*dimWithPad[0];
+				for( int i = 0; i <= 2*neighborhoodSize[0]; i++ )
+				{
+					int cx = coordinate[0][x+i];
+					binArray[n++] = ( row == NULL || cx < 0 ) ? 0 : row[cx];
+				}
+			}
+		}
+
+	}// end function
+
+	/**
+	 * @return TRUE if the neighborhood of the point lies inside the padded field.
+	 */
+	bool
+	isInterior( int x, int y, int z ) const
+	{
+		return x >= interiorLow[0] && x < interiorHigh[0] &&
+			   y >= interiorLow[1] && y < interiorHigh[1] &&
+			   z >= interiorLow[2] && z < interiorHigh[2];
+	}// end function
+
+	/**
+	 * Coordinate table accessor function.
+	 * @param d Axis.
+	 * @return Table whose entry c+r is the padded coordinate of neighbor coordinate c,
+	 * for c from -r to dim+r-1 (-1 outside the field in zero mode).
+	 */
+	const int* getCoordinateTable( int d ) const { return &coordinate[d][0]; }
+
+	/**
+	 * @return Layout of the bin field.
+	 */
+	const ITL_bricklayout& getLayout() const { return layout; }
+
+	int getBoundaryMode() const { return boundaryMode; }
+	int getNumNeighbors() const { return nNeighbors; }
+	int getNeighborhoodSize( int d ) const { return neighborhoodSize[d]; }
+	int getSize( int d ) const { return dim[d]; }
+	int getSizeWithPad( int d ) const { return dimWithPad[d]; }
+};
+
+#endif
+/* ITL_NEIGHBORHOOD_H_ */
@@ -11,6 +11,8 @@
 #include "ITL_header.h"
 #include "ITL_field_regular.h"
 #include "ITL_globalentropy.h"
+#include "ITL_integralhistogram.h"
+#include "ITL_pool.h"
 
 /*
 float
@@ -23,13 +25,20 @@ distFeature( feature_t *F1, feature_t *F2 )
 float (*funcPtr)( feature_t*, feature_t* ) = &distFeature;
 */
 
-template <class T>
+/**
+ * @tparam T Type of the field values.
+ * @tparam B Type of the bin Ids (int, uint16_t or uint8_t, see ITL_histogrammapper::getBinIdSize).
+ */
+template <class T, class B = int>
 class ITL_partition
 {
 	int nDim;
 	int mappingType;
 	int nTrial;
 	float percentArray[30];
+	ITL_integralhistogram<B>* integralHistogram;	/**< Optional integral histogram of the parent bin field. */
+	ITL_pool ownPool;								/**< Pool of the trial split buffers, unless one is set. */
+	ITL_pool* pool;									/**< Pool the trial split buffers are taken from. */
 
 public:
 	/**
@@ -39,6 +48,8 @@ public:
 	{
 		nDim = nd;
 		mappingType = mappingtype;
+		integralHistogram = NULL;
+		pool = &ownPool;
 
 		// Set the number of trials
 		// and trial split positions
@@ -66,6 +77,29 @@ public:
 	{
 	}
 
+	/**
+	 * Pool set function.
+	 * The child bin Ids and frequency list of every trial split are taken
+	 * from this pool, so that successive splits reuse the same buffers.
+	 * @param p Pool (owned by the caller, e.g. shared with the per-block
+	 * computations), NULL for a pool owned by this partitioner.
+	 */
+	void setPool( ITL_pool* p )
+	{
+		pool = ( p != NULL ) ? p : &ownPool;
+	}// end function
+
+	/**
+	 * Integral histogram set function.
+	 * When set, children of the bin field it was built over are measured
+	 * with box queries instead of copying and rescanning their voxels.
+	 * @param ih Integral histogram (owned by the caller), NULL to disable.
+	 */
+	void setIntegralHistogram( ITL_integralhistogram<B>* ih )
+	{
+		integralHistogram = ih;
+	}
+
 	/**
 	 *
 	*/
@@ -185,7 +219,7 @@ public:
 	 *
 	*/
 	void partition_Kdtree_SplitMiddle2( float *parentLow, float *parentHigh,
-										ITL_field_regular<int> *parentBinField,
+										ITL_field_regular<B> *parentBinField,
 										int level, int nchild, int nBin,
 										float **childLow, float **childHigh,
 										float **childFreqList, float *entropyArray )
@@ -342,7 +376,7 @@ public:
 	 *
 	 */
 	void partition_MaxEntropy2( float *parentLow, float *parentHigh,
-								ITL_field_regular<int> *parentBinField,
+								ITL_field_regular<B> *parentBinField,
 								int nchild, int nBin,
 								float **childLow, float **childHigh,
 								float **childFreqList, float *entropyArray )
@@ -627,7 +661,7 @@ public:
 	 */
 	int
 	partition_EMD2( float *parentLow, float *parentHigh,
-				    ITL_field_regular<int> *parentBinField,
+				    ITL_field_regular<B> *parentBinField,
 					int nchild, int nBin,
 					float **childLow, float **childHigh,
 					float **childFreqList, float *metricArray,
@@ -923,49 +957,37 @@ public:
 		
 	}// end function
 
-	void computeEntropyChildren2( ITL_field_regular<int> *parentBinField,
+	void computeEntropyChildren2( ITL_field_regular<B> *parentBinField,
 								  int nchild, int nBin,
 								  float **childLow, float **childHigh,
 								  float **childFreqList, float *entropyArray )
 	{
-		float lowF[3];
-		float highF[3];
-		lowF[0] = lowF[1] = lowF[2] = 0;
-		int* childFieldBinData = NULL;
-		ITL_field_regular<T> *childField = NULL;
-		ITL_field_regular<int> *childBinField = NULL;
-		ITL_globalentropy<T> *globalEntropyComputer = NULL;
+		// Box queries on the integral histogram, no voxel copies
+		if( integralHistogram != NULL )
+		{
+			for( int i=0; i<nchild; i++ )
+				entropyArray[i] = integralHistogram->getBoxEntropy( childLow[i], childHigh[i], false );
+			return;
+		}
 
+		int* freqList = pool->acquire<int>( nBin );
 		for( int i=0; i<nchild; i++ )
 		{
-			// Get histogram bin data for the next child
-			childFieldBinData = parentBinField->getDataBetween( childLow[i], childHigh[i] );
-
-			// Create sub-field
-			highF[0] = childHigh[i][0] - childLow[i][0];
-			highF[1] = childHigh[i][1] - childLow[i][1];
-			highF[2] = childHigh[i][2] - childLow[i][2];
-
-			childField = new ITL_field_regular<T>( nDim, lowF, highF );
-			//, lowPad, highPad, sizeNeighborhoodArray );
-			childBinField = new ITL_field_regular<int>( childFieldBinData, nDim, lowF, highF );
-			//, lowPad, highPad, sizeNeighborhoodArray );
+			// Get histogram bin data for the next child, into a recycled buffer
+			int nPoint = 1;
+			for( int k=0; k<nDim; k++ )
+				nPoint *= (int)ceil( childHigh[i][k] ) - (int)floor( childLow[i][k] ) + 1;
+			B* childFieldBinData = pool->acquire<B>( nPoint );
+			parentBinField->getDataBetween( childLow[i], childHigh[i], childFieldBinData );
 
 			// Compute global entropy of the sub-field
-			globalEntropyComputer = new ITL_globalentropy<T>( NULL, childBinField );
-			if( mappingType == 2 )
-				globalEntropyComputer->computeHistogramBinField( "vector2", nBin );
-			else if( mappingType == 3 )
-				globalEntropyComputer->computeHistogramBinField( "vector", nBin );			
-			globalEntropyComputer->computeGlobalEntropyOfField( nBin, false, 0 );
-
-			entropyArray[i] = globalEntropyComputer->getGlobalEntropy();
+			ITL_histogrammapper<T>::countBinIds( childFieldBinData, nPoint, freqList, nBin );
+			entropyArray[i] = ITL_entropycore::computeEntropy_HistogramBased( freqList, nPoint, nBin, false );
 
-			delete globalEntropyComputer;
-			delete childField;
-			//delete childBinField;
+			pool->release( childFieldBinData );
 
 		}// end for
+		pool->release( freqList );
 		
 	}// end function
 
@@ -1031,7 +1053,7 @@ public:
 	}// End function
 
 	void
-	computeEMDMetricChildren2( ITL_field_regular<int> *parentBinField,
+	computeEMDMetricChildren2( ITL_field_regular<B> *parentBinField,
 	 					       int nchild, int nBin,
 							   float **childLow, float **childHigh,
 							   float **childFreqList, float *metricArray )
@@ -1041,7 +1063,7 @@ public:
 		lowF[0] = lowF[1] = lowF[2] = 0;
 		//T* childFieldData = NULL;
 		//ITL_field_regular<T> *childField = NULL;
-		//ITL_field_regular<int> *childBinField = NULL;
+		//ITL_field_regular<B> *childBinField = NULL;
 		ITL_globalentropy<T> *globalEntropyComputer = NULL;
 		//float *uniformWeight = new float[nBin];
 		float uniformWeight[360];
@@ -1049,7 +1071,7 @@ public:
 		for( int i=0; i<nBin; i++ )
 			uniformWeight[i] = uWeight;
 
-		int *childBinFieldData =NULL;
+		B *childBinFieldData =NULL;
 		for( int i=0; i<nchild; i++ )
 		{
 			// Get data for the next child
@@ -1099,7 +1121,7 @@ public:
 	}// End function
 
 	void
-	computeHistogramFrequencies( int *binIdList, int nPoint,
+	computeHistogramFrequencies( B *binIdList, int nPoint,
 								 float *freqList, int nBin )
 	{
 		assert( freqList != NULL );
@@ -1186,5 +1208,11 @@ public:
 
 	}// End function
 
+private:
+
+	// ownPool is referenced through pool; partitions are not copied
+	ITL_partition( const ITL_partition& );
+	ITL_partition& operator= ( const ITL_partition& );
+
 };
 #endif
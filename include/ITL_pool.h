@@ -0,0 +1,211 @@
+/**
+ * Memory pool class.
+ * Recycles the temporary arrays of blockwise loops (bin fields, frequency
+ * lists, entropy fields) across iterations. A released array goes back to the
+ * pool instead of the system, and the next request of a similar size gets it
+ * back, so a loop over hundreds of blocks allocates and first-touches its
+ * arrays once instead of once per block. Arrays are handed out uninitialized
+ * and are meant for plain data types. A pool is not thread-safe, and it must
+ * outlive every array and field taken from it.
+ * Created on: Oct 18, 2026.
+ */
+
+#ifndef ITL_POOL_H_
+#define ITL_POOL_H_
+
+#include "ITL_header.h"
+#include "ITL_field_regular.h"
+
+class ITL_pool
+{
+	/**
+	 * One array of the pool.
+	 */
+	struct Block
+	{
+		char* ptr;					/**< Start of the array. */
+		size_t size;				/**< Size of the array in bytes. */
+	};
+
+	vector<Block> freeBlocks;		/**< Arrays released to the pool. */
+	vector<Block> usedBlocks;		/**< Arrays handed out and not released yet. */
+	int nAllocation;				/**< Number of arrays allocated from the system. */
+	int nReuse;						/**< Number of requests served by a released array. */
+
+public:
+
+	/**
+	 * Constructor.
+	 */
+	ITL_pool()
+	{
+		nAllocation = 0;
+		nReuse = 0;
+	}// end constructor
+
+	/**
+	 * Destructor. Frees every array of the pool, released or not.
+	 */
+	~ITL_pool()
+	{
+		for( size_t i=0; i<usedBlocks.size(); i++ )
+			::operator delete( usedBlocks[i].ptr );
+		usedBlocks.clear();
+		trim();
+	}// end destructor
+
+	/**
+	 * Array request function.
+	 * Returns the smallest released array that holds n elements, if it is no
+	 * more than twice as large (plus a page), else a new array.
+	 * @param n Number of elements.
+	 * @return Uninitialized array of at least n elements.
+	 */
+	template <class T>
+	T*
+	acquire( size_t n )
+	{
+		size_t bytes = max( sizeof(T)*n, (size_t)1 );
+		int best = -1;
+		for( int i=0; i<(int)freeBlocks.size(); i++ )
+		{
+			size_t size = freeBlocks[i].size;
+			if( size >= bytes && size <= 2*bytes + 4096 &&
+				( best < 0 || size < freeBlocks[best].size ) )
+				best = i;
+		}
+
+		Block block;
+		if( best >= 0 )
+		{
+			block = freeBlocks[best];
+			freeBlocks[best] = freeBlocks.back();
+			freeBlocks.pop_back();
+			nReuse ++;
+		}
+		else
+		{
+			block.ptr = (char*)::operator new( bytes );
+			block.size = bytes;
+			nAllocation ++;
+		}
+		usedBlocks.push_back( block );
+		return (T*)block.ptr;
+	}// end function
+
+	/**
+	 * Array release function. Gives an array back to the pool for reuse.
+	 * @param ptr Array returned by acquire (NULL is ignored).
+	 */
+	template <class T>
+	void
+	release( T* ptr )
+	{
+		if( ptr == NULL )
+			return;
+
+		// Arrays are usually released in reverse order of their requests
+		for( int i=(int)usedBlocks.size()-1; i>=0; i-- )
+		{
+			if( usedBlocks[i].ptr != (char*)ptr )
+				continue;
+			freeBlocks.push_back( usedBlocks[i] );
+			usedBlocks.erase( usedBlocks.begin() + i );
+			return;
+		}
+		fprintf( stderr, "ITL_pool: released array was not taken from this pool\n" );
+		assert( false );
+	}// end function
+
+	/**
+	 * Field request function.
+	 * Creates a field whose data is a view of an array of the pool.
+	 * @param ndim Dimensionality of field.
+	 * @param l Lower grid bounds in continuous space along each dimension.
+	 * @param h Upper grid bounds in continuous space along each dimension.
+	 * @param lPad Ghost layer span along each dimension on the lower end.
+	 * @param hPad Ghost layer span along each dimension on the upper end.
+	 * @param neighborhoodsizearray Neighborhood length for each dimension.
+	 * @return Field with uninitialized data, to be given back with releaseField.
+	 */
+	template <class T>
+	ITL_field_regular<T>*
+	acquireField( int ndim, float* l, float* h, int* lPad, int* hPad, int* neighborhoodsizearray )
+	{
+		ITL_field_regular<T>* field = new ITL_field_regular<T>( (T*)NULL, ndim, l, h,
+																lPad, hPad, neighborhoodsizearray, false );
+		attachData( field );
+		return field;
+	}// end function
+
+	/**
+	 * Field request function for a field without pad.
+	 * @param ndim Dimensionality of field.
+	 * @param l Lower grid bounds in continuous space along each dimension.
+	 * @param h Upper grid bounds in continuous space along each dimension.
+	 * @return Field with uninitialized data, to be given back with releaseField.
+	 */
+	template <class T>
+	ITL_field_regular<T>*
+	acquireField( int ndim, float* l, float* h )
+	{
+		ITL_field_regular<T>* field = new ITL_field_regular<T>( (T*)NULL, ndim, l, h, false );
+		attachData( field );
+		return field;
+	}// end function
+
+	/**
+	 * Field release function. Deletes a field taken from acquireField and gives its data back to the pool.
+	 * @param field Field (NULL is ignored).
+	 */
+	template <class T>
+	void
+	releaseField( ITL_field_regular<T>* field )
+	{
+		if( field == NULL )
+			return;
+		release( field->getDataFull() );
+		delete field;
+	}// end function
+
+	/**
+	 * Frees the released arrays; arrays in use are kept.
+	 */
+	void
+	trim()
+	{
+		for( size_t i=0; i<freeBlocks.size(); i++ )
+			::operator delete( freeBlocks[i].ptr );
+		freeBlocks.clear();
+	}// end function
+
+	/**
+	 * Statistics accessor function.
+	 * @param nalloc Number of arrays allocated from the system.
+	 * @param nreuse Number of requests served by a released array.
+	 */
+	void
+	getStats( int* nalloc, int* nreuse ) const
+	{
+		*nalloc = nAllocation;
+		*nreuse = nReuse;
+	}// end function
+
+private:
+
+	// Blocks are owned by one pool; pools are not copied
+	ITL_pool( const ITL_pool& );
+	ITL_pool& operator= ( const ITL_pool& );
+
+	template <class T>
+	void
+	attachData( ITL_field_regular<T>* field )
+	{
+		int dimWithPad[4] = { 1, 1, 1, 1 };
+		field->getSizeWithPad( dimWithPad );
+		field->setDataFull( acquire<T>( (size_t)ITL_util<int>::prod( dimWithPad, field->getNumDim() ) ) );
+	}
+};
+
+#endif
+/* ITL_POOL_H_ */
@@ -0,0 +1,324 @@
+/**
+ * Out-of-core local entropy class.
+ * Computes the local entropy field of a scalar field stored in a .vol file
+ * (3 integer dimensions followed by the x-fastest values) that does not fit
+ * in memory. The field is processed in z-slabs: each slab is read with a halo
+ * of r slices on both sides, binned with ITL_histogrammapper, its entropy
+ * computed with ITL_localentropy, and the entropy slab appended to the output
+ * .vol file. The next slab is read by a second thread while the current one is
+ * computed, so reads overlap computation. Peak memory is two read buffers,
+ * one bin slab and one entropy slab, independent of the depth of the field.
+ * Halo slices are read again by the next slab rather than kept.
+ * The entropy field is the same as that of the whole field loaded at once
+ * without pad, in every boundary mode.
+ * Created on: Oct 18, 2026.
+ */
+
+#ifndef ITL_SLABSTREAMER_H_
+#define ITL_SLABSTREAMER_H_
+
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+#include <pthread.h>
+#endif
+
+#include "ITL_header.h"
+#include "ITL_util.h"
+#include "ITL_field_regular.h"
+#include "ITL_histogrammapper.h"
+#include "ITL_localentropy.h"
+
+/**
+ * @tparam B Type of the bin Ids (int, uint16_t or uint8_t, see ITL_histogrammapper::getBinIdSize).
+ */
+template <class B = int>
+class ITL_slabstreamer
+{
+	/**
+	 * One slab read: a range of slices of the input file into a buffer.
+	 */
+	struct SlabRead
+	{
+		FILE* file;					/**< Input file. */
+		long long offset;			/**< Byte offset of the first slice. */
+		size_t count;				/**< Number of values to read. */
+		SCALAR* buffer;				/**< Destination. */
+		size_t nRead;				/**< Number of values read. */
+	};
+
+	int nBin;						/**< Number of histogram bins. */
+	int radius;						/**< Neighborhood radius along each axis. */
+	int slabDepth;					/**< Number of z-slices computed per slab. */
+	int boundaryMode;				/**< Boundary mode of the local entropy (ITL_neighborhood::BOUNDARY_*). */
+	int nThread;					/**< Number of threads of the local entropy (0 for the OpenMP default). */
+
+	bool histogramRangeSet;			/**< TRUE if the histogram range was given, else it is found by a pre-pass over the file. */
+	SCALAR histogramMin;			/**< Lower limit of the histogram range. */
+	SCALAR histogramMax;			/**< Upper limit of the histogram range. */
+
+	double readWaitTime;			/**< Time spent waiting for reads in the last run (seconds). */
+	double computeTime;				/**< Time spent binning and computing entropy in the last run (seconds). */
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param nbin Number of histogram bins.
+	 * @param r Neighborhood radius along each axis.
+	 * @param slabdepth Number of z-slices per slab; memory grows with slabdepth + 2r.
+	 */
+	ITL_slabstreamer( int nbin, int r, int slabdepth )
+	{
+		assert( nbin > 0 && r >= 0 && slabdepth > 0 );
+		nBin = nbin;
+		radius = r;
+		slabDepth = slabdepth;
+		boundaryMode = ITL_neighborhood::BOUNDARY_MIRROR;
+		nThread = 0;
+		histogramRangeSet = false;
+		histogramMin = histogramMax = 0;
+		readWaitTime = computeTime = 0;
+	}// end constructor
+
+	/**
+	 * Histogram range set function. Skips the pre-pass that finds the range of the field.
+	 * @param m Lower limit of the value range.
+	 * @param M Upper limit of the value range.
+	 */
+	void setHistogramRange( SCALAR m, SCALAR M )
+	{
+		histogramMin = m;
+		histogramMax = M;
+		histogramRangeSet = true;
+	}// end function
+
+	void setBoundaryMode( int mode ) { boundaryMode = mode; }
+	void setNumThreads( int nthread ) { nThread = nthread; }
+
+	/**
+	 * Timing accessor function (last run).
+	 * @param readWait Time the computation waited for reads (seconds).
+	 * @param compute Time spent in binning and entropy computation (seconds).
+	 */
+	void getTimes( double* readWait, double* compute )
+	{
+		*readWait = readWaitTime;
+		*compute = computeTime;
+	}// end function
+
+	/**
+	 * Out-of-core local entropy computation function.
+	 * @param inFileName .vol file of the scalar field.
+	 * @param outFileName .vol file the entropy field is written to.
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 * @return FALSE if a file could not be opened or read.
+	 */
+	bool
+	computeLocalEntropy( const char* inFileName, const char* outFileName, bool toNormalize )
+	{
+		FILE* inFile = fopen( inFileName, "rb" );
+		if( inFile == NULL )
+		{
+			fprintf( stderr, "ITL_slabstreamer: cannot open %s\n", inFileName );
+			return false;
+		}
+		int dim[3];
+		if( fread( dim, sizeof(int), 3, inFile ) != 3 )
+		{
+			fclose( inFile );
+			return false;
+		}
+		long long headerSize = 3*sizeof(int);
+		size_t sliceSize = (size_t)dim[0]*dim[1];
+		readWaitTime = computeTime = 0;
+
+		// Histogram range of the whole field
+		if( !histogramRangeSet && !findRange( inFile, headerSize, sliceSize, dim[2] ) )
+		{
+			fclose( inFile );
+			return false;
+		}
+
+		FILE* outFile = fopen( outFileName, "wb" );
+		if( outFile == NULL )
+		{
+			fprintf( stderr, "ITL_slabstreamer: cannot open %s\n", outFileName );
+			fclose( inFile );
+			return false;
+		}
+		fwrite( dim, sizeof(int), 3, outFile );
+
+		// Two read buffers: one is computed while the next slab is read into the other
+		size_t bufferSize = sliceSize * ( slabDepth + 2*radius + 1 );
+		SCALAR* buffer[2] = { new SCALAR[bufferSize], new SCALAR[bufferSize] };
+		int nSlab = ( dim[2] + slabDepth - 1 ) / slabDepth;
+
+		ITL_histogrammapper<SCALAR> histMapper( NULL );
+		histMapper.setHistogramRange( histogramMin, histogramMax );
+
+		SlabRead read[2];
+		setSlabRead( read[0], inFile, headerSize, sliceSize, dim[2], 0, buffer[0] );
+		double startTime = ITL_util<float>::startTimer();
+		readSlab( &read[0] );
+		readWaitTime += ITL_util<float>::endTimer( startTime );
+
+		bool isOk = true;
+		for( int s=0; s<nSlab && isOk; s++ )
+		{
+			SlabRead& current = read[s%2];
+			if( current.nRead != current.count )
+			{
+				fprintf( stderr, "ITL_slabstreamer: %s is truncated\n", inFileName );
+				isOk = false;
+				break;
+			}
+
+			// Start reading the next slab
+			bool hasNext = ( s+1 < nSlab );
+			#if !defined( _WIN32 ) && !defined( _WIN64 )
+			pthread_t reader;
+			bool isAsync = false;
+			#endif
+			if( hasNext )
+			{
+				setSlabRead( read[(s+1)%2], inFile, headerSize, sliceSize, dim[2], s+1, buffer[(s+1)%2] );
+				#if !defined( _WIN32 ) && !defined( _WIN64 )
+				isAsync = ( pthread_create( &reader, NULL, readSlab, &read[(s+1)%2] ) == 0 );
+				if( !isAsync )
+					readSlab( &read[(s+1)%2] );
+				#else
+				readSlab( &read[(s+1)%2] );
+				#endif
+			}
+
+			// Compute and write the entropy of this slab
+			startTime = ITL_util<float>::startTimer();
+			computeSlab( histMapper, current.buffer, dim, s, outFile, toNormalize );
+			computeTime += ITL_util<float>::endTimer( startTime );
+
+			#if !defined( _WIN32 ) && !defined( _WIN64 )
+			if( isAsync )
+			{
+				startTime = ITL_util<float>::startTimer();
+				pthread_join( reader, NULL );
+				readWaitTime += ITL_util<float>::endTimer( startTime );
+			}
+			#endif
+		}
+
+		delete [] buffer[0];
+		delete [] buffer[1];
+		fclose( outFile );
+		fclose( inFile );
+		return isOk;
+
+	}// end function
+
+private:
+
+	/**
+	 * Slices [z0-halo, z1+halo) of slab s, clamped to the field.
+	 * Mirror mode reflects past the top slice to r+1 slices below it
+	 * (ITL_util::mirror), so the last slab keeps one more slice below.
+	 */
+	void
+	getSlabRange( int s, int nz, int* zLow, int* zHigh, int* lowHalo, int* highHalo )
+	{
+		*zLow = s*slabDepth;
+		*zHigh = min( *zLow + slabDepth, nz );
+		*lowHalo = min( radius + ( *zHigh == nz ? 1 : 0 ), *zLow );
+		*highHalo = min( radius, nz - *zHigh );
+	}
+
+	void
+	setSlabRead( SlabRead& read, FILE* file, long long headerSize, size_t sliceSize, int nz, int s, SCALAR* buffer )
+	{
+		int zLow, zHigh, lowHalo, highHalo;
+		getSlabRange( s, nz, &zLow, &zHigh, &lowHalo, &highHalo );
+
+		read.file = file;
+		read.offset = headerSize + (long long)( zLow - lowHalo ) * sliceSize * sizeof(SCALAR);
+		read.count = (size_t)( zHigh - zLow + lowHalo + highHalo ) * sliceSize;
+		read.buffer = buffer;
+		read.nRead = 0;
+	}
+
+	static void*
+	readSlab( void* arg )
+	{
+		SlabRead* read = (SlabRead*)arg;
+		#if defined( _WIN32 ) || defined( _WIN64 )
+		_fseeki64( read->file, read->offset, SEEK_SET );
+		#else
+		fseeko( read->file, (off_t)read->offset, SEEK_SET );
+		#endif
+		read->nRead = fread( read->buffer, sizeof(SCALAR), read->count, read->file );
+		return NULL;
+	}
+
+	/**
+	 * Bins slab s (with its halo) and appends the entropy of its slices to the output file.
+	 */
+	void
+	computeSlab( ITL_histogrammapper<SCALAR>& histMapper, SCALAR* data, int* dim, int s,
+				 FILE* outFile, bool toNormalize )
+	{
+		int zLow, zHigh, lowHalo, highHalo;
+		getSlabRange( s, dim[2], &zLow, &zHigh, &lowHalo, &highHalo );
+
+		// View of the slab as a field padded along z by its halo
+		float low[3] = { 0, 0, (float)zLow };
+		float high[3] = { dim[0]-1.0f, dim[1]-1.0f, zHigh-1.0f };
+		int lowPad[3] = { 0, 0, lowHalo };
+		int highPad[3] = { 0, 0, highHalo };
+		int neighborhoodSize[3] = { radius, radius, radius };
+		ITL_field_regular<SCALAR> slabField( data, 3, low, high, lowPad, highPad, neighborhoodSize, false );
+
+		ITL_field_regular<B>* binField = NULL;
+		histMapper.computeHistogramBinField_Scalar( &slabField, &binField, nBin );
+
+		ITL_localentropy<SCALAR, B> localEntropyComputer( binField, NULL, nBin );
+		localEntropyComputer.setBoundaryMode( boundaryMode );
+		localEntropyComputer.setNumThreads( nThread );
+		localEntropyComputer.computeLocalEntropyOfField( toNormalize );
+
+		ITL_field_regular<float>* entropyField = localEntropyComputer.getEntropyField();
+		fwrite( entropyField->getDataFull(), sizeof(float), entropyField->getSize(), outFile );
+
+		delete entropyField;
+		delete binField;
+	}
+
+	/**
+	 * Pre-pass: range of the values of the field, read slab by slab.
+	 */
+	bool
+	findRange( FILE* inFile, long long headerSize, size_t sliceSize, int nz )
+	{
+		double startTime = ITL_util<float>::startTimer();
+		vector<SCALAR> chunk( sliceSize * slabDepth );
+		SlabRead read;
+		read.file = inFile;
+		read.buffer = &chunk[0];
+		for( int z=0; z<nz; z+=slabDepth )
+		{
+			read.offset = headerSize + (long long)z * sliceSize * sizeof(SCALAR);
+			read.count = (size_t)min( slabDepth, nz - z ) * sliceSize;
+			readSlab( &read );
+			if( read.nRead != read.count )
+			{
+				fprintf( stderr, "ITL_slabstreamer: input is truncated\n" );
+				return false;
+			}
+
+			SCALAR m = ITL_util<SCALAR>::Min( &chunk[0], (int)read.count );
+			SCALAR M = ITL_util<SCALAR>::Max( &chunk[0], (int)read.count );
+			histogramMin = ( z == 0 ) ? m : min( histogramMin, m );
+			histogramMax = ( z == 0 ) ? M : max( histogramMax, M );
+		}
+		readWaitTime += ITL_util<float>::endTimer( startTime );
+		return true;
+	}
+};
+
+#endif
+/* ITL_SLABSTREAMER_H_ */
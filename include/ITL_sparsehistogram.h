@@ -0,0 +1,170 @@
+/**
+ * Sparse histogram class.
+ * Open-addressing hash from bin id to count, for histograms whose bins far
+ * outnumber the samples (e.g. joint histograms with nBin*nBin bins). Only
+ * occupied bins are stored and visited, so clearing, counting and entropy
+ * cost O(#samples) regardless of the number of bins.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_SPARSEHISTOGRAM_H_
+#define ITL_SPARSEHISTOGRAM_H_
+
+#include "ITL_header.h"
+#include "ITL_entropycore.h"
+
+class ITL_sparsehistogram
+{
+	vector<int> keys;					/**< Bin id stored in each slot, -1 if the slot is empty. */
+	vector<int> counts;					/**< Count of each slot. */
+	vector<int> usedSlots;				/**< Occupied slots, in insertion order. */
+	int nBit;							/**< The table has 2^nBit slots. */
+	int nPoint;							/**< Sum of the counts. */
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param nExpected Expected number of occupied bins; the table grows beyond it.
+	 */
+	ITL_sparsehistogram( int nExpected = 64 )
+	{
+		nBit = 4;
+		while( ( 1 << nBit ) < 2*nExpected )
+			nBit ++;
+		keys.assign( 1 << nBit, -1 );
+		counts.assign( 1 << nBit, 0 );
+		nPoint = 0;
+	}// end constructor
+
+	/**
+	 * Removes all counts. Only the occupied slots are touched.
+	 */
+	void
+	clear()
+	{
+		for( size_t i=0; i<usedSlots.size(); i++ )
+		{
+			keys[ usedSlots[i] ] = -1;
+			counts[ usedSlots[i] ] = 0;
+		}
+		usedSlots.clear();
+		nPoint = 0;
+	}// end function
+
+	/**
+	 * Adds samples to a bin.
+	 * @param binId Bin id (>= 0).
+	 * @param count Number of samples to add.
+	 */
+	void
+	add( int binId, int count = 1 )
+	{
+		// Keep the load factor at most 1/2
+		if( 2*( usedSlots.size() + 1 ) > keys.size() )
+			grow();
+
+		int slot = findSlot( binId );
+		if( keys[slot] < 0 )
+		{
+			keys[slot] = binId;
+			usedSlots.push_back( slot );
+		}
+		counts[slot] += count;
+		nPoint += count;
+	}// end function
+
+	/**
+	 * Adds a sample to the bin of each id.
+	 * @param binIds Array of bin ids.
+	 * @param n Number of ids.
+	 */
+	void
+	add( const int* binIds, int n )
+	{
+		for( int i=0; i<n; i++ )
+			add( binIds[i] );
+	}// end function
+
+	/**
+	 * @return Count of a bin (0 if the bin is empty).
+	 */
+	int
+	getCount( int binId ) const
+	{
+		int slot = findSlot( binId );
+		return ( keys[slot] < 0 ) ? 0 : counts[slot];
+	}// end function
+
+	int getNumOccupied() const { return (int)usedSlots.size(); }
+	int getNumPoints() const { return nPoint; }
+	int getOccupiedBin( int i ) const { return keys[ usedSlots[i] ]; }
+	int getOccupiedCount( int i ) const { return counts[ usedSlots[i] ]; }
+
+	/**
+	 * Dense copy of the histogram.
+	 * @param freqArray Array of nBin counts (allocated by the caller).
+	 * @param nBin Number of bins.
+	 */
+	void
+	getFrequencies( int* freqArray, int nBin ) const
+	{
+		memset( freqArray, 0, sizeof(int)*nBin );
+		for( size_t i=0; i<usedSlots.size(); i++ )
+			freqArray[ keys[ usedSlots[i] ] ] = counts[ usedSlots[i] ];
+	}// end function
+
+	/**
+	 * Histogram based entropy computation function.
+	 * Visits the occupied bins only.
+	 * @param nBin Number of bins of the dense histogram (used for normalization).
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 */
+	float
+	computeEntropy( int nBin, bool toNormalize ) const
+	{
+		double sumCLogC = 0;
+		for( size_t i=0; i<usedSlots.size(); i++ )
+			sumCLogC += ITL_entropycore::countLogCount( counts[ usedSlots[i] ] );
+
+		return ITL_entropycore::computeEntropy_CountBased( sumCLogC, nPoint, nBin, toNormalize );
+	}// end function
+
+private:
+
+	int
+	findSlot( int binId ) const
+	{
+		// Fibonacci hashing with linear probing
+		int mask = ( 1 << nBit ) - 1;
+		int slot = (int)( ( (uint32_t)binId * 2654435769u ) >> ( 32 - nBit ) );
+		while( keys[slot] >= 0 && keys[slot] != binId )
+			slot = ( slot + 1 ) & mask;
+		return slot;
+	}// end function
+
+	void
+	grow()
+	{
+		vector<int> oldKeys;
+		vector<int> oldCounts;
+		vector<int> oldSlots;
+		oldKeys.swap( keys );
+		oldCounts.swap( counts );
+		oldSlots.swap( usedSlots );
+
+		nBit ++;
+		keys.assign( 1 << nBit, -1 );
+		counts.assign( 1 << nBit, 0 );
+		for( size_t i=0; i<oldSlots.size(); i++ )
+		{
+			int slot = findSlot( oldKeys[ oldSlots[i] ] );
+			keys[slot] = oldKeys[ oldSlots[i] ];
+			counts[slot] = oldCounts[ oldSlots[i] ];
+			usedSlots.push_back( slot );
+		}
+	}// end function
+};
+
+#endif
+/* ITL_SPARSEHISTOGRAM_H_ */
@@ -0,0 +1,251 @@
+/**
+ * Spatiotemporal local entropy class.
+ * Local entropy over (x, y, z, t) neighborhoods of a time series of bin
+ * fields, for in situ analysis: time steps are pushed one at a time into a
+ * fixed-depth ring buffer, and the entropy field covers the (2r+1)^3 spatial
+ * neighborhood over the last depth steps. Every voxel keeps the histogram of
+ * its 4D neighborhood, so a push costs a single 3D pass that removes the
+ * counts of the evicted step and adds those of the new one; old steps are
+ * never re-binned or rescanned.
+ * The per-voxel histograms take nVoxel*nBin 16-bit counts, or 32-bit counts
+ * when the 4D neighborhood holds more than 65535 points.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_SPATIOTEMPORALENTROPY_H_
+#define ITL_SPATIOTEMPORALENTROPY_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ITL_header.h"
+#include "ITL_field_regular.h"
+#include "ITL_entropycore.h"
+#include "ITL_neighborhood.h"
+
+/**
+ * @tparam B Type of the bin Ids (int, uint16_t or uint8_t, see ITL_histogrammapper::getBinIdSize).
+ */
+template <class B = int>
+class ITL_spatiotemporalentropy
+{
+	int nBin;							/**< Number of histogram bins. */
+	int depth;							/**< Number of time steps in the temporal window. */
+	int nStep;							/**< Number of time steps in the ring buffer (at most depth). */
+	int head;							/**< Slot of the ring buffer the next step is written to. */
+	int boundaryMode;					/**< How neighbors outside the field are read (ITL_neighborhood::BOUNDARY_*). */
+	int nThread;						/**< Number of threads (0 for the OpenMP default). */
+
+	ITL_neighborhood* neighborhood;		/**< Spatial neighborhood, set up by the first step. */
+	vector< vector<B> > ring;			/**< Bin Ids (with pad) of the steps in the window. */
+	vector<B> evicted;					/**< Bin Ids of the step evicted by the last push (its buffer is reused). */
+	vector<uint16_t> counts;			/**< Per voxel, nBin counts of its 4D neighborhood. */
+	vector<int> wideCounts;				/**< Same as counts, used instead when a 4D neighborhood exceeds 65535 points. */
+	vector<double> sumCLogC;			/**< Per voxel, sum of c*log2(c) over its counts. */
+
+	ITL_field_regular<float>* entropyField;
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param nbin Number of histogram bins.
+	 * @param windowDepth Number of time steps in the temporal window.
+	 * @param mode Spatial boundary mode (ITL_neighborhood::BOUNDARY_*).
+	 */
+	ITL_spatiotemporalentropy( int nbin, int windowDepth, int mode = ITL_neighborhood::BOUNDARY_MIRROR )
+	{
+		assert( nbin > 0 && windowDepth > 0 );
+		nBin = nbin;
+		depth = windowDepth;
+		nStep = 0;
+		head = 0;
+		boundaryMode = mode;
+		nThread = 0;
+		neighborhood = NULL;
+		entropyField = NULL;
+		ring.resize( depth );
+	}// end constructor
+
+	/**
+	 * Destructor.
+	 */
+	~ITL_spatiotemporalentropy()
+	{
+		if( neighborhood != NULL )
+			delete neighborhood;
+		if( entropyField != NULL )
+			delete entropyField;
+	}// end destructor
+
+	/**
+	 * Thread count set function.
+	 * @param nthread Number of threads; 0 uses the OpenMP default (OMP_NUM_THREADS).
+	 */
+	void setNumThreads( int nthread )
+	{
+		nThread = nthread;
+	}// end function
+
+	/**
+	 * Time step push function.
+	 * Adds a time step to the window, evicting the oldest one once the window
+	 * is full, and updates the entropy field. The bin Ids are copied, so the
+	 * field can be reused for the next step.
+	 * All steps must have the same size, pad and neighborhood size, in the linear layout.
+	 * @param binField Bin field of the time step.
+	 * @param toNormalize TRUE indicates the computed entropy will be normalized.
+	 */
+	void
+	pushTimeStep( ITL_field_regular<B>* binField, bool toNormalize )
+	{
+		if( neighborhood == NULL )
+			initialize( binField );
+
+		int nPointWithPad = neighborhood->getSizeWithPad( 0 ) * neighborhood->getSizeWithPad( 1 ) * neighborhood->getSizeWithPad( 2 );
+		int dimWithPad[4] = { 1, 1, 1, 1 };
+		binField->getSizeWithPad( dimWithPad );
+		assert( dimWithPad[0] * dimWithPad[1] * dimWithPad[2] == nPointWithPad );
+
+		// Slot of the new step; it holds the evicted step when the window is full
+		bool toEvict = ( nStep == depth );
+		if( toEvict )
+			evicted.swap( ring[head] );
+		ring[head].assign( binField->getDataFull(), binField->getDataFull() + nPointWithPad );
+		const B* newIds = &ring[head][0];
+		const B* oldIds = toEvict ? &evicted[0] : NULL;
+		head = ( head + 1 ) % depth;
+		if( !toEvict )
+			nStep ++;
+
+		this->updateHistograms( newIds, oldIds, toNormalize );
+
+	}// end function
+
+	/**
+	 * Entropy field accessor function.
+	 * @return Entropy over the window of the last pushed steps (NULL before the first step).
+	 */
+	ITL_field_regular<float>* getEntropyField()
+	{
+		return entropyField;
+	}// end function
+
+	/**
+	 * @return Number of time steps currently in the window.
+	 */
+	int getNumSteps() const { return nStep; }
+
+	/**
+	 * @return Number of time steps in a full window.
+	 */
+	int getDepth() const { return depth; }
+
+private:
+
+	void
+	initialize( ITL_field_regular<B>* binField )
+	{
+		assert( binField->getLayout() == ITL_field_regular<B>::LAYOUT_LINEAR );
+		neighborhood = new ITL_neighborhood( binField, boundaryMode );
+
+		// 16-bit counts overflow once a bin can hold more than 65535 points
+		int nPoint = neighborhood->getSize( 0 ) * neighborhood->getSize( 1 ) * neighborhood->getSize( 2 );
+		if( (long long)depth * neighborhood->getNumNeighbors() <= 65535 )
+			counts.assign( (size_t)nPoint * nBin, 0 );
+		else
+			wideCounts.assign( (size_t)nPoint * nBin, 0 );
+		sumCLogC.assign( nPoint, 0 );
+
+		float low[4];
+		float high[4];
+		binField->getBounds( low, high );
+		entropyField = new ITL_field_regular<float>( binField->getNumDim(), low, high );
+	}
+
+	void
+	updateHistograms( const B* newIds, const B* oldIds, bool toNormalize )
+	{
+		if( wideCounts.empty() )
+			this->updateHistograms( &counts[0], newIds, oldIds, toNormalize );
+		else
+			this->updateHistograms( &wideCounts[0], newIds, oldIds, toNormalize );
+	}
+
+	/**
+	 * Single 3D pass: at every voxel, moves the counts of each neighbor from its
+	 * evicted bin to its new bin and recomputes the entropy.
+	 * @param voxelCounts Per-voxel counts (counts or wideCounts).
+	 */
+	template <class C>
+	void
+	updateHistograms( C* voxelCounts, const B* newIds, const B* oldIds, bool toNormalize )
+	{
+		int nX = neighborhood->getSize( 0 );
+		int nY = neighborhood->getSize( 1 );
+		int nRow = nY * neighborhood->getSize( 2 );
+		int nNeighbors = neighborhood->getNumNeighbors();
+		int nPoint4D = nStep * nNeighbors;
+		float* entropy = entropyField->getDataFull();
+
+		#ifdef _OPENMP
+		int nThreadToUse = ( nThread > 0 ) ? nThread : omp_get_max_threads();
+		#endif
+
+		#pragma omp parallel num_threads( nThreadToUse )
+		{
+			vector<int> newArray( nNeighbors );
+			vector<int> oldArray( nNeighbors );
+
+			#pragma omp for schedule(static)
+			for( int row=0; row<nRow; row++ )
+			{
+				int y = row % nY;
+				int z = row / nY;
+				for( int x=0; x<nX; x++ )
+				{
+					size_t v = (size_t)row*nX + x;
+					C* freq = &voxelCounts[ v*nBin ];
+					double sum = sumCLogC[v];
+
+					neighborhood->gather( newIds, x, y, z, &newArray[0] );
+					if( oldIds != NULL )
+					{
+						neighborhood->gather( oldIds, x, y, z, &oldArray[0] );
+						for( int n=0; n<nNeighbors; n++ )
+						{
+							int bOut = oldArray[n];
+							int bIn = newArray[n];
+							if( bOut == bIn )
+								continue;
+							sum = ITL_entropycore::updateCountLogCount( sum, freq[bOut], -1 );
+							freq[bOut] --;
+							sum = ITL_entropycore::updateCountLogCount( sum, freq[bIn], 1 );
+							freq[bIn] ++;
+						}
+					}
+					else
+					{
+						for( int n=0; n<nNeighbors; n++ )
+						{
+							int bIn = newArray[n];
+							sum = ITL_entropycore::updateCountLogCount( sum, freq[bIn], 1 );
+							freq[bIn] ++;
+						}
+					}
+
+					sumCLogC[v] = sum;
+					entropy[v] = ITL_entropycore::computeEntropy_CountBased( sum, nPoint4D, nBin, toNormalize );
+				}
+			}// end for : row
+		}
+	}
+
+	// The neighborhood and entropy field are owned; instances are not copied
+	ITL_spatiotemporalentropy( const ITL_spatiotemporalentropy& );
+	ITL_spatiotemporalentropy& operator= ( const ITL_spatiotemporalentropy& );
+};
+
+#endif
+/* ITL_SPATIOTEMPORALENTROPY_H_ */
@@ -0,0 +1,109 @@
+/**
+ * Nested spherical binning class.
+ * Recursively subdivides the icosahedron: every triangle of a level is split
+ * into 4 children at the edge midpoints (projected onto the sphere), so each
+ * patch is the exact union of its 4 children. Vectors are binned once at the
+ * finest level and the histogram of any coarser level is obtained by summing
+ * child counts. Patch b of level l+1 has parent b/4, and patches are numbered
+ * as in ITL_histogrammapper::createSphericalGrid.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_SPHERICALHIERARCHY_H_
+#define ITL_SPHERICALHIERARCHY_H_
+
+#include "ITL_header.h"
+#include "ITL_vectormatrix.h"
+
+class ITL_sphericalhierarchy
+{
+public:
+	enum {
+		MAX_NR_OF_LEVELS = 14			/**< Deepest hierarchy whose patch count (20*4^13) fits an int. */
+	};
+
+private:
+	int nLevel;							/**< Number of levels; level 0 is the icosahedron. */
+	vector< vector<float> > edgeNormal;	/**< Per level, 9 floats per patch: inward normals of the 3 great-circle edges. */
+	vector< vector<VECTOR3> > binCenter;/**< Per level, unit direction through the center of each patch. */
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param nlevel Number of levels (at most MAX_NR_OF_LEVELS). The finest level has 20*4^(nlevel-1) patches.
+	 */
+	ITL_sphericalhierarchy( int nlevel );
+
+	/**
+	 * @return Number of levels.
+	 */
+	int getNumLevels() const;
+
+	/**
+	 * @param level Level of the hierarchy (-1 for the finest).
+	 * @return Number of patches at the level.
+	 */
+	int getNumBins( int level ) const;
+
+	/**
+	 * Vector-to-bin conversion at a given level.
+	 * Descends from the icosahedron, testing only the 4 children of the
+	 * current patch at each level. The magnitude is ignored.
+	 * @param x x-component of the vector.
+	 * @param y y-component of the vector.
+	 * @param z z-component of the vector.
+	 * @param level Level of the hierarchy (-1 for the finest).
+	 * @return Patch index at the level.
+	 */
+	int getBinNumber3D( float x, float y, float z, int level = -1 ) const;
+
+	/**
+	 * Batch vector-to-bin conversion at the finest level.
+	 * @param xyz Array of n vectors stored as x0 y0 z0 x1 y1 z1 ...
+	 * @param n Number of vectors.
+	 * @param out Array of n patch indices.
+	 */
+	void mapVectorsToBins( const float* xyz, size_t n, int* out ) const;
+
+	/**
+	 * Maps a patch index to the index of its ancestor.
+	 * @param bin Patch index at level fromLevel.
+	 * @param fromLevel Level of the patch.
+	 * @param toLevel Coarser level.
+	 * @return Patch index at toLevel.
+	 */
+	static int getAncestor( int bin, int fromLevel, int toLevel );
+
+	/**
+	 * Derives the frequencies of a coarser level by summing child counts.
+	 * @param freq Frequencies at level fromLevel.
+	 * @param fromLevel Level of freq.
+	 * @param coarseFreq Frequencies at level toLevel (allocated by the caller).
+	 * @param toLevel Coarser level.
+	 */
+	void computeCoarseFrequencies( const int* freq, int fromLevel, int* coarseFreq, int toLevel ) const;
+
+	/**
+	 * @param level Level of the hierarchy.
+	 * @param bin Patch index.
+	 * @return Unit direction through the center of the patch.
+	 */
+	VECTOR3 getBinCenter( int level, int bin ) const;
+
+private:
+
+	// Smallest signed distance of v to the three edges; >= 0 iff v is inside the patch
+	float getInsideScore( const float* n, float x, float y, float z ) const
+	{
+		float s0 = n[0]*x + n[1]*y + n[2]*z;
+		float s1 = n[3]*x + n[4]*y + n[5]*z;
+		float s2 = n[6]*x + n[7]*y + n[8]*z;
+		return min( s0, min( s1, s2 ) );
+	}
+
+	void addPatch( int level, const double* a, const double* b, const double* c );
+};
+
+#endif
+/* ITL_SPHERICALHIERARCHY_H_ */
@@ -0,0 +1,105 @@
+/**
+ * Spherical kernel density estimation class.
+ * Orientation KDE with the von Mises-Fisher kernel
+ * K(x, mu) = C(kappa) * exp( kappa*(x.mu - 1) ).
+ * Directions are binned onto a level of a geodesic grid
+ * (ITL_sphericalhierarchy) and kernel sums run over grid cells instead of
+ * point pairs. The level follows the kernel width: the coarsest level whose
+ * cells are at most half the kernel width apart, so a truncated kernel covers
+ * at most ~1400 cells whatever kappa is (wide kernels give smooth densities
+ * that coarse levels resolve; the finest level is used for kernels narrower
+ * than its cells). Cells are indexed by a uniform 3D grid whose voxels are as
+ * wide as the truncation radius, so each cell only visits the cells in the 27
+ * surrounding voxels. The resulting entropy does not depend on a bin count.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_SPHERICALKDE_H_
+#define ITL_SPHERICALKDE_H_
+
+#include "ITL_header.h"
+#include "ITL_util.h"
+#include "ITL_vectormatrix.h"
+#include "ITL_sphericalhierarchy.h"
+
+class ITL_sphericalkde
+{
+public:
+	enum {
+		DEFAULT_NR_OF_LEVELS = 6,		/**< Finest level has 20*4^5 = 20480 cells (~1.6 degrees apart). */
+		CELLS_PER_KERNEL_WIDTH = 2,		/**< Cells per kernel width (1/sqrt(kappa)) on the level used for a kappa. */
+		MAX_NR_OF_VOXELS = 64			/**< Upper limit of the voxels along each axis of the cell index. */
+	};
+
+private:
+	ITL_sphericalhierarchy hierarchy;	/**< Geodesic grid the directions are binned onto. */
+	int finestLevel;					/**< Finest level of the hierarchy. */
+
+public:
+
+	/**
+	 * Constructor.
+	 * @param nlevel Number of levels of the geodesic grid.
+	 */
+	ITL_sphericalkde( int nlevel = DEFAULT_NR_OF_LEVELS );
+
+	/**
+	 * Level selection function.
+	 * @param kappa Kernel concentration.
+	 * @return Level of the geodesic grid the density is estimated on for kappa.
+	 */
+	int getLevel( double kappa ) const;
+
+	/**
+	 * @param level Level of the geodesic grid (-1 for the finest).
+	 * @return Number of cells of the level.
+	 */
+	int getNumCells( int level = -1 ) const;
+
+	/**
+	 * @param cell Cell index.
+	 * @param level Level of the geodesic grid (-1 for the finest).
+	 * @return Unit direction through the center of the cell.
+	 */
+	VECTOR3 getCellCenter( int cell, int level = -1 ) const;
+
+	/**
+	 * Rule-of-thumb kernel concentration.
+	 * Fits a von Mises-Fisher distribution to the directions and uses the
+	 * asymptotically optimal bandwidth for it (Garcia-Portugues, 2013).
+	 * Zero vectors are ignored.
+	 * @param data Array of vectors; the magnitude is ignored.
+	 * @param nPoint Number of vectors.
+	 * @return Kernel concentration kappa.
+	 */
+	static double estimateConcentration( const VECTOR3* data, int nPoint );
+
+	/**
+	 * Density estimation function.
+	 * @param data Array of vectors; the magnitude is ignored and zero vectors are skipped.
+	 * @param nPoint Number of vectors.
+	 * @param kappa Kernel concentration.
+	 * @param densityArray Density (per steradian) at the center of each cell of level getLevel( kappa ) (getNumCells( getLevel( kappa ) ) values).
+	 * @param truncation Kernel values below truncation times the peak are dropped.
+	 * @return Number of non-zero vectors used.
+	 */
+	int computeDensity( const VECTOR3* data, int nPoint, double kappa,
+						double* densityArray, double truncation = 1.0e-6 ) const;
+
+	/**
+	 * KDE based entropy computation function.
+	 * Differential entropy -integral( f*log2(f) ) over the sphere, in bits.
+	 * @param data Array of vectors; the magnitude is ignored and zero vectors are skipped.
+	 * @param nPoint Number of vectors.
+	 * @param kappa Kernel concentration (0 for estimateConcentration).
+	 * @param toNormalize TRUE divides by log2(4*pi), the entropy of the uniform distribution.
+	 */
+	float computeEntropy( const VECTOR3* data, int nPoint, double kappa, bool toNormalize ) const;
+
+private:
+
+	static double getKernelNormalization( double kappa );
+};
+
+#endif
+/* ITL_SPHERICALKDE_H_ */
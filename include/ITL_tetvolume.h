@@ -0,0 +1,261 @@
+/**
+ * Tetrahedron value-range volume class.
+ * Exact volume of a linearly interpolated tetrahedron per range of field
+ * values, as used by histograms of unstructured grids. A tetrahedron is first
+ * clipped to an axis-aligned box (the neighborhood of a vertex), which leaves
+ * a small set of tetrahedra; the field stays linear on each of them. The
+ * fraction of a tetrahedron below a value c is piecewise cubic in c with knots
+ * at the sorted vertex values, so bins get their exact share of the volume
+ * instead of a count of sample points.
+ * Created on: Oct 17, 2026.
+ */
+
+#ifndef ITL_TETVOLUME_H_
+#define ITL_TETVOLUME_H_
+
+#include "ITL_header.h"
+#include "ITL_util.h"
+
+class ITL_tetvolume
+{
+public:
+	/**
+	 * Vertex of a tetrahedron: position and field value.
+	 */
+	struct Vertex
+	{
+		double p[3];
+		double f;
+	};
+
+	/**
+	 * Tetrahedron with a linear field.
+	 */
+	struct Tet
+	{
+		Vertex v[4];
+	};
+
+	/**
+	 * @return Volume of a tetrahedron.
+	 */
+	static double
+	getVolume( const Tet& t )
+	{
+		return getVolume( t.v[0].p, t.v[1].p, t.v[2].p, t.v[3].p );
+	}// end function
+
+	/**
+	 * Box clipping function.
+	 * Splits the part of a tetrahedron inside an axis-aligned box into tetrahedra.
+	 * @param tet Tetrahedron to clip.
+	 * @param boxMin Lower corner of the box.
+	 * @param boxMax Upper corner of the box.
+	 * @param pieces Tetrahedra covering the clipped part (cleared first).
+	 * @param scratch Scratch list, reused across calls to avoid allocations.
+	 */
+	static void
+	clipToBox( const Tet& tet, const double* boxMin, const double* boxMax,
+			   vector<Tet>& pieces, vector<Tet>& scratch )
+	{
+		pieces.clear();
+		pieces.push_back( tet );
+		for( int d=0; d<3 && !pieces.empty(); d++ )
+		{
+			scratch.clear();
+			for( size_t i=0; i<pieces.size(); i++ )
+				clipByPlane( pieces[i], d, boxMin[d], false, scratch );
+			pieces.swap( scratch );
+
+			scratch.clear();
+			for( size_t i=0; i<pieces.size(); i++ )
+				clipByPlane( pieces[i], d, boxMax[d], true, scratch );
+			pieces.swap( scratch );
+		}
+	}// end function
+
+	/**
+	 * Histogram accumulation function.
+	 * Adds the volume of a tetrahedron to the bins of its value range, in exact
+	 * proportion. Values outside the histogram range fall in the first or last bin.
+	 * @param tet Tetrahedron.
+	 * @param histMin Lower bound of the first bin.
+	 * @param binWidth Width of each bin.
+	 * @param nBin Number of bins.
+	 * @param hist Array of nBin volumes.
+	 */
+	static void
+	addValueDistribution( const Tet& tet, double histMin, double binWidth, int nBin, double* hist )
+	{
+		double volume = getVolume( tet );
+		if( volume <= 0 )
+			return;
+
+		double f[4] = { tet.v[0].f, tet.v[1].f, tet.v[2].f, tet.v[3].f };
+		sort( f, f+4 );
+
+		int firstBin = ITL_util<int>::clamp( (int)floor( ( f[0] - histMin ) / binWidth ), 0, nBin-1 );
+		int lastBin = ITL_util<int>::clamp( (int)floor( ( f[3] - histMin ) / binWidth ), 0, nBin-1 );
+
+		// Share of each bin: difference of the fraction below its two edges
+		double below = 0;
+		for( int b = firstBin; b < lastBin; b++ )
+		{
+			double fraction = getFractionBelow( f, histMin + ( b + 1 ) * binWidth );
+			hist[b] += volume * ( fraction - below );
+			below = fraction;
+		}
+		hist[lastBin] += volume * ( 1.0 - below );
+	}// end function
+
+	/**
+	 * Distribution function.
+	 * @param f Sorted vertex values of a tetrahedron.
+	 * @param c Field value.
+	 * @return Fraction of the volume of the tetrahedron where the field is below c.
+	 */
+	static double
+	getFractionBelow( const double* f, double c )
+	{
+		if( c <= f[0] )
+			return 0;
+		if( c >= f[3] )
+			return 1;
+
+		// Corner tetrahedron around the lowest vertex
+		if( c <= f[1] )
+			return ( c - f[0] ) / ( f[1] - f[0] ) * ( c - f[0] ) / ( f[2] - f[0] ) * ( c - f[0] ) / ( f[3] - f[0] );
+
+		// Complement of the corner tetrahedron around the highest vertex
+		if( c >= f[2] )
+			return 1.0 - ( f[3] - c ) / ( f[3] - f[0] ) * ( f[3] - c ) / ( f[3] - f[1] ) * ( f[3] - c ) / ( f[3] - f[2] );
+
+		// Prism between the two lowest vertices and the cut of the edges toward
+		// the two highest, in the reference tetrahedron (volume 1/6)
+		double t02 = ( c - f[0] ) / ( f[2] - f[0] );
+		double t03 = ( c - f[0] ) / ( f[3] - f[0] );
+		double t12 = ( c - f[1] ) / ( f[2] - f[1] );
+		double t13 = ( c - f[1] ) / ( f[3] - f[1] );
+		double v0[3] = { 0, 0, 0 };
+		double v1[3] = { 1, 0, 0 };
+		double p02[3] = { 0, t02, 0 };
+		double p03[3] = { 0, 0, t03 };
+		double p12[3] = { 1-t12, t12, 0 };
+		double p13[3] = { 1-t13, 0, t13 };
+
+		return 6.0 * getPrismVolume( v0, p02, p03, v1, p12, p13 );
+	}// end function
+
+private:
+
+	static double
+	getVolume( const double* a, const double* b, const double* c, const double* d )
+	{
+		double u[3], v[3], w[3];
+		for( int k=0; k<3; k++ )
+		{
+			u[k] = b[k] - a[k];
+			v[k] = c[k] - a[k];
+			w[k] = d[k] - a[k];
+		}
+		double det = u[0]*( v[1]*w[2] - v[2]*w[1] ) -
+					 u[1]*( v[0]*w[2] - v[2]*w[0] ) +
+					 u[2]*( v[0]*w[1] - v[1]*w[0] );
+		return fabs( det ) / 6.0;
+	}
+
+	/**
+	 * Volume of the convex prism with triangles (a, b, c) and (a2, b2, c2) and lateral edges a-a2, b-b2, c-c2.
+	 */
+	static double
+	getPrismVolume( const double* a, const double* b, const double* c,
+					const double* a2, const double* b2, const double* c2 )
+	{
+		return getVolume( a, b, c, a2 ) + getVolume( b, c, a2, b2 ) + getVolume( c, a2, b2, c2 );
+	}
+
+	static Vertex
+	interpolate( const Vertex& a, const Vertex& b, double t )
+	{
+		Vertex v;
+		for( int k=0; k<3; k++ )
+			v.p[k] = a.p[k] + t*( b.p[k] - a.p[k] );
+		v.f = a.f + t*( b.f - a.f );
+		return v;
+	}
+
+	static Tet
+	makeTet( const Vertex& a, const Vertex& b, const Vertex& c, const Vertex& d )
+	{
+		Tet t;
+		t.v[0] = a;	t.v[1] = b;	t.v[2] = c;	t.v[3] = d;
+		return t;
+	}
+
+	static void
+	addPrism( const Vertex& a, const Vertex& b, const Vertex& c,
+			  const Vertex& a2, const Vertex& b2, const Vertex& c2, vector<Tet>& out )
+	{
+		out.push_back( makeTet( a, b, c, a2 ) );
+		out.push_back( makeTet( b, c, a2, b2 ) );
+		out.push_back( makeTet( c, a2, b2, c2 ) );
+	}
+
+	/**
+	 * Keeps the part of a tetrahedron on one side of the plane p[axis] = value.
+	 * @param keepBelow TRUE keeps p[axis] <= value, FALSE keeps p[axis] >= value.
+	 */
+	static void
+	clipByPlane( const Tet& t, int axis, double value, bool keepBelow, vector<Tet>& out )
+	{
+		double dist[4];
+		int inside[4], outside[4];
+		int nIn = 0, nOut = 0;
+		for( int i=0; i<4; i++ )
+		{
+			dist[i] = keepBelow ? value - t.v[i].p[axis] : t.v[i].p[axis] - value;
+			if( dist[i] >= 0 )
+				inside[nIn++] = i;
+			else
+				outside[nOut++] = i;
+		}
+
+		if( nIn == 4 )
+		{
+			out.push_back( t );
+			return;
+		}
+		if( nIn == 0 )
+			return;
+
+		// Point where edge i-j crosses the plane (i inside, j outside)
+		#define CUT( i, j ) interpolate( t.v[i], t.v[j], dist[i] / ( dist[i] - dist[j] ) )
+		switch( nIn )
+		{
+		case 1:
+		{
+			int a = inside[0];
+			out.push_back( makeTet( t.v[a], CUT( a, outside[0] ), CUT( a, outside[1] ), CUT( a, outside[2] ) ) );
+			break;
+		}
+		case 2:
+		{
+			// Wedge between the inside edge and the cut of the edges toward the outside ones
+			int a = inside[0], b = inside[1], c = outside[0], d = outside[1];
+			addPrism( t.v[a], CUT( a, c ), CUT( a, d ), t.v[b], CUT( b, c ), CUT( b, d ), out );
+			break;
+		}
+		case 3:
+		{
+			// Tetrahedron minus the corner of the outside vertex
+			int a = inside[0], b = inside[1], c = inside[2], d = outside[0];
+			addPrism( t.v[a], t.v[b], t.v[c], CUT( a, d ), CUT( b, d ), CUT( c, d ), out );
+			break;
+		}
+		}
+		#undef CUT
+	}
+};
+
+#endif
+/* ITL_TETVOLUME_H_ */
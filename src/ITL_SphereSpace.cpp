@@ -127,6 +127,11 @@ CSphereSpace::IMapVectorToPatch
 ) const
 // MOD-BY-LEETEN 07/23/2011-END
 {
+	// look up the dominant-axis cube face if the cube map has been built
+	if( iCubeMapResolution > 0 )
+		return piCubeMapping[ITL_cubemap::getCell(
+				(float)pdVector[0], (float)pdVector[1], (float)pdVector[2], iCubeMapResolution )];
+
 	// convert the vector from Cartesian coodinates to sphercial coordinates;
 	// the magnitude is ignored.
 	double mytheta = DGetAngle(pdVector[0], pdVector[1]);//0~2pi
@@ -220,8 +225,31 @@ CSphereSpace::_ComputeMapping
 		}
 }
 
+void
+CSphereSpace::_ComputeCubeMapping
+(
+	int iResolution
+)
+{
+	// label each cell with the patch of its center, via the spherical mapping
+	iCubeMapResolution = 0;
+	int iNrOfCells = ITL_cubemap::getNumCells(iResolution);
+	piCubeMapping.alloc(iNrOfCells);
+	for(int c = 0; c < iNrOfCells - 1; c++)
+	{
+		float f3Dir[3];
+		ITL_cubemap::getCellDirection(c, iResolution, f3Dir);
+		double pdDir[3] = { f3Dir[0], f3Dir[1], f3Dir[2] };
+		piCubeMapping[c] = IMapVectorToPatch(pdDir);
+	}
+	// zero-length and invalid vectors go to patch 0
+	piCubeMapping[iNrOfCells - 1] = 0;
+	iCubeMapResolution = iResolution;
+}
+
 CSphereSpace::CSphereSpace() {
 	// TODO Auto-generated constructor stub
+	iCubeMapResolution = 0;
 	CSphereSpace::_LoadDefaultMapping();
 }
 
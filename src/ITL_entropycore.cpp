@@ -1,39 +1,77 @@
 #include "ITL_entropycore.h"
 
-float
-ITL_entropycore::computeEntropy_HistogramBased( int* freqArray, int nPoint, int nBin, bool toNormalize )
+const double*
+ITL_entropycore::getCountLogCountTable()
 {
-	// Initialize probability array
-	#if defined( _WIN32 ) || defined( _WIN64 )
-		float* probArray = new float[nBin];
-	#else
-		float probArray[nBin];
-	#endif
-		
-	// Turn count into probabilities
+	// Function-local static: initialized exactly once, also under threads
+	struct CountLogCountTable
+	{
+		double value[COUNT_TABLE_SIZE];
+		CountLogCountTable()
+		{
+			value[0] = 0.0;
+			for( int c=1; c<COUNT_TABLE_SIZE; c++ )
+				value[c] = c * ( log( (double)c ) / log( 2.0 ) );
+		}
+	};
+	static const CountLogCountTable table;
+
+	return table.value;
+
+}// End function
+
+double
+ITL_entropycore::sumCountLogCount( const int* freqArray, int nBin )
+{
+	const double* table = getCountLogCountTable();
+
+	double sum = 0;
+	#pragma omp simd reduction(+:sum)
 	for( int i=0; i<nBin; i++ )
-		probArray[i] = freqArray[i] / (float)nPoint;
+	{
+		int c = freqArray[i];
+		sum += ( c < COUNT_TABLE_SIZE ) ? table[c] : c * ( log( (double)c ) / log( 2.0 ) );
+	}
 
-	// Compute negative entropy
-	float entropy = 0;
-	for( int i = 0; i<nBin; i++ )
+	return sum;
+
+}// End function
+
+float
+ITL_entropycore::computeEntropy_CountBased( const int* freqArray, int nPoint, int nBin, bool toNormalize )
+{
+	if( nPoint <= 0 )
+		return 0.0f;
+
+	const double* table = getCountLogCountTable();
+
+	// One pass for both sums
+	double sumCLogC = 0;
+	double sumC = 0;
+	#pragma omp simd reduction(+:sumCLogC,sumC)
+	for( int i=0; i<nBin; i++ )
 	{
-		entropy += ( probArray[i] * ( probArray[i] <= 0 ? 0 : ( log( probArray[i] ) / log(2.0) ) ) );
+		int c = freqArray[i];
+		sumCLogC += ( c < COUNT_TABLE_SIZE ) ? table[c] : c * ( log( (double)c ) / log( 2.0 ) );
+		sumC += c;
 	}
 
-	// Change sign
-	entropy = -entropy;
-	
+	// -sum( p*log2(p) ) with p = c/nPoint
+	double entropy = ( sumC * ( log( (double)nPoint ) / log( 2.0 ) ) - sumCLogC ) / nPoint;
+
 	// Normalize, if required
 	if( toNormalize )
-		entropy /= ( log( (float)nBin ) / log( 2.0f ) );
+		entropy /= ( log( (double)nBin ) / log( 2.0 ) );
 
-	#if defined( _WIN32 ) || defined( _WIN64 )
-		delete [] probArray;
-	#endif
+	return (float)entropy;
+
+}// End function
+
+float
+ITL_entropycore::computeEntropy_HistogramBased( int* freqArray, int nPoint, int nBin, bool toNormalize )
+{
+	return computeEntropy_CountBased( freqArray, nPoint, nBin, toNormalize );
 
-	return entropy;
-	
 }// End function
 
 float
@@ -91,47 +129,15 @@ ITL_entropycore::computeEntropy_HistogramBased2( double* probArray, int nBin, bo
 float
 ITL_entropycore::computeEntropy_HistogramBased( int* binIds, int* freqArray, int nPoint, int nBin, bool toNormalize )
 {
-	// Initialize probability array
-	#if defined( _WIN32 ) || defined( _WIN64 )
-		float* probArray = new float[nBin];
-	#else
-		float probArray[nBin];
-	#endif
-
 	for( int i=0; i<nBin; i++ )
-	{
 		freqArray[i] = 0;
-		probArray[i] = 0;
-	}
 
 	// Scan through bin Ids and keep count
 	for( int i=0; i<nPoint; i++ )
 		freqArray[ binIds[i] ] ++;
 
-	// Turn count into probabilities
-	for( int i=0; i<nBin; i++ )
-		probArray[i] = freqArray[i] / (float)nPoint;
-
-	// Compute negative entropy
-	float entropy = 0;
-	for( int i = 0; i<nBin; i++ )
-	{
-		entropy += ( probArray[i] * ( probArray[i] == 0 ? 0 : ( log( probArray[i] ) / log(2.0) ) ) );
-	}
+	return computeEntropy_CountBased( freqArray, nPoint, nBin, toNormalize );
 
-	// Change sign
-	entropy = -entropy;
-	
-	// Normalize, if required
-	if( toNormalize )
-		entropy /= ( log( (float)nBin ) / log( 2.0f ) );
-
-	#if defined( _WIN32 ) || defined( _WIN64 )
-		delete [] probArray;
-	#endif
-
-	return entropy;
-	
 }// End function
 
 float ITL_entropycore::computeEntropy_HistogramBased( float* freqArray, int nBin, bool toNormalize )
@@ -170,57 +176,27 @@ float ITL_entropycore::computeEntropy_KDEBased( float* data, int nPoint, float h
 	float mu = ITL_statutil<float>::Mean( data, nPoint );
 	float var = ITL_statutil<float>::Variance( data, nPoint, mu );
 	printf( "Mean and variance of the field: %f %f\n", mu, var );
-	
-	// Initialize probability array
-	#if defined( _WIN32 ) || defined( _WIN64 )
-		float* probArray = new float[nPoint];
-	#else
-		float probArray[nPoint];
-	#endif
-	for( int i=0; i<nPoint; i++ )
-		probArray[i] = 0;
-	
+
 	// Estimale kernel bandwidth
 	if( h == 0 )
-		h = 1.06 * var * pow( nPoint,-0.2f ) ;
-        printf( "Number of points in the field: %d\n", nPoint );	
+		h = ITL_kde::estimateBandwidth( var, nPoint );
+	printf( "Number of points in the field: %d\n", nPoint );
 	printf( "Kernel bandwidth: %f\n", h );
 
-	// Estimate probabilities at each point
-	float sumOfKernels = 0;
-	for( int i=0; i<nPoint; i++ )
-	{
-		sumOfKernels = 0;
-		for( int j=0; j<nPoint; j++ )
-		{
-			sumOfKernels += ITL_entropycore::evaluateKernel( ( data[i] - data[j] ) / h, mu, var ); 
-		}
-		probArray[i] = sumOfKernels / (nPoint*h);
-	}
-	
-	// Compute negative entropy
-	float entropy = 0;
-	for( int i = 0; i<nPoint; i++ )
-		entropy += ( probArray[i] * ( probArray[i] == 0 ? 0 : ( log( probArray[i] ) / log(2.0) ) ) );
-	
-	// Change sign
-	entropy = -entropy;
-	
-	// Normalize, if required
-	if( toNormalize )
-		entropy /= ( log( (float)nPoint ) / log( 2.0f ) );
-
-	#if defined( _WIN32 ) || defined( _WIN64 )
-		delete [] probArray;
-	#endif
+	// Estimate the density on a grid and compute its entropy
+	return ITL_kde::computeEntropy( data, nPoint, h, ITL_kde::DEFAULT_NR_OF_EVAL_POINTS, toNormalize );
 
-	return entropy;
-	
 }// End function
 
 float ITL_entropycore::computeEntropy_KDEBased( VECTOR3* data, int nPoint, float h, bool toNormalize )
 {
-	return 0.0f;
+	ITL_sphericalkde kde;
+
+	// Kernel concentration from the bandwidth
+	double kappa = ( h > 0 ) ? 1.0 / ( (double)h*h ) : ITL_sphericalkde::estimateConcentration( data, nPoint );
+
+	return kde.computeEntropy( data, nPoint, kappa, toNormalize );
+
 }// End function
 
 float ITL_entropycore::evaluateKernel( float x, float mu, float var )
@@ -7,268 +7,115 @@
  */
 #include "ITL_histogram.h"
 
-ITL_histogram::ITL_histogram( const char* patchFileName, int nbin )
+ITL_histogram::ITL_histogram( const char* patchFileName, int nbin, const char* cacheFileName )
 {
-	nResolution = 1;
-
-	// Initialize variables
-	nBin[0] = nbin;
-	iNrOfThetas[0] = nBin[0]*2;
-	iNrOfPhis[0] = nBin[0];
-	fNrOfThetas[0] = float(iNrOfThetas[0]);
-	fNrOfPhis[0] = float(iNrOfPhis[0]);
-	piAngleMap[0] = new int[iNrOfThetas[0]*iNrOfPhis[0]];
-	theta[0] = new float[2*nBin[0]];
-	phi[0] = new float[2*nBin[0]];
-	thetaCenter[0] = new float[nBin[0]];
-	phiCenter[0] = new float[nBin[0]];
-	binCenter[0] = new VECTOR3[nBin[0]];
+	table = new ITL_histogramtable( patchFileName, nbin, cacheFileName );
+	initializeState();
+}
 
-	// ADD-BY-Tzu-Hsuan-BEGIN-02/13
-	binDatas = NULL;
-	hist_RangeSet = false;
-	// ADD-BY-Tzu-Hsuan-END-02/13
-	
-	// Initialize bin map
-	ITL_init_histogram( patchFileName );
-	
-	// Set flag
-	bIsPatchRead = true;
+ITL_histogram::ITL_histogram( const char** patchfilename, int *nbin, int nresolution, const char* cacheFileName )
+{
+	table = new ITL_histogramtable( patchfilename, nbin, nresolution, cacheFileName );
+	initializeState();
+}
 
+ITL_histogram::ITL_histogram( ITL_histogramtable* sharedTable )
+{
+	table = sharedTable;
+	table->acquire();
+	initializeState();
 }
 
-ITL_histogram::ITL_histogram( const char** patchfilename, int *nbin, int nresolution )
+ITL_histogram::ITL_histogram( const ITL_histogram& that )
 {
-	assert( nresolution <= 5 );
-	nResolution = nresolution;
-	
-	// Initialize variables
-	for( int iR=0; iR<nResolution; iR++ )
-	{
-		nBin[iR] = nbin[iR];
-		iNrOfThetas[iR] = nBin[iR]*2;
-		iNrOfPhis[iR] = nBin[iR];
-		fNrOfThetas[iR] = float(iNrOfThetas[iR]);
-		fNrOfPhis[iR] = float(iNrOfPhis[iR]);
-		piAngleMap[iR] = new int[iNrOfThetas[iR]*iNrOfPhis[iR]];	
-		theta[iR] = new float[2*nBin[iR]];
-		phi[iR] = new float[2*nBin[iR]];
-		thetaCenter[iR] = new float[nBin[iR]];
-		phiCenter[iR] = new float[nBin[iR]];
-		binCenter[iR] = new VECTOR3[nBin[iR]];
-
-		// ADD-BY-Tzu-Hsuan-BEGIN-02/13
-		binDatas = NULL;
-		hist_RangeSet = false;
-		// ADD-BY-Tzu-Hsuan-END-02/13
-	
-		// Initialize bin map
-		ITL_init_histogram( patchfilename[iR], iR );
-	}
-	
-	// Set flag
-	bIsPatchRead = true;
+	table = NULL;
+	*this = that;
 }
 
-void
-ITL_histogram::ITL_init_histogram( const char* patchFileName, int iRes )
+ITL_histogram&
+ITL_histogram::operator= ( const ITL_histogram& that )
 {
-	// Initialize histogram parameters
-	if( patchFileName[0] == '!' )
+	if( this != &that )
 	{
-		// The patch provided in the header is only for
-		// one resolution with 360 bins
-		assert( iRes == 0 );
-		
-		//printf( "Reading default patch file...\n" );
-		readPatches_header();
+		that.table->acquire();
+		if( table != NULL )
+			table->release();
+		table = that.table;
+
+		histogramLow = that.histogramLow;
+		histogramHigh = that.histogramHigh;
+		binDatas = that.binDatas;
+		histMin = that.histMin;
+		histMax = that.histMax;
+		hist_RangeSet = that.hist_RangeSet;
+		vectorBinningMode = that.vectorBinningMode;
+		for( int iR=0; iR<ITL_histogramtable::MAX_NR_OF_RESOLUTIONS; iR++ )
+		{
+			iCubeMapResolution[iR] = that.iCubeMapResolution[iR];
+			piCubeMap[iR] = that.piCubeMap[iR];
+		}
 	}
-	else
-	{
-		//printf( "Reading patch file ..\n" );		
-		readPatches_region( patchFileName, iRes );
-	}	
-	
-	// Compute the histogram look up table - once for all
-	ITL_compute_table();
-
-}// end function
+	return *this;
+}
 
-// Read the lookup table provided in the header file
-void
-ITL_histogram::readPatches_header()
+ITL_histogram::~ITL_histogram()
 {
-	static char szPatch[] = { 
-	#include "ITL_patch.h" 
-	};
-	
-	char *szToken = strtok(szPatch, "\n");
-	float f2Temp[2];
-
-	for(int i=0;i<nBin[0]; i++)
-	{
-		float fAngle_radian;
-		sscanf( szToken,"%f, %f", &f2Temp[0],&f2Temp[1] );
-		theta[0][i*2+0] = f2Temp[0];
-		theta[0][i*2+1] = f2Temp[1];
-		szToken = strtok(NULL, "\n");
-		//printf( "%f %f\n", f2Temp[0], f2Temp[1] );
-
-		sscanf(szToken,"%f, %f", &f2Temp[0],&f2Temp[1] );
-		phi[0][i*2+0] = f2Temp[0];
-		phi[0][i*2+1] = f2Temp[1];
-		szToken = strtok(NULL, "\n");
-		//printf( "%f %f\n", f2Temp[0], f2Temp[1] );
-
-		thetaCenter[0][i] = ( theta[0][i*2+0] + theta[0][i*2+1] ) / 2.0f;
-		phiCenter[0][i] = ( phi[0][i*2+0] + phi[0][i*2+1] ) / 2.0f;
-		binCenter[0][i] = getXYZ( thetaCenter[0][i], phiCenter[0][i] );
-		//binCenter[0][i].Normalize();
-
-	}// end for
+	table->release();
 }
 
-// read the lookup table that map the thetas and phis to the patch index;
-// the lookup table is stored in the file 'patch.txt,' which contains 360 patches.
 void
-ITL_histogram::readPatches_region( const char* patchFileName, int iRes )
+ITL_histogram::initializeState()
 {
-	//if( true == ITL_histogram::bIsPatchRead )
-	//	return;
-
-	float x[2],y[2];
-	cout << "Reading patch file" << patchFileName << endl;
-	FILE* fp = fopen( patchFileName, "r" );
-	if( fp == NULL )
-		printf( "file open error\n" );
+	// ADD-BY-Tzu-Hsuan-BEGIN-02/13
+	binDatas = NULL;
+	hist_RangeSet = false;
+	// ADD-BY-Tzu-Hsuan-END-02/13
 
-	for(int i=0;i<nBin[iRes]; i++)
+	vectorBinningMode = VECTOR_BINNING_SPHERICAL;
+	for( int iR=0; iR<ITL_histogramtable::MAX_NR_OF_RESOLUTIONS; iR++ )
 	{
-		fscanf(fp,"%f, %f", &x[0],&y[0]);
-		fscanf(fp,"%f, %f", &x[1],&y[1]);
-
-		theta[iRes][i*2+0]=x[0];
-		theta[iRes][i*2+1]=y[0];
-		phi[iRes][i*2+0]=x[1];
-		phi[iRes][i*2+1]=y[1];
-
-		thetaCenter[iRes][i] = ( theta[0][i*2+0] + theta[0][i*2+1] ) / 2.0f;
-		phiCenter[iRes][i] = ( phi[0][i*2+0] + phi[0][i*2+1] ) / 2.0f;
-		binCenter[iRes][i] = getXYZ( thetaCenter[iRes][i], phiCenter[iRes][i] );
-		//binCenter[iRes][i].Normalize();
-
+		iCubeMapResolution[iR] = 0;
+		piCubeMap[iR] = NULL;
 	}
-	fclose(fp);
-	cout << "Reading patch file done" << endl;
-	//ITL_histogram::bIsPatchRead = true;
 }
 
-void
-ITL_histogram::ITL_compute_table()
+ITL_histogramtable*
+ITL_histogram::getTable() const
 {
-	for( int iR=0; iR<nResolution; iR++ )
-	{
-		ITL_compute_table( iR );
-	}
+	return table;
 }
 
-void
-ITL_histogram::ITL_compute_table( int iRes )
+bool
+ITL_histogram::writeAngleMapCache( const char* cacheFileName )
 {
-	for( int t = 0; t < iNrOfThetas[iRes]; t++ )
-		for( int p = 0; p < iNrOfPhis[iRes]; p++ )
-		{
-			float fTheta =	M_PI * 2.0f * float(t) / fNrOfThetas[iRes];
-			float fPhi =	M_PI * float(p) / fNrOfPhis[iRes];
-			int iBin = get_bin_by_angle(fTheta, fPhi, nBin[iRes], iRes );
-			if( iBin >= 0 )
-				piAngleMap[iRes][t*iNrOfPhis[iRes] + p] = iBin;
-		}
-
-	// set the flag to true
-	bIsAngleMapInitialized[iRes] = true;
-
-}// end function
+	return table->writeAngleMapCache( cacheFileName );
+}
 
-// convert the angles in the spherical coordinates (mytheta, myphi) to the patch index
-// according to the lookup table composed of theta and phi.
-// The #entries in the lookup table is specified by the parameter 'binnum'.
 int
 ITL_histogram::get_bin_by_angle( float mytheta, float myphi, int binnum, int iRes )
 {
-	for(int i=0; i<binnum;i++)
-	{
-		if( (mytheta>=theta[iRes][i*2+0]) && (mytheta<=theta[iRes][i*2+1])&&
-			(myphi>=phi[iRes][i*2+0]) && (myphi<=phi[iRes][i*2+1])
-			)
-		{
-			return i;
-		}
-	}
-	for(int i=0; i<binnum;i++)
-	{
-		if( ((mytheta+2*pi)>=theta[iRes][i*2+0]) && ((mytheta+2*pi)<=theta[iRes][i*2+1])&&
-			(myphi>=phi[iRes][i*2+0]) && (myphi<=phi[iRes][i*2+1])
-			)
-		{
-			return i;
-		}
-	}
-	for(int i=0; i<binnum;i++)
-	{
-		if( ((mytheta)>=theta[iRes][i*2+0]) && ((mytheta)<=theta[iRes][i*2+1])&&
-			((myphi+2*pi)>=phi[iRes][i*2+0]) && ((myphi+2*pi)<=phi[iRes][i*2+1])
-			)
-		{
-			return i;
-		}
-	}
-	for(int i=0; i<binnum;i++)
-	{
-		if( ((mytheta+2*pi)>=theta[iRes][i*2+0]) && ((mytheta+2*pi)<=theta[iRes][i*2+1])&&
-			((myphi+2*pi)>=phi[iRes][i*2+0]) && ((myphi+2*pi)<=phi[iRes][i*2+1])
-			)
-		{
-			return i;
-		}
-	}
-	return -1;
+	return table->get_bin_by_angle( mytheta, myphi, binnum, iRes );
 }
-// ADD-BY-LEETEN 02/02/2010-END
 
 // compute the theta
 float
 ITL_histogram::getAngle(float x, float y)
 {
-
-	if((x==0)&&(y==0))
-		return 0;
-	else
-	{
-		return (pi+(atan2(y,x)));
-	}
+	return ITL_histogramtable::getAngle( x, y );
 }
 
 // compute phi
 float
 ITL_histogram::getAngle2(float x, float y)
 {
-
-	if((x==0)&&(y==0))
-		return 0;
-	else
-	{
-		return fabs(pi/2.0-(atan2(y,x)));
-	}
+	return ITL_histogramtable::getAngle2( x, y );
 }
 
 // Compute x, y, z
 VECTOR3
 ITL_histogram::getXYZ( float theta, float phi )
 {
-	//VECTOR3 v( 1.0f*sin(theta)*cos(phi), 1.0f*sin(theta)*sin(phi), 1.0f*cos(theta) );
-	VECTOR3 v( 1.0f*sin(phi)*cos(theta), 1.0f*sin(theta)*sin(phi), 1.0f*cos(phi) );
-	return v;
+	return ITL_histogramtable::getXYZ( theta, phi );
 }
 
 int
@@ -281,25 +128,68 @@ ITL_histogram::get_bin_number_3D( SCALAR v, int nBins )
 int
 ITL_histogram::get_bin_number_3D( VECTOR3 v, int iRes )
 {
-	// convert the vector from Cartesian coodinates to sphercial coordinates;
-	// the magnitude is ignored.
-	float mytheta=getAngle(v.x(), v.y());//0~2pi
-	float myphi=  getAngle2(sqrt(v.x()*v.x()+v.y()*v.y()), v.z());//0~pi
+	return table->get_bin_number_3D( v, iRes );
+}
 
-	if( !theta[iRes] || !phi[iRes] )
+void
+ITL_histogram::setVectorBinningMode( int mode, int nFaceRes )
+{
+	vectorBinningMode = mode;
+	if( mode != VECTOR_BINNING_CUBEMAP )
+		return;
+
+	for( int iR=0; iR<table->getNumResolutions(); iR++ )
 	{
-		printf("read in the regions first\n");
-		return -1;
+		iCubeMapResolution[iR] = ( nFaceRes > 0 ) ? nFaceRes : max( 16, table->getNumBins( iR )/2 );
+		piCubeMap[iR] = table->getCubeMap( iR, iCubeMapResolution[iR] );
 	}
+}
+
+template <class B>
+void
+ITL_histogram::mapVectorsToBinsCore( const float* x, const float* y, const float* z, size_t stride,
+									 size_t n, B* out, int iRes )
+{
+	if( vectorBinningMode == VECTOR_BINNING_CUBEMAP )
+		table->mapVectorsToBinsCubeMap( x, y, z, stride, n, out, piCubeMap[iRes], iCubeMapResolution[iRes] );
+	else
+		table->mapVectorsToBins( x, y, z, stride, n, out, iRes );
+}
 
-	if( bIsAngleMapInitialized[iRes] == false )
-		ITL_compute_table( iRes );
+void
+ITL_histogram::mapVectorsToBins( const float* xyz, size_t n, int* out, int iRes )
+{
+	mapVectorsToBinsCore( xyz, xyz+1, xyz+2, 3, n, out, iRes );
+}
 
-	// map the angle to the bin number
-	int iTheta	=	min( iNrOfThetas[iRes] - 1,	int( fNrOfThetas[iRes] * mytheta / (M_PI * 2.0)));
-	int iPhi	=	min( iNrOfPhis[iRes] - 1, int( fNrOfPhis[iRes] * myphi	/ M_PI));
+void
+ITL_histogram::mapVectorsToBins( const float* xyz, size_t n, uint16_t* out, int iRes )
+{
+	mapVectorsToBinsCore( xyz, xyz+1, xyz+2, 3, n, out, iRes );
+}
 
-	return piAngleMap[iRes][ iTheta * iNrOfPhis[iRes] + iPhi];
+void
+ITL_histogram::mapVectorsToBins( const float* xyz, size_t n, uint8_t* out, int iRes )
+{
+	mapVectorsToBinsCore( xyz, xyz+1, xyz+2, 3, n, out, iRes );
+}
+
+void
+ITL_histogram::mapVectorsToBins( const float* x, const float* y, const float* z, size_t n, int* out, int iRes )
+{
+	mapVectorsToBinsCore( x, y, z, 1, n, out, iRes );
+}
+
+void
+ITL_histogram::mapVectorsToBins( const float* x, const float* y, const float* z, size_t n, uint16_t* out, int iRes )
+{
+	mapVectorsToBinsCore( x, y, z, 1, n, out, iRes );
+}
+
+void
+ITL_histogram::mapVectorsToBins( const float* x, const float* y, const float* z, size_t n, uint8_t* out, int iRes )
+{
+	mapVectorsToBinsCore( x, y, z, 1, n, out, iRes );
 }
 
 // convert the 2D vector from Cartesian coodinates to the patch index via the specified lookup table
@@ -325,7 +215,7 @@ ITL_histogram::get_bin_number_2D( VECTOR3 v, int nbin )
 VECTOR3
 ITL_histogram::getBinCenter( int binId, int iRes )
 {
-	return binCenter[iRes][binId];
+	return table->getBinCenter( binId, iRes );
 }
 
 /**
@@ -0,0 +1,798 @@
+/**
+ * @file ITL_histogramtable.cpp
+ * Source file for ITL_histogramtable.
+ * Created on: Oct 17, 2026
+ */
+#include "ITL_histogramtable.h"
+#include "ITL_util.h"
+
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The built-in patches (360 bins)
+static const char szPatch[] = {
+#include "ITL_patch.h"
+};
+
+ITL_histogramtable::ITL_histogramtable( const char* patchFileName, int nbin, const char* cacheFileName )
+	: refCount( 1 )
+{
+	nResolution = 1;
+	nBin[0] = nbin;
+	initialize( &patchFileName, cacheFileName );
+}
+
+ITL_histogramtable::ITL_histogramtable( const char** patchfilename, int *nbin, int nresolution, const char* cacheFileName )
+	: refCount( 1 )
+{
+	assert( nresolution <= MAX_NR_OF_RESOLUTIONS );
+	nResolution = nresolution;
+	for( int iR=0; iR<nResolution; iR++ )
+		nBin[iR] = nbin[iR];
+	initialize( patchfilename, cacheFileName );
+}
+
+ITL_histogramtable::ITL_histogramtable( int nbin, int nthetas, int nphis, int* angleMap )
+	: refCount( 1 )
+{
+	pcCache = NULL;
+	cacheSize = 0;
+	for( int iR=0; iR<MAX_NR_OF_RESOLUTIONS; iR++ )
+	{
+		piBucketOffset[iR] = NULL;
+		piBucketPatch[iR] = NULL;
+	}
+
+	nResolution = 1;
+	nBin[0] = nbin;
+	iNrOfThetas[0] = nthetas;
+	iNrOfPhis[0] = nphis;
+	fNrOfThetas[0] = float(nthetas);
+	fNrOfPhis[0] = float(nphis);
+	piAngleMap[0] = angleMap;
+	uiPatchHash[0] = 0;
+
+	// No patch bounds
+	theta[0] = NULL;
+	phi[0] = NULL;
+	thetaCenter[0] = NULL;
+	phiCenter[0] = NULL;
+	binCenter[0] = NULL;
+}
+
+void
+ITL_histogramtable::initialize( const char** patchfilename, const char* cacheFileName )
+{
+	pcCache = NULL;
+	cacheSize = 0;
+	for( int iR=0; iR<MAX_NR_OF_RESOLUTIONS; iR++ )
+	{
+		piBucketOffset[iR] = NULL;
+		piBucketPatch[iR] = NULL;
+	}
+
+	for( int iR=0; iR<nResolution; iR++ )
+	{
+		iNrOfThetas[iR] = nBin[iR]*2;
+		iNrOfPhis[iR] = nBin[iR];
+		fNrOfThetas[iR] = float(iNrOfThetas[iR]);
+		fNrOfPhis[iR] = float(iNrOfPhis[iR]);
+		uiPatchHash[iR] = hashPatchSource( patchfilename[iR] );
+	}
+
+	// Map the precomputed tables if a matching cache exists
+	if( cacheFileName != NULL && loadAngleMapCache( cacheFileName ) )
+		return;
+
+	for( int iR=0; iR<nResolution; iR++ )
+	{
+		piAngleMap[iR] = new int[iNrOfThetas[iR]*iNrOfPhis[iR]];
+		theta[iR] = new float[2*nBin[iR]];
+		phi[iR] = new float[2*nBin[iR]];
+		thetaCenter[iR] = new float[nBin[iR]];
+		phiCenter[iR] = new float[nBin[iR]];
+		binCenter[iR] = new VECTOR3[nBin[iR]];
+
+		if( patchfilename[iR][0] == '!' )
+		{
+			// The patch provided in the header is only for
+			// one resolution with 360 bins
+			assert( iR == 0 );
+			readPatches_header();
+		}
+		else
+			readPatches_region( patchfilename[iR], iR );
+
+		// Compute the histogram look up table of this resolution - once for all
+		computeTable( iR );
+	}
+
+	// Save the tables for the next run
+	if( cacheFileName != NULL )
+		writeAngleMapCache( cacheFileName );
+
+}// end function
+
+ITL_histogramtable::~ITL_histogramtable()
+{
+	for( int iR=0; iR<nResolution; iR++ )
+	{
+		delete [] piBucketOffset[iR];
+		delete [] piBucketPatch[iR];
+
+		// Tables living in the cache are released with it
+		if( pcCache == NULL )
+		{
+			delete [] piAngleMap[iR];
+			delete [] theta[iR];
+			delete [] phi[iR];
+			delete [] thetaCenter[iR];
+			delete [] phiCenter[iR];
+			delete [] binCenter[iR];
+		}
+	}
+
+	if( pcCache != NULL )
+		releaseAngleMapCache( pcCache, cacheSize );
+
+	for( std::map< std::pair<int, int>, int* >::iterator it = cubeMaps.begin(); it != cubeMaps.end(); it++ )
+		delete [] it->second;
+}
+
+void
+ITL_histogramtable::acquire() const
+{
+	refCount ++;
+}
+
+void
+ITL_histogramtable::release() const
+{
+	if( --refCount == 0 )
+		delete this;
+}
+
+// Read the lookup table provided in the header file
+void
+ITL_histogramtable::readPatches_header()
+{
+	// Walk the lines without modifying the buffer, so that it can be parsed again
+	const char *szToken = szPatch;
+	float f2Temp[2];
+
+	for(int i=0;i<nBin[0]; i++)
+	{
+		float fAngle_radian;
+		sscanf( szToken,"%f, %f", &f2Temp[0],&f2Temp[1] );
+		theta[0][i*2+0] = f2Temp[0];
+		theta[0][i*2+1] = f2Temp[1];
+		szToken = strchr(szToken, '\n') + 1;
+		//printf( "%f %f\n", f2Temp[0], f2Temp[1] );
+
+		sscanf(szToken,"%f, %f", &f2Temp[0],&f2Temp[1] );
+		phi[0][i*2+0] = f2Temp[0];
+		phi[0][i*2+1] = f2Temp[1];
+		szToken = strchr(szToken, '\n') + 1;
+		//printf( "%f %f\n", f2Temp[0], f2Temp[1] );
+
+		thetaCenter[0][i] = ( theta[0][i*2+0] + theta[0][i*2+1] ) / 2.0f;
+		phiCenter[0][i] = ( phi[0][i*2+0] + phi[0][i*2+1] ) / 2.0f;
+		binCenter[0][i] = getXYZ( thetaCenter[0][i], phiCenter[0][i] );
+		//binCenter[0][i].Normalize();
+
+	}// end for
+}
+
+// read the lookup table that map the thetas and phis to the patch index;
+// the lookup table is stored in the file 'patch.txt,' which contains 360 patches.
+void
+ITL_histogramtable::readPatches_region( const char* patchFileName, int iRes )
+{
+	//if( true == ITL_histogramtable::bIsPatchRead )
+	//	return;
+
+	float x[2],y[2];
+	cout << "Reading patch file" << patchFileName << endl;
+	FILE* fp = fopen( patchFileName, "r" );
+	if( fp == NULL )
+		printf( "file open error\n" );
+
+	for(int i=0;i<nBin[iRes]; i++)
+	{
+		fscanf(fp,"%f, %f", &x[0],&y[0]);
+		fscanf(fp,"%f, %f", &x[1],&y[1]);
+
+		theta[iRes][i*2+0]=x[0];
+		theta[iRes][i*2+1]=y[0];
+		phi[iRes][i*2+0]=x[1];
+		phi[iRes][i*2+1]=y[1];
+
+		thetaCenter[iRes][i] = ( theta[iRes][i*2+0] + theta[iRes][i*2+1] ) / 2.0f;
+		phiCenter[iRes][i] = ( phi[iRes][i*2+0] + phi[iRes][i*2+1] ) / 2.0f;
+		binCenter[iRes][i] = getXYZ( thetaCenter[iRes][i], phiCenter[iRes][i] );
+		//binCenter[iRes][i].Normalize();
+
+	}
+	fclose(fp);
+	cout << "Reading patch file done" << endl;
+	//ITL_histogramtable::bIsPatchRead = true;
+}
+
+void
+ITL_histogramtable::computeTable( int iRes )
+{
+	// Index the patches so that each lookup only tests a few of them
+	buildPatchIndex( iRes );
+
+	// Rows of the table are independent
+	#pragma omp parallel for schedule(static)
+	for( int t = 0; t < iNrOfThetas[iRes]; t++ )
+		for( int p = 0; p < iNrOfPhis[iRes]; p++ )
+		{
+			float fTheta =	M_PI * 2.0f * float(t) / fNrOfThetas[iRes];
+			float fPhi =	M_PI * float(p) / fNrOfPhis[iRes];
+			int iBin = get_bin_by_angle(fTheta, fPhi, nBin[iRes], iRes );
+			piAngleMap[iRes][t*iNrOfPhis[iRes] + p] = ( iBin >= 0 ) ? iBin : 0;
+		}
+
+}// end function
+
+// Layout of the angle map cache:
+//   char[8]	magic "ITLAMAP"
+//   int		version
+//   int		number of resolutions
+//   int[4]		nBin, #thetas, #phis and patch hash of each resolution
+// followed by, for each resolution,
+//   float[2*nBin] theta, float[2*nBin] phi, float[nBin] thetaCenter,
+//   float[nBin] phiCenter, float[3*nBin] binCenter, int[#thetas*#phis] angle map
+static const char szAngleMapCacheMagic[8] = { 'I', 'T', 'L', 'A', 'M', 'A', 'P', '\0' };
+
+static size_t
+getAngleMapCacheSize( int nbin, int nthetas, int nphis )
+{
+	return 9 * (size_t)nbin * sizeof(float) + (size_t)nthetas * nphis * sizeof(int);
+}
+
+// FNV-1a hash of the patch source: the built-in patches for '!', else the
+// contents of the patch file (0 if it cannot be read)
+unsigned int
+ITL_histogramtable::hashPatchSource( const char* patchFileName )
+{
+	const unsigned int uiPrime = 16777619u;
+	unsigned int uiHash = 2166136261u;
+
+	if( patchFileName[0] == '!' )
+	{
+		for( size_t i=0; i<sizeof(szPatch); i++ )
+			uiHash = ( uiHash ^ (unsigned char)szPatch[i] ) * uiPrime;
+		return uiHash;
+	}
+
+	FILE* fp = fopen( patchFileName, "rb" );
+	if( fp == NULL )
+		return 0;
+	unsigned char pucBuffer[4096];
+	size_t nRead;
+	while( ( nRead = fread( pucBuffer, 1, sizeof(pucBuffer), fp ) ) > 0 )
+		for( size_t i=0; i<nRead; i++ )
+			uiHash = ( uiHash ^ pucBuffer[i] ) * uiPrime;
+	fclose( fp );
+	return uiHash;
+}
+
+void
+ITL_histogramtable::releaseAngleMapCache( char* pcData, size_t nBytes )
+{
+#if defined( _WIN32 ) || defined( _WIN64 )
+	delete [] pcData;
+#else
+	munmap( pcData, nBytes );
+#endif
+}
+
+bool
+ITL_histogramtable::loadAngleMapCache( const char* cacheFileName )
+{
+	char* pcData = NULL;
+	size_t nBytes = 0;
+
+#if defined( _WIN32 ) || defined( _WIN64 )
+	FILE* fp = fopen( cacheFileName, "rb" );
+	if( fp == NULL )
+		return false;
+	fseek( fp, 0, SEEK_END );
+	long fileSize = ftell( fp );
+	rewind( fp );
+	if( fileSize <= 0 )
+	{
+		fclose( fp );
+		return false;
+	}
+	nBytes = (size_t)fileSize;
+	pcData = new char[nBytes];
+	if( fread( pcData, 1, nBytes, fp ) != nBytes )
+	{
+		fclose( fp );
+		delete [] pcData;
+		return false;
+	}
+	fclose( fp );
+#else
+	// Map the file read-only and shared, so all processes on a node use the same pages
+	int fd = open( cacheFileName, O_RDONLY );
+	if( fd < 0 )
+		return false;
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || st.st_size <= 0 )
+	{
+		close( fd );
+		return false;
+	}
+	nBytes = (size_t)st.st_size;
+	void* pMap = mmap( NULL, nBytes, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( pMap == MAP_FAILED )
+		return false;
+	pcData = (char*)pMap;
+#endif
+
+	// Validate the header against the requested resolutions
+	size_t headerSize = sizeof(szAngleMapCacheMagic) + ( 2 + 4*nResolution ) * sizeof(int);
+	bool bIsValid = nBytes >= headerSize &&
+					memcmp( pcData, szAngleMapCacheMagic, sizeof(szAngleMapCacheMagic) ) == 0;
+	const int* piHeader = (const int*)( pcData + sizeof(szAngleMapCacheMagic) );
+	bIsValid = bIsValid && piHeader[0] == ANGLE_MAP_CACHE_VERSION && piHeader[1] == nResolution;
+
+	size_t expectedSize = headerSize;
+	for( int iR=0; bIsValid && iR<nResolution; iR++ )
+	{
+		bIsValid = piHeader[2+iR*4+0] == nBin[iR] &&
+				   piHeader[2+iR*4+1] == iNrOfThetas[iR] &&
+				   piHeader[2+iR*4+2] == iNrOfPhis[iR] &&
+				   (unsigned int)piHeader[2+iR*4+3] == uiPatchHash[iR];
+		expectedSize += getAngleMapCacheSize( nBin[iR], iNrOfThetas[iR], iNrOfPhis[iR] );
+	}
+	bIsValid = bIsValid && expectedSize == nBytes;
+
+	if( !bIsValid )
+	{
+		printf( "Ignoring incompatible angle map cache %s\n", cacheFileName );
+		releaseAngleMapCache( pcData, nBytes );
+		return false;
+	}
+
+	// Point the tables into the cache; they must not be modified from now on
+	char* pcCur = pcData + headerSize;
+	for( int iR=0; iR<nResolution; iR++ )
+	{
+		theta[iR] = (float*)pcCur;			pcCur += 2 * nBin[iR] * sizeof(float);
+		phi[iR] = (float*)pcCur;			pcCur += 2 * nBin[iR] * sizeof(float);
+		thetaCenter[iR] = (float*)pcCur;	pcCur += nBin[iR] * sizeof(float);
+		phiCenter[iR] = (float*)pcCur;		pcCur += nBin[iR] * sizeof(float);
+		binCenter[iR] = (VECTOR3*)pcCur;	pcCur += 3 * nBin[iR] * sizeof(float);
+		piAngleMap[iR] = (int*)pcCur;		pcCur += (size_t)iNrOfThetas[iR] * iNrOfPhis[iR] * sizeof(int);
+	}
+
+	pcCache = pcData;
+	cacheSize = nBytes;
+	return true;
+
+}// end function
+
+bool
+ITL_histogramtable::writeAngleMapCache( const char* cacheFileName ) const
+{
+	assert( sizeof(VECTOR3) == 3*sizeof(float) );
+
+	// Tables built from an angle map alone have nothing else to store
+	if( theta[0] == NULL )
+		return false;
+
+	// Write to a private file and rename it afterwards, so that
+	// processes starting concurrently never map a partial cache
+	char szTmpFileName[1024];
+#if defined( _WIN32 ) || defined( _WIN64 )
+	sprintf( szTmpFileName, "%s", cacheFileName );
+#else
+	snprintf( szTmpFileName, sizeof(szTmpFileName), "%s.%d.tmp", cacheFileName, (int)getpid() );
+#endif
+
+	FILE* fp = fopen( szTmpFileName, "wb" );
+	if( fp == NULL )
+	{
+		printf( "Cannot write angle map cache %s\n", szTmpFileName );
+		return false;
+	}
+
+	int piHeader[2] = { ANGLE_MAP_CACHE_VERSION, nResolution };
+	bool bIsOk = fwrite( szAngleMapCacheMagic, 1, sizeof(szAngleMapCacheMagic), fp ) == sizeof(szAngleMapCacheMagic);
+	bIsOk = bIsOk && fwrite( piHeader, sizeof(int), 2, fp ) == 2;
+	for( int iR=0; bIsOk && iR<nResolution; iR++ )
+	{
+		int piMeta[4] = { nBin[iR], iNrOfThetas[iR], iNrOfPhis[iR], (int)uiPatchHash[iR] };
+		bIsOk = fwrite( piMeta, sizeof(int), 4, fp ) == 4;
+	}
+	for( int iR=0; bIsOk && iR<nResolution; iR++ )
+	{
+		size_t nMap = (size_t)iNrOfThetas[iR] * iNrOfPhis[iR];
+		bIsOk = fwrite( theta[iR], sizeof(float), 2*nBin[iR], fp ) == (size_t)2*nBin[iR] &&
+				fwrite( phi[iR], sizeof(float), 2*nBin[iR], fp ) == (size_t)2*nBin[iR] &&
+				fwrite( thetaCenter[iR], sizeof(float), nBin[iR], fp ) == (size_t)nBin[iR] &&
+				fwrite( phiCenter[iR], sizeof(float), nBin[iR], fp ) == (size_t)nBin[iR] &&
+				fwrite( binCenter[iR], sizeof(float), 3*nBin[iR], fp ) == (size_t)3*nBin[iR] &&
+				fwrite( piAngleMap[iR], sizeof(int), nMap, fp ) == nMap;
+	}
+	bIsOk = ( fclose( fp ) == 0 ) && bIsOk;
+
+	if( !bIsOk )
+	{
+		printf( "Cannot write angle map cache %s\n", szTmpFileName );
+		remove( szTmpFileName );
+		return false;
+	}
+
+#if !defined( _WIN32 ) && !defined( _WIN64 )
+	if( rename( szTmpFileName, cacheFileName ) != 0 )
+	{
+		remove( szTmpFileName );
+		return false;
+	}
+#endif
+	return true;
+
+}// end function
+
+// convert the angles in the spherical coordinates (mytheta, myphi) to the patch index
+// according to the lookup table composed of theta and phi.
+// The #entries in the lookup table is specified by the parameter 'binnum'.
+int
+ITL_histogramtable::get_bin_by_angle( float mytheta, float myphi, int binnum, int iRes ) const
+{
+	// Use the patch index when it covers the requested patches.
+	// The four wrap-around passes are tried in the same order as the scan below.
+	if( piBucketOffset[iRes] != NULL && binnum == nBin[iRes] )
+	{
+		int iBin = lookupPatchIndex( mytheta, myphi, iRes );
+		if( iBin < 0 )
+			iBin = lookupPatchIndex( mytheta+2*pi, myphi, iRes );
+		if( iBin < 0 )
+			iBin = lookupPatchIndex( mytheta, myphi+2*pi, iRes );
+		if( iBin < 0 )
+			iBin = lookupPatchIndex( mytheta+2*pi, myphi+2*pi, iRes );
+		return iBin;
+	}
+
+	for(int i=0; i<binnum;i++)
+	{
+		if( (mytheta>=theta[iRes][i*2+0]) && (mytheta<=theta[iRes][i*2+1])&&
+			(myphi>=phi[iRes][i*2+0]) && (myphi<=phi[iRes][i*2+1])
+			)
+		{
+			return i;
+		}
+	}
+	for(int i=0; i<binnum;i++)
+	{
+		if( ((mytheta+2*pi)>=theta[iRes][i*2+0]) && ((mytheta+2*pi)<=theta[iRes][i*2+1])&&
+			(myphi>=phi[iRes][i*2+0]) && (myphi<=phi[iRes][i*2+1])
+			)
+		{
+			return i;
+		}
+	}
+	for(int i=0; i<binnum;i++)
+	{
+		if( ((mytheta)>=theta[iRes][i*2+0]) && ((mytheta)<=theta[iRes][i*2+1])&&
+			((myphi+2*pi)>=phi[iRes][i*2+0]) && ((myphi+2*pi)<=phi[iRes][i*2+1])
+			)
+		{
+			return i;
+		}
+	}
+	for(int i=0; i<binnum;i++)
+	{
+		if( ((mytheta+2*pi)>=theta[iRes][i*2+0]) && ((mytheta+2*pi)<=theta[iRes][i*2+1])&&
+			((myphi+2*pi)>=phi[iRes][i*2+0]) && ((myphi+2*pi)<=phi[iRes][i*2+1])
+			)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+// ADD-BY-LEETEN 02/02/2010-END
+
+// map a coordinate to its bucket along one axis of the patch index
+static inline int
+getPatchBucket( double v, double vMin, double width, int nBucket )
+{
+	double b = floor( ( v - vMin ) / width );
+	if( !( b >= 0.0 ) )		// also catches NaN
+		return 0;
+	return ( b >= nBucket ) ? nBucket-1 : (int)b;
+}
+
+// bucket the (theta, phi) rectangles of the patches; every bucket keeps the
+// ids of the patches overlapping it in ascending order, so that the first hit
+// in a bucket is also the first hit of a linear scan over all patches
+void
+ITL_histogramtable::buildPatchIndex( int iRes )
+{
+	int nPatch = nBin[iRes];
+	float* pfTheta = theta[iRes];
+	float* pfPhi = phi[iRes];
+
+	// Domain covered by the patches (may exceed [0, 2pi] due to wrap-around)
+	double tMin = pfTheta[0], tMax = pfTheta[1];
+	double pMin = pfPhi[0], pMax = pfPhi[1];
+	for( int i=0; i<nPatch; i++ )
+	{
+		tMin = min( tMin, (double)pfTheta[i*2+0] );
+		tMax = max( tMax, (double)pfTheta[i*2+1] );
+		pMin = min( pMin, (double)pfPhi[i*2+0] );
+		pMax = max( pMax, (double)pfPhi[i*2+1] );
+	}
+
+	// About one patch per bucket; theta spans twice the range of phi
+	int nSide = max( 1, (int)ceil( sqrt( (double)nPatch ) ) );
+	int nT = 2*nSide;
+	int nP = nSide;
+	iNrOfBucketThetas[iRes] = nT;
+	iNrOfBucketPhis[iRes] = nP;
+	dBucketThetaMin[iRes] = tMin;
+	dBucketPhiMin[iRes] = pMin;
+	dBucketThetaWidth[iRes] = ( tMax > tMin ) ? ( tMax - tMin ) / nT : 1.0;
+	dBucketPhiWidth[iRes] = ( pMax > pMin ) ? ( pMax - pMin ) / nP : 1.0;
+
+	int nBucket = nT*nP;
+	delete [] piBucketOffset[iRes];
+	delete [] piBucketPatch[iRes];
+	piBucketOffset[iRes] = new int[nBucket+1];
+	for( int b=0; b<=nBucket; b++ )
+		piBucketOffset[iRes][b] = 0;
+
+	// Count the patches of each bucket
+	for( int pass=0; pass<2; pass++ )
+	{
+		int* piCursor = ( pass == 0 ) ? NULL : new int[nBucket];
+		if( pass == 1 )
+		{
+			for( int b=0; b<nBucket; b++ )
+				piCursor[b] = piBucketOffset[iRes][b];
+		}
+
+		for( int i=0; i<nPatch; i++ )
+		{
+			int t0 = getPatchBucket( pfTheta[i*2+0], tMin, dBucketThetaWidth[iRes], nT );
+			int t1 = getPatchBucket( pfTheta[i*2+1], tMin, dBucketThetaWidth[iRes], nT );
+			int p0 = getPatchBucket( pfPhi[i*2+0], pMin, dBucketPhiWidth[iRes], nP );
+			int p1 = getPatchBucket( pfPhi[i*2+1], pMin, dBucketPhiWidth[iRes], nP );
+
+			for( int bt=t0; bt<=t1; bt++ )
+				for( int bp=p0; bp<=p1; bp++ )
+				{
+					if( pass == 0 )
+						piBucketOffset[iRes][bt*nP+bp+1] ++;
+					else
+						piBucketPatch[iRes][piCursor[bt*nP+bp]++] = i;
+				}
+		}
+
+		if( pass == 0 )
+		{
+			// Prefix sum to get the offsets
+			for( int b=0; b<nBucket; b++ )
+				piBucketOffset[iRes][b+1] += piBucketOffset[iRes][b];
+			piBucketPatch[iRes] = new int[max( 1, piBucketOffset[iRes][nBucket] )];
+		}
+		else
+			delete [] piCursor;
+	}
+
+}// end function
+
+int
+ITL_histogramtable::lookupPatchIndex( double mytheta, double myphi, int iRes ) const
+{
+	int nT = iNrOfBucketThetas[iRes];
+	int nP = iNrOfBucketPhis[iRes];
+
+	// Angles outside the domain land in a border bucket and fail the test below
+	int b = getPatchBucket( mytheta, dBucketThetaMin[iRes], dBucketThetaWidth[iRes], nT ) * nP +
+			getPatchBucket( myphi, dBucketPhiMin[iRes], dBucketPhiWidth[iRes], nP );
+
+	for( int k=piBucketOffset[iRes][b]; k<piBucketOffset[iRes][b+1]; k++ )
+	{
+		int i = piBucketPatch[iRes][k];
+		if( (mytheta>=theta[iRes][i*2+0]) && (mytheta<=theta[iRes][i*2+1])&&
+			(myphi>=phi[iRes][i*2+0]) && (myphi<=phi[iRes][i*2+1])
+			)
+			return i;
+	}
+	return -1;
+
+}// end function
+
+// compute the theta
+float
+ITL_histogramtable::getAngle(float x, float y)
+{
+
+	if((x==0)&&(y==0))
+		return 0;
+	else
+	{
+		return (pi+(atan2(y,x)));
+	}
+}
+
+// compute phi
+float
+ITL_histogramtable::getAngle2(float x, float y)
+{
+
+	if((x==0)&&(y==0))
+		return 0;
+	else
+	{
+		return fabs(pi/2.0-(atan2(y,x)));
+	}
+}
+
+// Compute x, y, z
+VECTOR3
+ITL_histogramtable::getXYZ( float theta, float phi )
+{
+	//VECTOR3 v( 1.0f*sin(theta)*cos(phi), 1.0f*sin(theta)*sin(phi), 1.0f*cos(theta) );
+	VECTOR3 v( 1.0f*sin(phi)*cos(theta), 1.0f*sin(theta)*sin(phi), 1.0f*cos(phi) );
+	return v;
+}
+
+// convert the vector from Cartesian coodinates to the patch index via the specified lookup table
+int
+ITL_histogramtable::get_bin_number_3D( VECTOR3 v, int iRes ) const
+{
+	// convert the vector from Cartesian coodinates to sphercial coordinates;
+	// the magnitude is ignored.
+	float mytheta=getAngle(v.x(), v.y());//0~2pi
+	float myphi=  getAngle2(sqrt(v.x()*v.x()+v.y()*v.y()), v.z());//0~pi
+
+	// map the angle to the bin number
+	int iTheta	=	min( iNrOfThetas[iRes] - 1,	int( fNrOfThetas[iRes] * mytheta / (M_PI * 2.0)));
+	int iPhi	=	min( iNrOfPhis[iRes] - 1, int( fNrOfPhis[iRes] * myphi	/ M_PI));
+
+	return piAngleMap[iRes][ iTheta * iNrOfPhis[iRes] + iPhi];
+}
+
+// atan(a) for a in [0, 1]; Abramowitz & Stegun 4.4.49, |error| <= 2e-8
+static inline float
+atanUnit( float a )
+{
+	float s = a*a;
+	return a * ( 1.0f + s * ( -0.3333314528f + s * ( 0.1999355085f + s * ( -0.1420889944f +
+			s * ( 0.1065626393f + s * ( -0.0752896400f + s * ( 0.0429096138f +
+			s * ( -0.0161657367f + s * 0.0028662257f ) ) ) ) ) ) ) );
+}
+
+// atan2(y, x) without calls, so that loops around it vectorize
+static inline float
+atan2Fast( float y, float x )
+{
+	const float fHalfPi = 1.57079632679489661923f;
+	const float fPi = 3.14159265358979323846f;
+	float ax = fabsf( x );
+	float ay = fabsf( y );
+	float mx = ( ax > ay ) ? ax : ay;
+	float mn = ( ax > ay ) ? ay : ax;
+	float r = atanUnit( mn / ( ( mx > 0.0f ) ? mx : 1.0f ) );
+	r = ( ay > ax ) ? fHalfPi - r : r;
+	r = ( x < 0.0f ) ? fPi - r : r;
+	return copysignf( r, y );
+}
+
+// label each cube-map cell with the patch containing its center direction
+const int*
+ITL_histogramtable::getCubeMap( int iRes, int nFaceRes ) const
+{
+	std::lock_guard<std::mutex> lock( cubeMapMutex );
+
+	int*& piCubeMap = cubeMaps[std::make_pair( iRes, nFaceRes )];
+	if( piCubeMap != NULL )
+		return piCubeMap;
+
+	int nCell = ITL_cubemap::getNumCells( nFaceRes );
+	int* piMap = new int[nCell];
+
+	#pragma omp parallel for schedule(static)
+	for( int c=0; c<nCell-1; c++ )
+	{
+		float dir[3];
+		ITL_cubemap::getCellDirection( c, nFaceRes, dir );
+		piMap[c] = get_bin_number_3D( VECTOR3( dir[0], dir[1], dir[2] ), iRes );
+	}
+
+	// Zero-length and invalid vectors go to bin 0
+	piMap[nCell-1] = 0;
+
+	piCubeMap = piMap;
+	return piCubeMap;
+
+}// end function
+
+template <class B>
+void
+ITL_histogramtable::mapVectorsToBinsCubeMap( const float* x, const float* y, const float* z, size_t stride,
+											 size_t n, B* out, const int* cubeMap, int nFaceRes ) const
+{
+	const int* piMap = cubeMap;
+	long nPoint = (long)n;
+
+	#pragma omp parallel for schedule(static) if( nPoint > 65536 )
+	for( long i = 0; i < nPoint; i++ )
+	{
+		size_t k = (size_t)i * stride;
+		out[i] = (B)piMap[ITL_cubemap::getCell( x[k], y[k], z[k], nFaceRes )];
+	}
+
+}// end function
+
+template <class B>
+void
+ITL_histogramtable::mapVectorsToBins( const float* x, const float* y, const float* z, size_t stride,
+									  size_t n, B* out, int iRes ) const
+{
+	const int BLOCK_SIZE = 1024;
+	const float fPi = 3.14159265358979323846f;
+	const float fHalfPi = 1.57079632679489661923f;
+	const float fThetaScale = fNrOfThetas[iRes] / ( 2.0f * fPi );
+	const float fPhiScale = fNrOfPhis[iRes] / fPi;
+	const int nT = iNrOfThetas[iRes];
+	const int nP = iNrOfPhis[iRes];
+	const int* piMap = piAngleMap[iRes];
+	long nBlock = (long)( ( n + BLOCK_SIZE - 1 ) / BLOCK_SIZE );
+
+	#pragma omp parallel for schedule(static) if( nBlock > 1 )
+	for( long b = 0; b < nBlock; b++ )
+	{
+		int piCell[BLOCK_SIZE];
+		size_t start = (size_t)b * BLOCK_SIZE;
+		int nInBlock = (int)min( (size_t)BLOCK_SIZE, n - start );
+
+		// Same angle conventions as getAngle and getAngle2, in a branch-free form
+		for( int i = 0; i < nInBlock; i++ )
+		{
+			size_t k = ( start + i ) * stride;
+			float vx = x[k];
+			float vy = y[k];
+			float vz = z[k];
+			float r = sqrtf( vx*vx + vy*vy );
+
+			float fTheta = fPi + atan2Fast( vy, vx );
+			fTheta = ( vx == 0.0f && vy == 0.0f ) ? 0.0f : fTheta;
+			float fPhi = fabsf( fHalfPi - atan2Fast( vz, r ) );
+			fPhi = ( r == 0.0f && vz == 0.0f ) ? 0.0f : fPhi;
+
+			int iTheta = (int)( fThetaScale * fTheta );
+			int iPhi = (int)( fPhiScale * fPhi );
+			iTheta = ( iTheta < nT - 1 ) ? iTheta : nT - 1;
+			iPhi = ( iPhi < nP - 1 ) ? iPhi : nP - 1;
+			piCell[i] = iTheta * nP + iPhi;
+		}
+
+		for( int i = 0; i < nInBlock; i++ )
+			out[start + i] = (B)piMap[piCell[i]];
+	}
+
+}// end function
+
+// Bin types used by the library
+template void ITL_histogramtable::mapVectorsToBins<int>( const float*, const float*, const float*, size_t, size_t, int*, int ) const;
+template void ITL_histogramtable::mapVectorsToBins<uint16_t>( const float*, const float*, const float*, size_t, size_t, uint16_t*, int ) const;
+template void ITL_histogramtable::mapVectorsToBins<uint8_t>( const float*, const float*, const float*, size_t, size_t, uint8_t*, int ) const;
+template void ITL_histogramtable::mapVectorsToBinsCubeMap<int>( const float*, const float*, const float*, size_t, size_t, int*, const int*, int ) const;
+template void ITL_histogramtable::mapVectorsToBinsCubeMap<uint16_t>( const float*, const float*, const float*, size_t, size_t, uint16_t*, const int*, int ) const;
+template void ITL_histogramtable::mapVectorsToBinsCubeMap<uint8_t>( const float*, const float*, const float*, size_t, size_t, uint8_t*, const int*, int ) const;
@@ -0,0 +1,191 @@
+/**
+ * @file ITL_kde.cpp
+ * Source file for ITL_kde.
+ * Created on: Oct 17, 2026
+ */
+#include "ITL_kde.h"
+
+void
+ITL_kde::computeDensity( const float* data, int nPoint, double h,
+						 double low, double high, int nEvalPoint,
+						 double* densityArray )
+{
+	assert( nEvalPoint > 0 );
+	if( nPoint <= 0 || h <= 0 )
+	{
+		memset( densityArray, 0, sizeof(double)*nEvalPoint );
+		return;
+	}
+
+	// Degenerate range: every point sits at low
+	double range = high - low;
+	if( range <= 0 || nEvalPoint == 1 )
+	{
+		double d = 0;
+		for( int i=0; i<nPoint; i++ )
+		{
+			double u = ( low - data[i] ) / h;
+			d += exp( -0.5*u*u );
+		}
+		d /= ( sqrt( 2*pi ) * nPoint * h );
+		for( int i=0; i<nEvalPoint; i++ )
+			densityArray[i] = d;
+		return;
+	}
+
+	// Fine grid: at least the evaluation points, and fine enough for the bandwidth
+	double nStep = ceil( GRID_STEPS_PER_BANDWIDTH * range / h );
+	int nGrid = ( nStep + 1 < MAX_GRID_SIZE ) ? (int)nStep + 1 : (int)MAX_GRID_SIZE;
+	nGrid = max( nGrid, nEvalPoint );
+	double delta = range / ( nGrid - 1 );
+
+	vector<double> grid( nGrid, 0.0 );
+	linearBinning( data, nPoint, low, delta, nGrid, &grid[0] );
+	convolveGaussian( &grid[0], nGrid, delta, h, nPoint );
+
+	// Linear interpolation from the grid (exact when both grids coincide)
+	double evalStep = range / ( nEvalPoint - 1 );
+	for( int i=0; i<nEvalPoint; i++ )
+	{
+		double t = i * evalStep / delta;
+		int g = ITL_util<int>::clamp( (int)t, 0, nGrid-2 );
+		double w = t - g;
+		densityArray[i] = ( 1.0 - w ) * grid[g] + w * grid[g+1];
+	}
+
+}// End function
+
+float
+ITL_kde::computeEntropy( const float* data, int nPoint, double h,
+						 int nEvalPoint, bool toNormalize )
+{
+	if( nPoint <= 0 || nEvalPoint <= 1 )
+		return 0.0f;
+
+	float m = data[0], M = data[0];
+	for( int i=1; i<nPoint; i++ )
+	{
+		m = min( m, data[i] );
+		M = max( M, data[i] );
+	}
+	if( M <= m || h <= 0 )
+		return 0.0f;
+
+	vector<double> density( nEvalPoint );
+	computeDensity( data, nPoint, h, m, M, nEvalPoint, &density[0] );
+
+	double total = 0;
+	for( int i=0; i<nEvalPoint; i++ )
+		total += density[i];
+	if( total <= 0 )
+		return 0.0f;
+
+	// Compute negative entropy
+	double entropy = 0;
+	for( int i=0; i<nEvalPoint; i++ )
+	{
+		double p = density[i] / total;
+		entropy += ( p <= 0 ? 0 : p * ( log( p ) / log( 2.0 ) ) );
+	}
+
+	// Change sign
+	entropy = -entropy;
+
+	// Normalize, if required
+	if( toNormalize )
+		entropy /= ( log( (double)nEvalPoint ) / log( 2.0 ) );
+
+	return (float)entropy;
+
+}// End function
+
+void
+ITL_kde::linearBinning( const float* data, int nPoint, double low, double delta,
+						int nGrid, double* grid )
+{
+	// Each point is split between its two neighboring grid points
+	double maxT = nGrid - 1;
+	for( int i=0; i<nPoint; i++ )
+	{
+		double t = ( data[i] - low ) / delta;
+		t = ( t < 0 ) ? 0 : ( ( t > maxT ) ? maxT : t );
+		int g = min( (int)t, nGrid-2 );
+		double w = t - g;
+		grid[g] += 1.0 - w;
+		grid[g+1] += w;
+	}
+
+}// End function
+
+void
+ITL_kde::convolveGaussian( double* grid, int nGrid, double delta, double h, int nPoint )
+{
+	// Kernel support in grid steps
+	int L = (int)ceil( KERNEL_SUPPORT * h / delta );
+	L = min( L, nGrid-1 );
+
+	// Zero padding to avoid wrap-around
+	int P = 1;
+	while( P < nGrid + L )
+		P <<= 1;
+
+	vector< complex<double> > a( P, 0.0 );
+	vector< complex<double> > k( P, 0.0 );
+	for( int i=0; i<nGrid; i++ )
+		a[i] = grid[i];
+
+	double scale = 1.0 / ( sqrt( 2*pi ) * nPoint * h );
+	for( int l=0; l<=L; l++ )
+	{
+		double u = l * delta / h;
+		double v = scale * exp( -0.5*u*u );
+		k[l] = v;
+		if( l > 0 )
+			k[P-l] = v;
+	}
+
+	fft( &a[0], P, false );
+	fft( &k[0], P, false );
+	for( int i=0; i<P; i++ )
+		a[i] *= k[i];
+	fft( &a[0], P, true );
+
+	for( int i=0; i<nGrid; i++ )
+		grid[i] = max( a[i].real() / P, 0.0 );
+
+}// End function
+
+void
+ITL_kde::fft( complex<double>* a, int n, bool inverse )
+{
+	// Bit-reversal permutation
+	for( int i=1, j=0; i<n; i++ )
+	{
+		int bit = n >> 1;
+		for( ; j & bit; bit >>= 1 )
+			j ^= bit;
+		j ^= bit;
+		if( i < j )
+			swap( a[i], a[j] );
+	}
+
+	// Iterative radix-2 butterflies
+	for( int len=2; len<=n; len<<=1 )
+	{
+		double angle = 2*pi / len * ( inverse ? 1 : -1 );
+		complex<double> wlen( cos( angle ), sin( angle ) );
+		for( int i=0; i<n; i+=len )
+		{
+			complex<double> w( 1.0 );
+			for( int j=0; j<len/2; j++ )
+			{
+				complex<double> u = a[i+j];
+				complex<double> v = a[i+j+len/2] * w;
+				a[i+j] = u + v;
+				a[i+j+len/2] = u - v;
+				w *= wlen;
+			}
+		}
+	}
+
+}// End function
@@ -0,0 +1,204 @@
+/**
+ * @file ITL_sphericalhierarchy.cpp
+ * Source file for ITL_sphericalhierarchy.
+ * Created on: Oct 17, 2026
+ */
+#include "ITL_sphericalhierarchy.h"
+
+static void
+normalize3( double* v )
+{
+	double l = sqrt( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+	v[0] /= l;	v[1] /= l;	v[2] /= l;
+}
+
+static void
+cross3( const double* a, const double* b, double* c )
+{
+	c[0] = a[1]*b[2] - a[2]*b[1];
+	c[1] = a[2]*b[0] - a[0]*b[2];
+	c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+ITL_sphericalhierarchy::ITL_sphericalhierarchy( int nlevel )
+{
+	assert( nlevel >= 1 );
+	if( nlevel > MAX_NR_OF_LEVELS )
+	{
+		fprintf( stderr, "ITL_sphericalhierarchy: %d levels exceed the maximum of %d\n", nlevel, (int)MAX_NR_OF_LEVELS );
+		nlevel = MAX_NR_OF_LEVELS;
+	}
+	nLevel = nlevel;
+	edgeNormal.resize( nLevel );
+	binCenter.resize( nLevel );
+
+	// Icosahedron, with the same vertices and faces as createSphericalGrid
+	double PHI = 2 * cos( pi / 5.0 );
+	double ico[12][3] = { { 0, PHI, 1 }, { 0, -PHI, 1 }, { 0, PHI, -1 }, { 0, -PHI, -1 },
+						  { 1, 0, PHI }, { -1, 0, PHI }, { 1, 0, -PHI }, { -1, 0, -PHI },
+						  { PHI, 1, 0 }, { -PHI, 1, 0 }, { PHI, -1, 0 }, { -PHI, -1, 0 } };
+	for( int i=0; i<12; i++ )
+		normalize3( ico[i] );
+	int A[] = { 1, 4, 8, 6, 10, 3, 5, 1, 0, 4, 2, 8, 7, 6, 11, 11, 5, 0, 2, 9 };
+	int B[] = { 3, 10, 4, 8, 6, 1, 11, 4, 5, 8, 0, 6, 2, 3, 7, 5, 0, 2, 9, 7 };
+	int C[] = { 10, 1, 10, 10, 3, 11, 1, 5, 4, 0, 8, 2, 6, 7, 3, 9, 9, 9, 7, 11 };
+
+	// Corners of the patches of the current level, 9 doubles per patch
+	vector<double> corners( 20*9 );
+	for( int t=0; t<20; t++ )
+		for( int k=0; k<3; k++ )
+		{
+			corners[t*9+0+k] = ico[A[t]][k];
+			corners[t*9+3+k] = ico[B[t]][k];
+			corners[t*9+6+k] = ico[C[t]][k];
+		}
+
+	for( int l=0; l<nLevel; l++ )
+	{
+		int nPatch = (int)corners.size() / 9;
+		edgeNormal[l].reserve( nPatch*9 );
+		binCenter[l].reserve( nPatch );
+		for( int t=0; t<nPatch; t++ )
+			addPatch( l, &corners[t*9+0], &corners[t*9+3], &corners[t*9+6] );
+
+		if( l == nLevel-1 )
+			break;
+
+		// Split each patch into 4, in the child order of divideTriangles2
+		vector<double> children( nPatch*4*9 );
+		for( int t=0; t<nPatch; t++ )
+		{
+			const double* a = &corners[t*9+0];
+			const double* b = &corners[t*9+3];
+			const double* c = &corners[t*9+6];
+			double ab[3], bc[3], ca[3];
+			for( int k=0; k<3; k++ )
+			{
+				ab[k] = ( a[k] + b[k] ) / 2.0;
+				bc[k] = ( b[k] + c[k] ) / 2.0;
+				ca[k] = ( c[k] + a[k] ) / 2.0;
+			}
+			normalize3( ab );	normalize3( bc );	normalize3( ca );
+
+			const double* child[4][3] = { { a, ab, ca }, { b, ab, bc }, { c, bc, ca }, { bc, ca, ab } };
+			for( int i=0; i<4; i++ )
+				for( int v=0; v<3; v++ )
+					for( int k=0; k<3; k++ )
+						children[(t*4+i)*9+v*3+k] = child[i][v][k];
+		}
+		corners.swap( children );
+	}
+
+}// end constructor
+
+void
+ITL_sphericalhierarchy::addPatch( int level, const double* a, const double* b, const double* c )
+{
+	// Orient the patch so that the edge normals point inwards
+	double n[3][3];
+	cross3( a, b, n[0] );
+	cross3( b, c, n[1] );
+	cross3( c, a, n[2] );
+	double s = ( n[0][0]*c[0] + n[0][1]*c[1] + n[0][2]*c[2] ) < 0 ? -1.0 : 1.0;
+
+	for( int e=0; e<3; e++ )
+	{
+		normalize3( n[e] );
+		for( int k=0; k<3; k++ )
+			edgeNormal[level].push_back( (float)( s * n[e][k] ) );
+	}
+
+	double center[3] = { a[0]+b[0]+c[0], a[1]+b[1]+c[1], a[2]+b[2]+c[2] };
+	normalize3( center );
+	binCenter[level].push_back( VECTOR3( (float)center[0], (float)center[1], (float)center[2] ) );
+}
+
+int
+ITL_sphericalhierarchy::getNumLevels() const
+{
+	return nLevel;
+}
+
+int
+ITL_sphericalhierarchy::getNumBins( int level ) const
+{
+	// Levels past the finest would overflow the count
+	if( level < 0 || level >= nLevel )
+		level = nLevel-1;
+	return 20 << ( 2*level );
+}
+
+int
+ITL_sphericalhierarchy::getBinNumber3D( float x, float y, float z, int level ) const
+{
+	if( level < 0 || level >= nLevel )
+		level = nLevel-1;
+
+	// Pick the best patch among the candidates, so that vectors on an
+	// edge (or slightly outside all patches due to rounding) still get a bin
+	int bin = 0;
+	float bestScore = -FLT_MAX;
+	for( int t=0; t<20; t++ )
+	{
+		float score = getInsideScore( &edgeNormal[0][t*9], x, y, z );
+		if( score > bestScore )
+		{
+			bestScore = score;
+			bin = t;
+		}
+	}
+
+	for( int l=1; l<=level; l++ )
+	{
+		int first = bin*4;
+		bestScore = -FLT_MAX;
+		for( int i=0; i<4; i++ )
+		{
+			float score = getInsideScore( &edgeNormal[l][(first+i)*9], x, y, z );
+			if( score > bestScore )
+			{
+				bestScore = score;
+				bin = first+i;
+			}
+		}
+	}
+
+	return bin;
+}
+
+void
+ITL_sphericalhierarchy::mapVectorsToBins( const float* xyz, size_t n, int* out ) const
+{
+	long nPoint = (long)n;
+
+	#pragma omp parallel for schedule(static) if( nPoint > 4096 )
+	for( long i=0; i<nPoint; i++ )
+		out[i] = getBinNumber3D( xyz[i*3+0], xyz[i*3+1], xyz[i*3+2] );
+}
+
+int
+ITL_sphericalhierarchy::getAncestor( int bin, int fromLevel, int toLevel )
+{
+	assert( toLevel <= fromLevel );
+	return bin >> ( 2*( fromLevel - toLevel ) );
+}
+
+void
+ITL_sphericalhierarchy::computeCoarseFrequencies( const int* freq, int fromLevel, int* coarseFreq, int toLevel ) const
+{
+	assert( toLevel <= fromLevel );
+	int nCoarse = getNumBins( toLevel );
+	int nFine = getNumBins( fromLevel );
+	int shift = 2*( fromLevel - toLevel );
+
+	for( int i=0; i<nCoarse; i++ )
+		coarseFreq[i] = 0;
+	for( int i=0; i<nFine; i++ )
+		coarseFreq[i >> shift] += freq[i];
+}
+
+VECTOR3
+ITL_sphericalhierarchy::getBinCenter( int level, int bin ) const
+{
+	return binCenter[level][bin];
+}
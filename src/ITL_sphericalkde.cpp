@@ -0,0 +1,203 @@
+/**
+ * @file ITL_sphericalkde.cpp
+ * Source file for ITL_sphericalkde.
+ * Created on: Oct 17, 2026
+ */
+#include "ITL_sphericalkde.h"
+
+ITL_sphericalkde::ITL_sphericalkde( int nlevel )
+	: hierarchy( nlevel )
+{
+	finestLevel = hierarchy.getNumLevels() - 1;
+
+}// end constructor
+
+int
+ITL_sphericalkde::getLevel( double kappa ) const
+{
+	// Cells of level l are about sqrt( 4*pi / (20*4^l) ) radians apart
+	double kernelWidth = 1.0 / sqrt( max( kappa, 1.0e-12 ) );
+	for( int l=0; l<finestLevel; l++ )
+		if( sqrt( pi / 5.0 ) / ( 1 << l ) <= kernelWidth / CELLS_PER_KERNEL_WIDTH )
+			return l;
+	return finestLevel;
+}
+
+int
+ITL_sphericalkde::getNumCells( int level ) const
+{
+	return hierarchy.getNumBins( ( level < 0 ) ? finestLevel : level );
+}
+
+VECTOR3
+ITL_sphericalkde::getCellCenter( int cell, int level ) const
+{
+	return hierarchy.getBinCenter( ( level < 0 ) ? finestLevel : level, cell );
+}
+
+double
+ITL_sphericalkde::getKernelNormalization( double kappa )
+{
+	// Integral of exp( kappa*(t-1) ) over the sphere is 2*pi*(1 - exp(-2*kappa))/kappa
+	if( kappa < 1.0e-8 )
+		return 1.0 / ( 4*pi );
+	return kappa / ( 2*pi * -expm1( -2*kappa ) );
+}
+
+double
+ITL_sphericalkde::estimateConcentration( const VECTOR3* data, int nPoint )
+{
+	// Mean resultant length of the unit directions
+	double s[3] = { 0, 0, 0 };
+	int n = 0;
+	for( int i=0; i<nPoint; i++ )
+	{
+		double x = data[i](0), y = data[i](1), z = data[i](2);
+		double l = sqrt( x*x + y*y + z*z );
+		if( l <= 0 )
+			continue;
+		s[0] += x/l;	s[1] += y/l;	s[2] += z/l;
+		n ++;
+	}
+	if( n == 0 )
+		return 1.0;
+	double R = sqrt( s[0]*s[0] + s[1]*s[1] + s[2]*s[2] ) / n;
+	R = min( R, 1.0 - 1.0e-9 );
+
+	// Approximate maximum likelihood concentration of the data (Banerjee et al.)
+	double k = R * ( 3.0 - R*R ) / ( 1.0 - R*R );
+	k = ITL_util<double>::clamp( k, 0.05, 1.0e6 );
+
+	// h^6 = 8 sinh^2(k) / ( k n ( (1+4k^2) sinh(2k) - 2k cosh(2k) ) ), with exp(2k) factored out
+	double e2 = exp( -2*k );
+	double e4 = e2*e2;
+	double h6 = 4.0 * ( 1.0 - e2 ) * ( 1.0 - e2 ) /
+				( k * n * ( ( 1.0 + 4*k*k ) * ( 1.0 - e4 ) - 2*k * ( 1.0 + e4 ) ) );
+	double h = pow( h6, 1.0/6.0 );
+
+	return 1.0 / ( h*h );
+
+}// End function
+
+int
+ITL_sphericalkde::computeDensity( const VECTOR3* data, int nPoint, double kappa,
+								  double* densityArray, double truncation ) const
+{
+	int level = getLevel( kappa );
+	int nCell = getNumCells( level );
+
+	// Bin the directions
+	vector<int> binIds( nPoint );
+	#pragma omp parallel for schedule(static) if( nPoint > 4096 )
+	for( int i=0; i<nPoint; i++ )
+	{
+		float x = data[i](0), y = data[i](1), z = data[i](2);
+		binIds[i] = ( x == 0 && y == 0 && z == 0 ) ? -1 : hierarchy.getBinNumber3D( x, y, z, level );
+	}
+
+	vector<int> counts( nCell, 0 );
+	int n = 0;
+	for( int i=0; i<nPoint; i++ )
+		if( binIds[i] >= 0 )
+		{
+			counts[ binIds[i] ] ++;
+			n ++;
+		}
+	if( n == 0 )
+	{
+		memset( densityArray, 0, sizeof(double)*nCell );
+		return 0;
+	}
+
+	// Truncation radius as a chord length: exp( kappa*(cos-1) ) >= truncation
+	double cosMin = 1.0 + log( truncation ) / kappa;
+	double radius = ( cosMin <= -1.0 ) ? 2.0 : sqrt( 2.0 * ( 1.0 - cosMin ) );
+
+	// Index the occupied cells in a uniform grid over [-1, 1]^3 whose voxels are at least radius wide
+	int nVoxel = ITL_util<int>::clamp( (int)( 2.0 / radius ), 1, MAX_NR_OF_VOXELS );
+	vector<int> cellVoxel( nCell, -1 );
+	vector<int> voxelOffset( nVoxel*nVoxel*nVoxel + 1, 0 );
+	for( int c=0; c<nCell; c++ )
+	{
+		VECTOR3 p = hierarchy.getBinCenter( level, c );
+		int v[3];
+		for( int k=0; k<3; k++ )
+			v[k] = min( nVoxel-1, (int)( ( p(k) + 1.0f ) * 0.5f * nVoxel ) );
+		cellVoxel[c] = ( v[2]*nVoxel + v[1] )*nVoxel + v[0];
+		if( counts[c] > 0 )
+			voxelOffset[ cellVoxel[c] + 1 ] ++;
+	}
+	for( size_t i=1; i<voxelOffset.size(); i++ )
+		voxelOffset[i] += voxelOffset[i-1];
+	vector<int> voxelCell( voxelOffset.back() );
+	vector<int> fill( voxelOffset.begin(), voxelOffset.end()-1 );
+	for( int c=0; c<nCell; c++ )
+		if( counts[c] > 0 )
+			voxelCell[ fill[ cellVoxel[c] ]++ ] = c;
+
+	// Gather the kernel sums from the occupied cells within the truncation radius
+	double scale = getKernelNormalization( kappa ) / n;
+	#pragma omp parallel for schedule(dynamic, 256)
+	for( int d=0; d<nCell; d++ )
+	{
+		VECTOR3 p = hierarchy.getBinCenter( level, d );
+		int v = cellVoxel[d];
+		int vx = v % nVoxel, vy = ( v / nVoxel ) % nVoxel, vz = v / ( nVoxel*nVoxel );
+
+		double sum = 0;
+		for( int z = max( vz-1, 0 ); z <= min( vz+1, nVoxel-1 ); z++ )
+			for( int y = max( vy-1, 0 ); y <= min( vy+1, nVoxel-1 ); y++ )
+				for( int x = max( vx-1, 0 ); x <= min( vx+1, nVoxel-1 ); x++ )
+				{
+					int voxel = ( z*nVoxel + y )*nVoxel + x;
+					for( int j = voxelOffset[voxel]; j < voxelOffset[voxel+1]; j++ )
+					{
+						int c = voxelCell[j];
+						VECTOR3 q = hierarchy.getBinCenter( level, c );
+						double dot = p(0)*q(0) + p(1)*q(1) + p(2)*q(2);
+						if( dot >= cosMin )
+							sum += counts[c] * exp( kappa * ( dot - 1.0 ) );
+					}
+				}
+		densityArray[d] = scale * sum;
+	}
+
+	return n;
+
+}// End function
+
+float
+ITL_sphericalkde::computeEntropy( const VECTOR3* data, int nPoint, double kappa, bool toNormalize ) const
+{
+	if( kappa <= 0 )
+		kappa = estimateConcentration( data, nPoint );
+
+	int nCell = getNumCells( getLevel( kappa ) );
+	vector<double> density( nCell );
+	if( computeDensity( data, nPoint, kappa, &density[0] ) == 0 )
+		return 0.0f;
+
+	// Cells have nearly equal areas; rescale so that the density integrates to 1
+	double area = 4*pi / nCell;
+	double total = 0;
+	for( int c=0; c<nCell; c++ )
+		total += density[c] * area;
+
+	// Compute negative entropy
+	double entropy = 0;
+	for( int c=0; c<nCell; c++ )
+	{
+		double f = density[c] / total;
+		entropy += ( f <= 0 ? 0 : area * f * ( log( f ) / log( 2.0 ) ) );
+	}
+
+	// Change sign
+	entropy = -entropy;
+
+	// Normalize, if required
+	if( toNormalize )
+		entropy /= ( log( 4*pi ) / log( 2.0 ) );
+
+	return (float)entropy;
+
+}// End function